@@ -0,0 +1,255 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CoverageStatistics.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <string.h>
+
+namespace CoverageStatistics
+{
+    namespace
+    {
+        // Consecutive pixels are counted into separate copies of the
+        // histogram so runs of equal values do not serialise on one bin.
+        const int NUM_LANES = 4;
+
+        // Pixels off the floor are counted in the upper half of each
+        // lane, which avoids a branch on the floor mask per pixel.
+        const int LANE_BINS = 2 * NUM_LEVELS;
+
+        // A plain scalar loop unrolled over the four lanes; scattered
+        // increments are not vectorised, the lanes only keep the
+        // increments of neighbouring pixels independent.
+        void CountRow( const unsigned char* pCvg,
+                       const unsigned char* pFloor,
+                       int                  width,
+                       unsigned int         lanes[NUM_LANES][LANE_BINS] )
+        {
+            int c = 0;
+
+            if ( pFloor )
+            {
+                for ( ; c + NUM_LANES <= width; c += NUM_LANES )
+                {
+                    ++lanes[0][pCvg[c + 0] | ( ( pFloor[c + 0] == 0 ) << 8 )];
+                    ++lanes[1][pCvg[c + 1] | ( ( pFloor[c + 1] == 0 ) << 8 )];
+                    ++lanes[2][pCvg[c + 2] | ( ( pFloor[c + 2] == 0 ) << 8 )];
+                    ++lanes[3][pCvg[c + 3] | ( ( pFloor[c + 3] == 0 ) << 8 )];
+                }
+
+                for ( ; c < width; ++c )
+                {
+                    ++lanes[0][pCvg[c] | ( ( pFloor[c] == 0 ) << 8 )];
+                }
+            }
+            else
+            {
+                for ( ; c + NUM_LANES <= width; c += NUM_LANES )
+                {
+                    ++lanes[0][pCvg[c + 0]];
+                    ++lanes[1][pCvg[c + 1]];
+                    ++lanes[2][pCvg[c + 2]];
+                    ++lanes[3][pCvg[c + 3]];
+                }
+
+                for ( ; c < width; ++c )
+                {
+                    ++lanes[0][pCvg[c]];
+                }
+            }
+        }
+
+        // Totals of NUM_LEVELS - 1 or more share the top level.
+        inline void AddPasses( unsigned int passes, int& total, unsigned int histogram[NUM_LEVELS] )
+        {
+            --histogram[std::min( total, NUM_LEVELS - 1 )];
+            total += passes;
+            ++histogram[std::min( total, NUM_LEVELS - 1 )];
+        }
+    }
+
+    /**
+        Count the pixels of @a coverage at each pass count.
+
+        @param coverage A single channel 8-bit coverage mask.
+        @param floorMask Optional mask of the same size; if given only
+                         pixels which are non-zero in it are counted.
+        @param histogram Receives the number of pixels at each value.
+    **/
+    void Compute( const IplImage* coverage,
+                  const IplImage* floorMask,
+                  unsigned int    histogram[NUM_LEVELS] )
+    {
+        std::fill( histogram, histogram + NUM_LEVELS, 0u );
+
+        if ( !coverage )
+        {
+            return;
+        }
+
+        assert( coverage->nChannels == 1 && coverage->depth == IPL_DEPTH_8U );
+        assert( !floorMask || ( floorMask->nChannels == 1 &&
+                                floorMask->width == coverage->width &&
+                                floorMask->height == coverage->height ) );
+
+        unsigned int lanes[NUM_LANES][LANE_BINS];
+        std::fill( &lanes[0][0], &lanes[0][0] + NUM_LANES * LANE_BINS, 0u );
+
+        for ( int r = 0; r < coverage->height; ++r )
+        {
+            const unsigned char* pCvg = (const unsigned char*)( coverage->imageData + r * coverage->widthStep );
+            const unsigned char* pFloor = 0;
+
+            if ( floorMask )
+            {
+                pFloor = (const unsigned char*)( floorMask->imageData + r * floorMask->widthStep );
+            }
+
+            CountRow( pCvg, pFloor, coverage->width, lanes );
+        }
+
+        for ( int v = 0; v < NUM_LEVELS; ++v )
+        {
+            histogram[v] = lanes[0][v] + lanes[1][v] + lanes[2][v] + lanes[3][v];
+        }
+    }
+
+    /**
+        @return The number of pixels covered exactly @a passes times.
+    **/
+    unsigned int Exactly( const unsigned int histogram[NUM_LEVELS], int passes )
+    {
+        if ( passes < 0 || passes >= NUM_LEVELS )
+        {
+            return 0;
+        }
+
+        return histogram[passes];
+    }
+
+    /**
+        @return The number of pixels covered @a passes times or more.
+    **/
+    unsigned int AtLeast( const unsigned int histogram[NUM_LEVELS], int passes )
+    {
+        unsigned int count = 0;
+
+        for ( int v = std::max( passes, 0 ); v < NUM_LEVELS; ++v )
+        {
+            count += histogram[v];
+        }
+
+        return count;
+    }
+
+    /**
+        The number of pixels for which (value @a cmp @a passes) holds,
+        with @a cmp one of the OpenCV CV_CMP_* comparisons.
+    **/
+    unsigned int Matching( const unsigned int histogram[NUM_LEVELS], int passes, int cmp )
+    {
+        unsigned int count = 0;
+
+        for ( int v = 0; v < NUM_LEVELS; ++v )
+        {
+            bool match = false;
+
+            switch ( cmp )
+            {
+                case CV_CMP_EQ: match = ( v == passes ); break;
+                case CV_CMP_GT: match = ( v >  passes ); break;
+                case CV_CMP_GE: match = ( v >= passes ); break;
+                case CV_CMP_LT: match = ( v <  passes ); break;
+                case CV_CMP_LE: match = ( v <= passes ); break;
+                case CV_CMP_NE: match = ( v != passes ); break;
+                default: assert( 0 ); break;
+            }
+
+            if ( match )
+            {
+                count += histogram[v];
+            }
+        }
+
+        return count;
+    }
+
+    /**
+        Add a coverage mask into a running total of passes, keeping the
+        histogram of the total up to date as the pixels change level, so
+        that the statistics after each run need no further pass over the
+        total. Totals of NUM_LEVELS - 1 or more are counted in the top
+        level, but the total itself does not saturate.
+
+        @param total A single channel 32-bit (IPL_DEPTH_32S) total.
+        @param coverage A single channel 8-bit coverage mask of the same size.
+        @param histogram The histogram of @a total, as from Compute on the
+                         (zero) total to begin with.
+    **/
+    void Accumulate( IplImage*       total,
+                     const IplImage* coverage,
+                     unsigned int    histogram[NUM_LEVELS] )
+    {
+        assert( total && coverage );
+        assert( total->nChannels == 1 && total->depth == IPL_DEPTH_32S );
+        assert( coverage->nChannels == 1 && coverage->depth == IPL_DEPTH_8U );
+        assert( total->width == coverage->width && total->height == coverage->height );
+
+        const int width = coverage->width;
+
+        for ( int r = 0; r < coverage->height; ++r )
+        {
+            const unsigned char* pCvg = (const unsigned char*)( coverage->imageData + r * coverage->widthStep );
+            int* pTotal = (int*)( total->imageData + r * total->widthStep );
+
+            int c = 0;
+
+            // Most of a run's mask is never covered, so
+            // zeros are skipped eight pixels at a time.
+            for ( ; c + 8 <= width; c += 8 )
+            {
+                unsigned long long word;
+                memcpy( &word, pCvg + c, sizeof( word ) );
+
+                if ( word == 0 )
+                {
+                    continue;
+                }
+
+                for ( int k = c; k < c + 8; ++k )
+                {
+                    if ( pCvg[k] )
+                    {
+                        AddPasses( pCvg[k], pTotal[k], histogram );
+                    }
+                }
+            }
+
+            for ( ; c < width; ++c )
+            {
+                if ( pCvg[c] )
+                {
+                    AddPasses( pCvg[c], pTotal[c], histogram );
+                }
+            }
+        }
+    }
+}
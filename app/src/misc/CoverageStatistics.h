@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COVERAGESTATISTICS_H
+#define COVERAGESTATISTICS_H
+
+#include <opencv/cv.h>
+
+/**
+    Pass-count statistics for 8-bit coverage masks.
+
+    The full histogram of pass counts (optionally restricted to the
+    floor mask) is gathered in a single read of the image, so every
+    per-level query afterwards is a lookup rather than another pass.
+**/
+namespace CoverageStatistics
+{
+    const int NUM_LEVELS = 256;
+
+    void Compute( const IplImage* coverage,
+                  const IplImage* floorMask,
+                  unsigned int    histogram[NUM_LEVELS] );
+
+    unsigned int Exactly( const unsigned int histogram[NUM_LEVELS], int passes );
+    unsigned int AtLeast( const unsigned int histogram[NUM_LEVELS], int passes );
+    unsigned int Matching( const unsigned int histogram[NUM_LEVELS], int passes, int cmp );
+
+    void Accumulate( IplImage*       total,
+                     const IplImage* coverage,
+                     unsigned int    histogram[NUM_LEVELS] );
+}
+
+#endif // COVERAGESTATISTICS_H
@@ -18,9 +18,15 @@
 
 #include "OpenCvTools.h"
 
+#include "CoverageStatistics.h"
+
 #include <opencv/cv.h>
 #include <opencv/highgui.h>
 
+#include <algorithm>
+
+#include <assert.h>
+
 namespace OpenCvTools
 {
     bool IsValid( const IplImage* const iplImage )
@@ -32,6 +38,86 @@ namespace OpenCvTools
         return true;
     }
 
+    ColourPalette::ColourPalette( int size ) :
+        m_entries( std::max( size, 1 ) )
+    {
+        for ( size_t i = 0; i < m_entries.size(); ++i )
+        {
+            m_entries[i].set = false;
+        }
+    }
+
+    /**
+        Give mask pixels of @a value the BGR @a colour (as from CV_RGB),
+        saturating each channel to 8 bits as cvSet2D would.
+     **/
+    void ColourPalette::SetColour( int value, CvScalar colour )
+    {
+        assert( value >= 0 && value < GetSize() );
+
+        Entry& entry = m_entries[value];
+
+        for ( int c = 0; c < 3; ++c )
+        {
+            entry.bgr[c] = (unsigned char)std::min( std::max( cvRound( colour.val[c] ), 0 ), 255 );
+        }
+
+        entry.set = true;
+    }
+
+    /**
+        Draws a coloured overlay of the @a mask into the @a img, with each
+        mask value coloured by the @a palette, in a single pass.
+        @param img The 8-bit BGR image to draw into.
+        @param mask The single channel (8-bit, 16-bit or 32-bit) mask to be
+        overlaid into the @a img. Only the area common to both is drawn.
+        @param palette The colours to use for each mask value.
+     **/
+    void DrawPaletteOverlay( IplImage* img, const IplImage* mask, const ColourPalette& palette )
+    {
+        if (mask->nChannels != 1)
+        {
+            LOG_ERROR("Too many channels in mask!");
+
+            return;
+        }
+
+        if ((img->nChannels != 3) || (img->depth != IPL_DEPTH_8U))
+        {
+            LOG_ERROR("Overlay image is not 8-bit colour!");
+
+            return;
+        }
+
+        const int width = std::min( img->width, mask->width );
+        const int height = std::min( img->height, mask->height );
+
+        for ( int j = 0; j < height; ++j )
+        {
+            const char* pMask = mask->imageData + j * mask->widthStep;
+            unsigned char* pImg = (unsigned char*)( img->imageData + j * img->widthStep );
+
+            if ( mask->depth == IPL_DEPTH_8U )
+            {
+                palette.Apply( (const unsigned char*)pMask, width, pImg );
+            }
+            else if ( mask->depth == IPL_DEPTH_16U )
+            {
+                palette.Apply( (const unsigned short*)pMask, width, pImg );
+            }
+            else if ( mask->depth == (int)IPL_DEPTH_32S )
+            {
+                palette.Apply( (const int*)pMask, width, pImg );
+            }
+            else
+            {
+                LOG_ERROR("Unsupported mask depth!");
+
+                return;
+            }
+        }
+    }
+
     /**
         Loads the given image file, converting it (if necessary) to a
         single-channel (B&W) image.
@@ -79,16 +165,11 @@ namespace OpenCvTools
                                const int nTimes,
                                const int cmp )
     {
-        // first make a copy of the raw-coverage mask, and another one to
-        // count with
-        IplImage* mask = cvCloneImage( rawCoverageImg );
-
-        // Find all pixels that were covered exactly 'nTimes' times
-        cvCmpS( rawCoverageImg, nTimes, mask, cmp );
-        const int nPixels = cvCountNonZero( mask );
-
-        cvReleaseImage( &mask );
+        // Count every pass level in one read of the image, then pick
+        // out the levels which satisfy the comparison.
+        unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+        CoverageStatistics::Compute( rawCoverageImg, 0, histogram );
 
-        return nPixels;
+        return (int)CoverageStatistics::Matching( histogram, nTimes, cmp );
     }
 }
@@ -22,42 +22,69 @@
 #include "Logging.h"
 
 #include <opencv/cv.h>
+
+#include <algorithm>
+#include <vector>
 
 namespace OpenCvTools
 {
     bool IsValid( const IplImage* const iplImage );
 
     /**
-        Draws a coloured overlay of the @a mask into the @a img using the
-        supplied @a colour.
-        @param img The image to draw into.
-        @param mask The mask to be overlaid into the @a img.
-        @param colour The colour to use for the overlay.
-        @param predicate Tests whether the pixel in the mask is a match.
+        A lookup table from mask values to overlay colours, so that an
+        overlay of any number of levels is drawn in a single pass over
+        the mask. Values past the last entry share its colour (so it is
+        an "N or more" bucket) and negative values share the first.
+        Entries without a colour leave the image as it is.
      **/
-    template <typename Pred>
-    void DrawColouredOverlay( IplImage* img, const IplImage* mask, CvScalar colour, Pred predicate )
+    class ColourPalette
     {
-        if (mask->nChannels != 1)
+    public:
+        explicit ColourPalette( int size );
+
+        void SetColour( int value, CvScalar colour );
+
+        int GetSize() const { return (int)m_entries.size(); }
+
+        /** @return The BGR colour for @a value, or 0 if it has none. **/
+        const unsigned char* GetColour( int value ) const
         {
-            LOG_ERROR("Too many channels in mask!");
+            const Entry& entry = m_entries[ ( value < 0 ) ? 0 : std::min( value, GetSize() - 1 ) ];
 
-            return;
+            return entry.set ? entry.bgr : 0;
         }
 
-        for ( int j = 0; j < mask->height; ++j )
+        /**
+            Colour the @a n BGR pixels at @a bgr by the corresponding
+            mask @a values, leaving pixels without a colour as they are.
+         **/
+        template <typename T>
+        void Apply( const T* values, int n, unsigned char* bgr ) const
         {
-            for ( int i = 0; i < mask->width; ++i )
+            for ( int i = 0; i < n; ++i, bgr += 3 )
             {
-                int val = (int)cvGet2D( mask, j, i ).val[0];
+                const unsigned char* colour = GetColour( (int)values[i] );
 
-                if (predicate( val ))
+                if ( colour )
                 {
-                    cvSet2D( img, j, i, colour );
+                    bgr[0] = colour[0];
+                    bgr[1] = colour[1];
+                    bgr[2] = colour[2];
                 }
             }
         }
-    }
+
+    private:
+        struct Entry
+        {
+            unsigned char bgr[3];
+            bool set;
+        };
+
+        std::vector<Entry> m_entries;
+    };
+
+    void DrawPaletteOverlay( IplImage* img, const IplImage* mask, const ColourPalette& palette );
 
     IplImage* LoadSingleChannelImage(const std::string& fileName);
 
@@ -31,6 +31,7 @@
 #include "WbDefaultKeys.h"
 
 #include "OpenCvTools.h"
+#include "CoverageStatistics.h"
 
 #include "FileUtilities.h"
 #include "FileDialogs.h"
@@ -50,7 +51,12 @@
 #include <QTemporaryFile>
 #include <QDirIterator>
 #include <QTextStream>
+#include <QtCore/QFuture>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentRun>
 
+#include <algorithm>
+#include <deque>
 #include <fstream>
 
 #ifdef _WIN32
@@ -61,6 +67,43 @@
 
 static const int MAX_PASS_CAP_DEFAULT = 10;
 
+namespace
+{
+    /**
+        A run's coverage image, decoded ahead of the collation and limited
+        to the floor mask; the image is 0 if it could not be used.
+     **/
+    struct DecodedCoverage
+    {
+        IplImage* image;
+        bool      sizeDiffers;
+    };
+
+    /**
+        Load a run's coverage image and constrain it to the floor mask area.
+        The floor mask is only read, so several images can be decoded at once.
+     **/
+    DecodedCoverage DecodeCoverage( const std::string& fileName, const IplImage* floorMaskImg )
+    {
+        DecodedCoverage decoded = { OpenCvTools::LoadSingleChannelImage( fileName ), false };
+
+        if ( decoded.image &&
+             ( ( decoded.image->height != floorMaskImg->height ) ||
+               ( decoded.image->width != floorMaskImg->width ) ) )
+        {
+            decoded.sizeDiffers = true;
+            cvReleaseImage( &decoded.image );
+        }
+
+        if ( decoded.image )
+        {
+            cvAnd( decoded.image, floorMaskImg, decoded.image );
+        }
+
+        return decoded;
+    }
+}
+
 CollateResultsWidget::CollateResultsWidget( QWidget* parent ) :
     Tool( parent, CreateSchema() ),
     m_ui( new Ui::CollateResultsWidget )
@@ -462,30 +505,50 @@ const ExitStatus::Flags CollateResultsWidget::CollateCoverageResults( char* floo
     LOG_INFO(QObject::tr("Total floor pixels = %2.").arg(nFloorPixels));
 
     // Overlay floor mask onto floor image
-    OpenCvTools::DrawColouredOverlay( floorPlanImg,
-                                      floorMaskImg,
-                                      CV_RGB(100,0,0),
-                                      std::bind2nd(std::equal_to<int>(), 255) );
+    OpenCvTools::ColourPalette floorPalette( 256 );
+    floorPalette.SetColour( 255, CV_RGB(100,0,0) );
+
+    OpenCvTools::DrawPaletteOverlay( floorPlanImg, floorMaskImg, floorPalette );
 
-    // Keep track of total coverage counts in a separate map
+    // Keep track of total coverage counts in a separate map (32-bit, so
+    // it does not saturate), along with the histogram of the total.
     IplImage* totalCoverageImg = cvCreateImage( cvSize( floorMaskImg->width,
-                                                        floorMaskImg->height), IPL_DEPTH_8U, 1 );
+                                                        floorMaskImg->height), IPL_DEPTH_32S, 1 );
     cvZero( totalCoverageImg );
 
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    std::fill( histogram, histogram + CoverageStatistics::NUM_LEVELS, 0u );
+    histogram[0] = nTotalPixels;
+
+    const int passCap = m_ui->m_passCapSpinBox->value();
+
     FILE* fp = fopen( totalCoverageCsvName, "w" );
 
-    PrintCsvHeaders(fp, m_ui->m_passCapSpinBox->value());
+    PrintCsvHeaders(fp, passCap);
+
+    // The coverage images are decoded on the thread pool a few runs ahead
+    // of the total, which takes them in order (as do the CSV lines). Only
+    // that many decoded images are held at once.
+    const size_t lookAhead = 2 * std::max( QThread::idealThreadCount(), 1 );
+    std::deque< QFuture<DecodedCoverage> > decoding;
+    size_t numDecoding = 0;
 
     int run = 0;
     for (std::vector<std::string>::const_iterator i = fileNames.begin(); i != fileNames.end(); ++i)
     {
-        LOG_INFO(QObject::tr("Run: %1 (file: %2).").arg(++run).arg(i->c_str()));
+        while ( numDecoding < fileNames.size() && decoding.size() < lookAhead )
+        {
+            decoding.push_back( QtConcurrent::run( DecodeCoverage,
+                                                   fileNames[numDecoding++],
+                                                   (const IplImage*)floorMaskImg ) );
+        }
+
+        DecodedCoverage decoded = decoding.front().result();
+        decoding.pop_front();
 
-        // Load the coverage mask, limit it to the floor mask area
-        IplImage* coverageMaskImg = OpenCvTools::LoadSingleChannelImage( i->c_str() );
+        LOG_INFO(QObject::tr("Run: %1 (file: %2).").arg(++run).arg(i->c_str()));
 
-        if ((coverageMaskImg->height != floorMaskImg->height) ||
-            (coverageMaskImg->width != floorMaskImg->width))
+        if ( decoded.sizeDiffers )
         {
             LOG_ERROR(QObject::tr("Coverage image (%1) and floor mask sizes differ!").arg(i->c_str()));
             Message::Show( this,
@@ -493,43 +556,44 @@ const ExitStatus::Flags CollateResultsWidget::CollateCoverageResults( char* floo
                            QObject::tr("Coverage image (%1) and floor mask sizes differ."
                                        "\nPlease check sizes of floor plan and mask and then reload.").arg(i->c_str()),
                            Message::Severity_Critical );
-            cvReleaseImage( &coverageMaskImg );
             continue;
         }
 
-        // Constrain coverage to the floor mask area
-        cvAnd( coverageMaskImg, floorMaskImg, coverageMaskImg );
+        if ( !decoded.image )
+        {
+            continue;
+        }
 
         // Add this coverage to the total
-        cvAdd( coverageMaskImg, totalCoverageImg, totalCoverageImg );
+        CoverageStatistics::Accumulate( totalCoverageImg, decoded.image, histogram );
 
         // Write to CSV the collated coverage results
-        PrintCsvLineForPass(fp, run, totalCoverageImg, nFloorPixels, m_ui->m_passCapSpinBox->value());
+        PrintCsvLineForPass(fp, run, histogram, nFloorPixels, passCap);
 
         // Clean up
-        cvReleaseImage( &coverageMaskImg );
+        cvReleaseImage( &decoded.image );
     }
 
 
-    // Update floor plan image with total coverage.
-    for (int level = 1; level < m_ui->m_passCapSpinBox->value(); ++level)
+    // Update floor plan image with total coverage: a shade of green
+    // for each level below the pass cap, and full green for 10 or more
+    // passes (the last entry of the palette).
+    OpenCvTools::ColourPalette coveragePalette( 11 );
+
+    for (int level = 1; level < std::min( passCap, 10 ); ++level)
     {
-        OpenCvTools::DrawColouredOverlay( floorPlanImg,
-                                          totalCoverageImg,
-                                          CV_RGB(0,level*40,0),
-                                          std::bind2nd(std::equal_to<int>(), level) );
+        coveragePalette.SetColour( level, CV_RGB(0,level*40,0) );
     }
 
+    coveragePalette.SetColour( 10, CV_RGB(0,255,0) );
 
-    OpenCvTools::DrawColouredOverlay( floorPlanImg,
-                                      totalCoverageImg,
-                                      CV_RGB(0,255,0),
-                                      std::bind2nd(std::greater_equal<int>(), 10) );
+    OpenCvTools::DrawPaletteOverlay( floorPlanImg, totalCoverageImg, coveragePalette );
 
     // Clean up
     if ( f ) { fclose( f ); }
     if ( fp ) { fclose( fp ); }
     cvSaveImage( totalCoverageImgName, floorPlanImg );
+    cvReleaseImage( &totalCoverageImg );
     cvReleaseImage( &floorMaskImg );
     cvReleaseImage( &floorPlanImg );
 
@@ -609,7 +673,7 @@ void CollateResultsWidget::PrintCsvHeaders( FILE* fp, const int passCap )
 
 void CollateResultsWidget::PrintCsvLineForPass( FILE* fp,
                           const int run,
-                          IplImage* totalCoverageImg,
+                          const unsigned int* histogram,
                           const int nFloorPixels,
                           const int passCap)
 {
@@ -619,16 +683,9 @@ void CollateResultsWidget::PrintCsvLineForPass( FILE* fp,
     {
         const int numTimesCovered = level+1;
         const bool isTopNumPasses = (level == (passCap-1));
-        int comparisonOp = CV_CMP_EQ;
-
-        if ( isTopNumPasses )
-        {
-            comparisonOp = CV_CMP_GE;
-        }
 
-        int nPixels = OpenCvTools::GetPixelCoverageCount( totalCoverageImg,
-                                                          numTimesCovered,
-                                                          comparisonOp );
+        int nPixels = isTopNumPasses ? (int)CoverageStatistics::AtLeast( histogram, numTimesCovered )
+                                     : (int)CoverageStatistics::Exactly( histogram, numTimesCovered );
         float percent = nPixels * (100.f / nFloorPixels);
         fprintf(fp, ", %f", percent);
 
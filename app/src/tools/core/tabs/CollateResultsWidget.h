@@ -79,7 +79,7 @@ private:
     void PrintCsvHeaders(FILE* fp , const int maxLevel);
     void PrintCsvLineForPass( FILE* fp,
                               const int run,
-                              IplImage* totalCoverageImg,
+                              const unsigned int* histogram,
                               const int nFloorPixels , const int maxLevel);
     Ui::CollateResultsWidget* m_ui;
     QStandardItemModel* tableModel;
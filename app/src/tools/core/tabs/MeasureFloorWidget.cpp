@@ -176,10 +176,10 @@ void MeasureFloorWidget::ShowImage()
             IplImage* floorMaskImg = OpenCvTools::LoadSingleChannelImage( maskName.toAscii().data() );
 
            // Overlay floor mask onto floor image
-            OpenCvTools::DrawColouredOverlay( floorPlanImg,
-                                              floorMaskImg,
-                                              CV_RGB(100,0,0),
-                                              std::bind2nd(std::equal_to<int>(), 255) );
+            OpenCvTools::ColourPalette floorPalette( 256 );
+            floorPalette.SetColour( 255, CV_RGB(100,0,0) );
+
+            OpenCvTools::DrawPaletteOverlay( floorPlanImg, floorMaskImg, floorPalette );
 
             cvReleaseImage( &floorMaskImg );
         }
@@ -28,6 +28,7 @@
 
 #include "RoomsCollection.h"
 #include "RobotsCollection.h"
+#include "RunsCollection.h"
 #include "CameraPositionsCollection.h"
 #include "TrackRobotSchema.h"
 #include "ExtrinsicCalibrationSchema.h"
@@ -35,6 +36,7 @@
 #include "RobotMetricsSchema.h"
 #include "FloorPlanSchema.h"
 #include "RunSchema.h"
+#include "WbDefaultKeys.h"
 
 #include "Message.h"
 #include "Logging.h"
@@ -43,6 +45,12 @@
 #include "PostProcessSchema.h"
 
 #include <QtCore/QDir>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFile>
+#include <QtCore/QFuture>
+#include <QtCore/QThread>
+#include <QtCore/QTimer>
+#include <QtCore/QtConcurrentRun>
 #include <QtGui/QMessageBox>
 #include <QFileDialog>
 #include <QApplication>
@@ -53,6 +61,8 @@
 #include <opencv/highgui.h>
 
 #include <sstream>
+#include <algorithm>
+#include <vector>
 
 #ifdef _WIN32
 #include "windows.h"
@@ -75,6 +85,10 @@ PostProcessWidget::PostProcessWidget( QWidget* const parent ) :
                       SIGNAL( clicked() ),
                       this,
                       SLOT( PostProcessButtonClicked() ) );
+    QObject::connect( m_ui->m_processAllBtn,
+                      SIGNAL( clicked() ),
+                      this,
+                      SLOT( ProcessAllButtonClicked() ) );
 
     // set up delete button
     QAction* const toggleAction = new QAction( tr( "Toggle Data Point ON/OFF" ), m_ui->m_trackResults );
@@ -187,157 +201,312 @@ void PostProcessWidget::ToggleItemTriggered()
     }
 }
 
+/**
+    Find the robot metrics and the input and output files for a run.
+
+    @return false if the run's room has no camera positions or the
+    robot metrics could not be loaded.
+**/
+bool PostProcessWidget::CreateRunSetup( const WbConfig& runConfig, RunSetup& setup ) const
+{
+    Collection m_rooms( RoomsCollection() );
+    Collection m_robots( RobotsCollection() );
+
+    m_rooms.SetConfig( runConfig );
+    m_robots.SetConfig( runConfig );
+
+    setup.name = runConfig.GetKeyValue( WbDefaultKeys::displayNameKey ).ToQString();
+
+    // Get the room configuration (for this run)
+    const KeyId roomId = runConfig.GetKeyValue( RunSchema::roomIdKey ).ToKeyId();
+    const WbConfig roomConfig = m_rooms.ElementById( roomId );
+
+    // Get the track configuration
+    const WbConfig& trackConfig = runConfig.GetSubConfig( TrackRobotSchema::schemaName );
+
+    // Get the robot configuration (for this run)
+    const KeyId robotId = trackConfig.GetKeyValue( TrackRobotSchema::robotIdKey ).ToKeyId();
+    const WbConfig& robotConfig = m_robots.ElementById( robotId );
+
+    // Get the robot metrics configuration
+    const WbConfig metricsConfig( robotConfig.GetSubConfig( RobotMetricsSchema::schemaName ) );
+
+    // Get the first camera (position) configuration
+    std::vector<WbConfig> camPosConfigs = GetCameraPositionsConfigs(roomConfig);
+
+    if ( camPosConfigs.empty() )
+    {
+        LOG_ERROR(QObject::tr("Post Process - No camera positions for run %1!").arg(setup.name));
+
+        return false;
+    }
+
+    const WbConfig firstCamPosConfig(camPosConfigs.at(0));
+    const WbConfig camPosCalConfig( firstCamPosConfig.GetSubConfig( ExtrinsicCalibrationSchema::schemaName ) );
+
+    /// @todo not handling multiple camera resolutions
+
+    const float resolution = m_ui->m_postProcessResolutionDoubleSpinBox->value();
+
+    if ( !setup.metrics.LoadMetrics( metricsConfig, camPosCalConfig, resolution ) )
+    {
+        LOG_ERROR(QObject::tr("Post Process - Could not load robot metrics for run %1!").arg(setup.name));
+
+        return false;
+    }
+
+    const WbConfig roomLayoutConfig(
+                roomConfig.GetSubConfig( RoomLayoutSchema::schemaName ) );
+
+    setup.floorPlanName = roomLayoutConfig.GetAbsoluteFileNameFor( "floor_plan.png" );
+    setup.floorMaskName = roomLayoutConfig.GetAbsoluteFileNameFor( "floor_mask.png" );
+
+    setup.trackerResultsCsvName = runConfig.GetAbsoluteFileNameFor( "results/track_result_out.csv" );
+    setup.trackerResultsTxtName = runConfig.GetAbsoluteFileNameFor( "results/track_result_out.txt" );
+    setup.pixelOffsetsName = runConfig.GetAbsoluteFileNameFor( "results/pixel_offsets.txt" );
+
+    setup.coverageMissedName = runConfig.GetAbsoluteFileNameFor( "results/coverage_missed.png" );
+    setup.coverageColourName = runConfig.GetAbsoluteFileNameFor( "results/coverage_colour.png" );
+    setup.coverageHistogramName = runConfig.GetAbsoluteFileNameFor( "results/coverage_histogram.txt" );
+    setup.coverageOverlayName = runConfig.GetAbsoluteFileNameFor( "results/coverage_overlay.png" );
+
+    setup.coverageIncrementName = runConfig.GetAbsoluteFileNameFor( "results/coverage_increment.txt" );
+    setup.coverageRelativeName = runConfig.GetAbsoluteFileNameFor( "results/coverage_relative.txt" );
+
+    setup.trackHeadingName = runConfig.GetAbsoluteFileNameFor( "results/track_heading.png" );
+
+    setup.trackerResultsImgFile = runConfig.GetAbsoluteFileNameFor( "results/track_result_img_out.png" );
+
+    return true;
+}
+
+/**
+    Post-process one run from its track_result_out.csv.
+
+    Only uses the run setup, so it is safe to run for several runs at once.
+**/
+ExitStatus::Flags PostProcessWidget::ProcessRun( const RunSetup& setup )
+{
+    return PostProcess( setup.metrics,
+                        setup.trackerResultsCsvName.toAscii().data(),    // trackerResultsName
+                        setup.trackerResultsTxtName.toAscii().data(),
+                        setup.trackerResultsImgFile.toAscii().data(),
+                        setup.coverageIncrementName.toAscii().data(),    // coverageFile
+                        setup.floorPlanName.toAscii().data(),            // floorPlanFile
+                        setup.floorMaskName.toAscii().data(),            // floorMaskFile
+                        setup.coverageRelativeName.toAscii().data(),     // relativeLogFile
+                        setup.pixelOffsetsName.toAscii().data(),         // pixelOffsetsFile
+                        setup.coverageMissedName.toAscii().data(),
+                        setup.coverageColourName.toAscii().data(),
+                        setup.coverageHistogramName.toAscii().data(),
+                        setup.coverageOverlayName.toAscii().data(),
+                        setup.trackHeadingName.toAscii().data(),
+                        1.0 );                                           // incTimeStep
+}
+
 void PostProcessWidget::PostProcessButtonClicked()
 {
     const WbConfig& config = GetCurrentConfig();
 
     LOG_TRACE("Post Process - Processing");
 
-    bool successful = true;
-
-    Collection m_rooms = RoomsCollection();
-
     const WbConfig runConfig( config.GetParent() );
-    const WbConfig trackConfig( runConfig.GetSubConfig( TrackRobotSchema::schemaName ) );
 
-    m_rooms.SetConfig( runConfig );
+    RunSetup setup;
+    bool successful = CreateRunSetup( runConfig, setup );
 
     if ( successful )
     {
-        const KeyValue roomId = runConfig.GetKeyValue( RunSchema::roomIdKey );
-        const WbConfig roomConfig = m_rooms.ElementById( roomId.ToKeyId() );
-
-        const WbConfig roomLayoutConfig(
-                    roomConfig.GetSubConfig( RoomLayoutSchema::schemaName ) );
-
-        const QString floorPlanName(
-                    roomLayoutConfig.GetAbsoluteFileNameFor( "floor_plan.png" ) );
-        const QString floorMaskName(
-                    roomLayoutConfig.GetAbsoluteFileNameFor( "floor_mask.png" ) );
-
-        const QString trackerResultsCsvName(
-                    runConfig.GetAbsoluteFileNameFor( "results/track_result_out.csv" ) );
-        const QString trackerResultsTxtName(
-                    runConfig.GetAbsoluteFileNameFor( "results/track_result_out.txt" ) );
-        const QString pixelOffsetsName(
-                    runConfig.GetAbsoluteFileNameFor( "results/pixel_offsets.txt" ) );
-
-        const QString coverageMissedName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_missed.png" ) );
-        const QString coverageColourName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_colour.png" ) );
-        const QString coverageHistogramName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_histogram.txt" ) );
-        const QString coverageOverlayName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_overlay.png" ) );
-
-        const QString coverageIncrementName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_increment.txt" ) );
-        const QString coverageRelativeName(
-                    runConfig.GetAbsoluteFileNameFor( "results/coverage_relative.txt" ) );
-
-        const QString trackHeadingName(
-                    runConfig.GetAbsoluteFileNameFor( "results/track_heading.png" ) );
-
-        const QString trackerResultsImgFile(
-                    runConfig.GetAbsoluteFileNameFor( "results/track_result_img_out.png" ) );
-
-        m_resultsModel->toCSV(trackerResultsCsvName, true, ',');
+        m_resultsModel->toCSV(setup.trackerResultsCsvName, true, ',');
+
+        UnknownLengthProgressDlg* const progressDialog = new UnknownLengthProgressDlg( this );
+        progressDialog->Start( tr( "Processing" ), tr( "" ) );
+
+        ExitStatus::Flags exitCode = ProcessRun( setup );
+
+        successful = ( exitCode == ExitStatus::OK_TO_CONTINUE );
 
         if ( successful )
         {
-            UnknownLengthProgressDlg* const progressDialog = new UnknownLengthProgressDlg( this );
-            progressDialog->Start( tr( "Processing" ), tr( "" ) );
-
-            ExitStatus::Flags exitCode = PostProcess( config,
-                                                      trackerResultsCsvName.toAscii().data(),    // trackerResultsName
-                                                      trackerResultsTxtName.toAscii().data(),
-                                                      trackerResultsImgFile.toAscii().data(),
-                                                      coverageIncrementName.toAscii().data(),    // coverageFile
-                                                      floorPlanName.toAscii().data(),            // floorPlanFile
-                                                      floorMaskName.toAscii().data(),            // floorMaskFile
-                                                      coverageRelativeName.toAscii().data(),     // relativeLogFile
-                                                      pixelOffsetsName.toAscii().data(),         // pixelOffsetsFile
-                                                      coverageMissedName.toAscii().data(),
-                                                      coverageColourName.toAscii().data(),
-                                                      coverageHistogramName.toAscii().data(),
-                                                      coverageOverlayName.toAscii().data(),
-                                                      trackHeadingName.toAscii().data(),
-                                                      1.0 );                                     // incTimeStep
-
-            successful = ( exitCode == ExitStatus::OK_TO_CONTINUE );
-
-            if ( successful )
-            {
-                const QString trackerResultsDirectory(
-                            runConfig.GetAbsoluteFileNameFor( "results" ) );
-                progressDialog->Complete( tr( "Post Processing Successful" ),
-                                          tr( "Results located at %1" )
-                                          .arg( trackerResultsDirectory ),
-                                          trackerResultsDirectory );
-            }
-            else
-            {
-                progressDialog->ForceClose();
+            const QString trackerResultsDirectory(
+                        runConfig.GetAbsoluteFileNameFor( "results" ) );
+            progressDialog->Complete( tr( "Post Processing Successful" ),
+                                      tr( "Results located at %1" )
+                                      .arg( trackerResultsDirectory ),
+                                      trackerResultsDirectory );
+        }
+        else
+        {
+            progressDialog->ForceClose();
 
-                Message::Show( 0,
-                               tr( "Post Processing Failed" ),
-                               tr( "See the log for details!" ),
-                               Message::Severity_Critical );
-            }
+            Message::Show( 0,
+                           tr( "Post Processing Failed" ),
+                           tr( "See the log for details!" ),
+                           Message::Severity_Critical );
         }
     }
 }
 
-// ----------------------------------------------------------------------------------------------------------------------------
-// ----------------------------------------------------------------------------------------------------------------------------
-
-const ExitStatus::Flags PostProcessWidget::PostProcess( const WbConfig& postProcConfig,
-                                                            char*           trackerResultsCsvFile, // -log
-                                                            char*           trackerResultsTxtFile,
-                                                            char*           trackerResultsImgFile,
-                                                            char*           coverageFile,          // -inc
-                                                            char*           floorPlanFile,
-                                                            char*           floorMaskFile,         // -flr
-                                                            char*           relativeLogFile,       // -rel
-                                                            char*           pixelOffsetsFile,
-                                                            char*           coverageMissedFile,
-                                                            char*           coverageColourFile,
-                                                            char*           coverageHistogramFile,
-                                                            char*           coverageRawFile,
-                                                            char*           headingFile,
-                                                            double          incTimeStep )          // -incstep
+/**
+    Post-process every run in the workbench which has been tracked, e.g.
+    after the robot's brush bar has been changed. Runs processed before
+    keep the points deleted then; the others use the whole raw track, as
+    if loaded and processed straight away.
+
+    Runs are processed on the global thread pool. Each run in progress
+    holds its own floor plan and coverage images, so only a few are
+    started at a time; progress and failures are reported per run.
+**/
+void PostProcessWidget::ProcessAllButtonClicked()
 {
-    ExitStatus::Flags exitStatus = ExitStatus::OK_TO_CONTINUE;
+    const size_t MAX_RUNS_IN_PROGRESS = 4;
 
-    Collection m_rooms( RoomsCollection() );
-    Collection m_robots( RobotsCollection() );
+    LOG_TRACE("Post Process - Processing all runs");
 
-    m_rooms.SetConfig( postProcConfig );
-    m_robots.SetConfig( postProcConfig );
+    Collection runsCollection = RunsCollection();
+    runsCollection.SetConfig( GetCurrentConfig() );
 
-    // Get the run configuration
-    const WbConfig& runConfig = postProcConfig.GetParent();
+    std::vector<RunSetup> setups;
+    QStringList failedRuns;
 
-    // Get the room configuration (for this run)
-    const KeyId roomId = runConfig.GetKeyValue( RunSchema::roomIdKey ).ToKeyId();
-    const WbConfig roomConfig = m_rooms.ElementById( roomId );
+    for ( size_t n = 0; n < runsCollection.NumElements(); ++n )
+    {
+        const WbConfig runConfig = runsCollection.ElementAt( n ).value;
 
-    // Get the track configuration
-    const WbConfig& trackConfig = runConfig.GetSubConfig( TrackRobotSchema::schemaName );
+        const QString trackerResultsRawName(
+                    runConfig.GetAbsoluteFileNameFor( "results/track_result_raw.csv" ) );
 
-    // Get the robot configuration (for this run)
-    const KeyId robotId = trackConfig.GetKeyValue( TrackRobotSchema::robotIdKey ).ToKeyId();
-    const WbConfig& robotConfig = m_robots.ElementById( robotId );
+        if ( !QFile::exists( trackerResultsRawName ) )
+        {
+            continue;
+        }
 
-    // Get the robot metrics configuration
-    const WbConfig& metricsConfig = robotConfig.GetSubConfig( RobotMetricsSchema::schemaName );
+        RunSetup setup;
 
-    // Get the first camera (position) configuration
-    std::vector<WbConfig> camPosConfigs = GetCameraPositionsConfigs(roomConfig);
+        if ( !CreateRunSetup( runConfig, setup ) )
+        {
+            failedRuns << setup.name;
+            continue;
+        }
 
-    const WbConfig firstCamPosConfig(camPosConfigs.at(0));
-    const WbConfig& firstCamPosCalConfig = firstCamPosConfig.GetSubConfig( ExtrinsicCalibrationSchema::schemaName );
+        if ( !QFile::exists( setup.trackerResultsCsvName ) )
+        {
+            TrackModel raw( trackerResultsRawName, 0, true, ',' );
+            raw.toCSV( setup.trackerResultsCsvName, true, ',' );
+        }
+
+        setups.push_back( setup );
+    }
+
+    if ( setups.empty() && failedRuns.empty() )
+    {
+        Message::Show( this,
+                       tr( "Post Process" ),
+                       tr( "There are no tracked runs to process!" ),
+                       Message::Severity_Information );
+        return;
+    }
+
+    m_ui->m_loadDataBtn->setEnabled( false );
+    m_ui->m_postProcessBtn->setEnabled( false );
+    m_ui->m_processAllBtn->setEnabled( false );
+
+    UnknownLengthProgressDlg* const progressDialog = new UnknownLengthProgressDlg( this );
+    progressDialog->Start( tr( "Processing" ),
+                           tr( "Processed 0 of %1 runs" ).arg( setups.size() ) );
+
+    const size_t maxInProgress = std::min( MAX_RUNS_IN_PROGRESS,
+                                           (size_t)std::max( QThread::idealThreadCount(), 1 ) );
+
+    std::vector< QFuture<ExitStatus::Flags> > pending( setups.size() );
+    std::vector<bool> reported( setups.size(), false );
+    size_t numStarted = 0;
+    size_t numReported = 0;
+
+    // Wait for the runs without blocking the event loop,
+    // starting another as each one completes.
+    while ( numReported < setups.size() )
+    {
+        while ( numStarted < setups.size() && numStarted - numReported < maxInProgress )
+        {
+            pending[numStarted] = QtConcurrent::run( &PostProcessWidget::ProcessRun, setups[numStarted] );
+            ++numStarted;
+        }
+
+        for ( size_t i = 0; i < numStarted; ++i )
+        {
+            if ( !reported[i] && pending[i].isFinished() )
+            {
+                reported[i] = true;
+                ++numReported;
+
+                if ( pending[i].result() == ExitStatus::OK_TO_CONTINUE )
+                {
+                    LOG_INFO(QObject::tr("Post Process - Processed run %1.").arg(setups[i].name));
+                }
+                else
+                {
+                    LOG_ERROR(QObject::tr("Post Process - Processing failed for run %1.").arg(setups[i].name));
+
+                    failedRuns << setups[i].name;
+                }
+
+                progressDialog->Start( tr( "Processing" ),
+                                       tr( "Processed %1 of %2 runs" ).arg( numReported )
+                                                                      .arg( setups.size() ) );
+            }
+        }
+
+        if ( numReported < setups.size() )
+        {
+            QEventLoop loop;
+            QTimer::singleShot( 50, &loop, SLOT( quit() ) );
+            loop.exec();
+        }
+    }
+
+    m_ui->m_loadDataBtn->setEnabled( true );
+    m_ui->m_postProcessBtn->setEnabled( true );
+    m_ui->m_processAllBtn->setEnabled( true );
+
+    if ( failedRuns.empty() )
+    {
+        progressDialog->Complete( tr( "Post Processing Successful" ),
+                                  tr( "Processed %1 runs" ).arg( setups.size() ) );
+    }
+    else
+    {
+        progressDialog->ForceClose();
+
+        Message::Show( 0,
+                       tr( "Post Processing Failed" ),
+                       tr( "%1 runs could not be processed. See the log for details!" )
+                           .arg( failedRuns.size() ),
+                       Message::Severity_Critical,
+                       failedRuns.join( "\n" ) );
+    }
+}
+
+// ----------------------------------------------------------------------------------------------------------------------------
+// ----------------------------------------------------------------------------------------------------------------------------
+
+const ExitStatus::Flags PostProcessWidget::PostProcess( const RobotMetrics& metrics,
+                                                        char*               trackerResultsCsvFile, // -log
+                                                        char*               trackerResultsTxtFile,
+                                                        char*               trackerResultsImgFile,
+                                                        char*               coverageFile,          // -inc
+                                                        char*               floorPlanFile,
+                                                        char*               floorMaskFile,         // -flr
+                                                        char*               relativeLogFile,       // -rel
+                                                        char*               pixelOffsetsFile,
+                                                        char*               coverageMissedFile,
+                                                        char*               coverageColourFile,
+                                                        char*               coverageHistogramFile,
+                                                        char*               coverageRawFile,
+                                                        char*               headingFile,
+                                                        double              incTimeStep )          // -incstep
+{
+    ExitStatus::Flags exitStatus = ExitStatus::OK_TO_CONTINUE;
 
     if ( exitStatus == ExitStatus::OK_TO_CONTINUE )
     {
@@ -349,11 +518,10 @@ const ExitStatus::Flags PostProcessWidget::PostProcess( const WbConfig& postProc
         }
 
         // Read the tracking results,
-        // robot metrics, floor plan,
-        // and pixel offsets.
+        // floor plan, and pixel offsets.
 
-        RobotMetrics metrics;
         TrackHistory::TrackLog avg;
+        TrackHistory::DropLog drops;
         CvPoint2D32f offset;
         float tx;
         float ty;
@@ -379,25 +547,14 @@ const ExitStatus::Flags PostProcessWidget::PostProcess( const WbConfig& postProc
             return ExitStatus::ERRORS_OCCURRED;
         }
 
-        /// @todo not handling multiple camera resolutions
-
-        float resolution = m_ui->m_postProcessResolutionDoubleSpinBox->value();
-
-        if ( !metrics.LoadMetrics( metricsConfig, firstCamPosCalConfig, resolution ) )
-        {
-            LOG_ERROR("Post Process - Could not load robot metrics!");
-
-            return ExitStatus::ERRORS_OCCURRED;
-        }
-
-        if ( !TrackHistory::ReadHistoryCsv( trackerResultsCsvFile, avg ) )
+        if ( !TrackHistory::ReadHistoryCsv( trackerResultsCsvFile, avg, drops ) )
         {
             LOG_ERROR(QObject::tr("Post Process - Could not load track log from %1!").arg(trackerResultsCsvFile));
 
             return ExitStatus::ERRORS_OCCURRED;
         }
 
-        TrackHistory::WriteHistoryLog( trackerResultsTxtFile, avg );
+        TrackHistory::WriteHistoryLog( trackerResultsTxtFile, avg, drops );
 
         ScanUtility::LogSwapHandedness( avg );
 
@@ -405,7 +562,7 @@ const ExitStatus::Flags PostProcessWidget::PostProcess( const WbConfig& postProc
         {
             TrackHistory::TrackLog rel;
             ScanUtility::ConvertToRelativeLog( avg, rel );
-            TrackHistory::WriteHistoryLog( relativeLogFile, rel);
+            TrackHistory::WriteHistoryLog( relativeLogFile, rel, drops );
         }
 
         IplImage* compImgCol = NULL;
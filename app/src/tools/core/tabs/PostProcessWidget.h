@@ -24,6 +24,8 @@
 #include "Tool.h"
 #include "AlgorithmInterface.h"
 #include "RobotTracker.h"
+#include "RobotMetrics.h"
+#include "WbConfig.h"
 
 class TrackModel;
 class QItemSelectionModel;
@@ -48,32 +50,61 @@ public:
 private slots:
     void LoadDataButtonClicked();
     void PostProcessButtonClicked();
+    void ProcessAllButtonClicked();
     void ToggleItemTriggered();
 
 private:
+    /**
+        Everything needed to post-process one run. The robot metrics
+        and file names are read from the configuration on the GUI
+        thread and held as plain values, as WbConfig is a shared handle
+        which must not be read from another thread.
+    **/
+    struct RunSetup
+    {
+        QString      name;
+        RobotMetrics metrics;
+
+        QString      floorPlanName;
+        QString      floorMaskName;
+        QString      trackerResultsCsvName;
+        QString      trackerResultsTxtName;
+        QString      trackerResultsImgFile;
+        QString      pixelOffsetsName;
+        QString      coverageMissedName;
+        QString      coverageColourName;
+        QString      coverageHistogramName;
+        QString      coverageOverlayName;
+        QString      coverageIncrementName;
+        QString      coverageRelativeName;
+        QString      trackHeadingName;
+    };
+
     const KeyId GetRoomIdToCapture() const;
     void ShowNoRoomError();
     virtual const QString GetSubSchemaDefaultFileName() const;
     const WbSchema CreateSchema();
-    const ExitStatus::Flags PostProcess( const WbConfig& postProcConfig,
-                                         char*           trackerResultsCsvFile,
-                                         char*           trackerResultsTxtFile,
-                                         char*           trackerResultsImgFile,
-                                         char*           coverageFile,
-                                         char*           floorPlanFile,
-                                         char*           floorMaskFile,
-                                         char*           relativeLogFile,
-                                         char*           pixelOffsetsFile,
-                                         char*           coverageMissedFile,
-                                         char*           coverageColourFile,
-                                         char*           coverageHistogramFile,
-                                         char*           coverageRawFile,
-                                         char*           headingFile,
-                                         double          incTimeStep );
-
-    void PlotTrackLog( TrackHistory::TrackLog& log,
-                       char*                   floorPlanFile,
-                       char*                   trackerResultsImgFile );
+    bool CreateRunSetup( const WbConfig& runConfig, RunSetup& setup ) const;
+    static ExitStatus::Flags ProcessRun( const RunSetup& setup );
+    static const ExitStatus::Flags PostProcess( const RobotMetrics& metrics,
+                                                char*               trackerResultsCsvFile,
+                                                char*               trackerResultsTxtFile,
+                                                char*               trackerResultsImgFile,
+                                                char*               coverageFile,
+                                                char*               floorPlanFile,
+                                                char*               floorMaskFile,
+                                                char*               relativeLogFile,
+                                                char*               pixelOffsetsFile,
+                                                char*               coverageMissedFile,
+                                                char*               coverageColourFile,
+                                                char*               coverageHistogramFile,
+                                                char*               coverageRawFile,
+                                                char*               headingFile,
+                                                double              incTimeStep );
+
+    static void PlotTrackLog( TrackHistory::TrackLog& log,
+                              char*                   floorPlanFile,
+                              char*                   trackerResultsImgFile );
 
 
     Ui::PostProcessWidget* m_ui;
@@ -44,6 +44,9 @@
 #include "FileUtilities.h"
 
 #include <QtCore/QDir>
+#include <QtCore/QEventLoop>
+#include <QtCore/QFuture>
+#include <QtCore/QTimer>
 #include <QtGui/QMessageBox>
 #include <QApplication>
 #include <QShortcut>
@@ -148,6 +151,7 @@ void TrackRobotWidget::ResetUi()
     m_ui->m_nccThresholdSpinBox->setEnabled(true);
     m_ui->m_resolutionSpinBox->setEnabled(true);
     m_ui->m_trackerThresholdSpinBox->setEnabled(true);
+    m_ui->m_motionPredictionCheckBox->setEnabled(true);
     m_ui->m_useGlobalCheckBox->setEnabled(true);
     m_ui->m_cameraTrackParamsSaveBtn->setEnabled(true);
     m_ui->m_positionCombo->setEnabled(true);
@@ -204,6 +208,18 @@ void TrackRobotWidget::ConnectSignals()
                       SIGNAL( clicked() ),
                       this,
                       SLOT( SaveBtnClicked() ) );
+    QObject::connect( m_ui->m_displayRateSpinBox,
+                      SIGNAL( valueChanged( int ) ),
+                      this,
+                      SLOT( DisplayRateChanged() ) );
+    QObject::connect( m_ui->m_headlessCheckBox,
+                      SIGNAL( toggled( bool ) ),
+                      this,
+                      SLOT( DisplayRateChanged() ) );
+    QObject::connect( m_ui->m_excessLatencyBudgetSpinBox,
+                      SIGNAL( valueChanged( int ) ),
+                      this,
+                      SLOT( ExcessLatencyBudgetChanged() ) );
 }
 
 void TrackRobotWidget::SetupKeyboardShortcuts()
@@ -243,6 +259,10 @@ void TrackRobotWidget::CreateMappers()
     AddMapper(TrackRobotSchema::GlobalTrackingParams::biLevelThreshold, m_ui->m_trackerThresholdSpinBox);
     AddMapper(TrackRobotSchema::GlobalTrackingParams::nccThreshold,     m_ui->m_nccThresholdSpinBox);
     AddMapper(TrackRobotSchema::GlobalTrackingParams::resolution,       m_ui->m_resolutionSpinBox);
+    AddMapper(TrackRobotSchema::GlobalTrackingParams::displayRate,      m_ui->m_displayRateSpinBox);
+    AddMapper(TrackRobotSchema::GlobalTrackingParams::displayHeadless,  m_ui->m_headlessCheckBox);
+    AddMapper(TrackRobotSchema::GlobalTrackingParams::excessLatencyBudget, m_ui->m_excessLatencyBudgetSpinBox);
+    AddMapper(TrackRobotSchema::GlobalTrackingParams::motionPrediction, m_ui->m_motionPredictionCheckBox);
 }
 
 const QString TrackRobotWidget::GetCameraId() const
@@ -641,11 +661,19 @@ const WbSchema TrackRobotWidget::CreateSchema()
                            KeyNameList() <<
                                biLevelThreshold <<
                                nccThreshold <<
-                               resolution,
+                               resolution <<
+                               motionPrediction <<
+                               displayRate <<
+                               displayHeadless <<
+                               excessLatencyBudget,
                            DefaultValueMap()
                                .WithDefault(biLevelThreshold, KeyValue::from(BI_LEVEL_DEFAULT))
                                .WithDefault(nccThreshold,     KeyValue::from(NCC_DEFAULT))
-                               .WithDefault(resolution,       KeyValue::from(RESOLUTION_DEFAULT)));
+                               .WithDefault(resolution,       KeyValue::from(RESOLUTION_DEFAULT))
+                               .WithDefault(motionPrediction, KeyValue::from(false))
+                               .WithDefault(displayRate,      KeyValue::from(0))
+                               .WithDefault(displayHeadless,  KeyValue::from(false))
+                               .WithDefault(excessLatencyBudget, KeyValue::from(0)));
     }
 
     {
@@ -840,7 +868,8 @@ void TrackRobotWidget::TrackLoadButtonClicked()
 
             ExitStatus::Flags exitCode = TrackLoad( config,
                                                     m_ui->m_imageGrid,
-                                                    RobotTracker::KLT_TRACKER );
+                                                    RobotTracker::KLT_TRACKER,
+                                                    progressDialog );
 
             successful = ( exitCode == ExitStatus::OK_TO_CONTINUE );
 
@@ -872,6 +901,7 @@ void TrackRobotWidget::TrackLoadButtonClicked()
             m_ui->m_nccThresholdSpinBox->setEnabled(false);
             m_ui->m_resolutionSpinBox->setEnabled(false);
             m_ui->m_trackerThresholdSpinBox->setEnabled(false);
+            m_ui->m_motionPredictionCheckBox->setEnabled(false);
             m_ui->m_positionCombo->setEnabled(false);
             m_ui->m_useGlobalCheckBox->setEnabled(false);
             m_ui->m_cameraTrackParamsSaveBtn->setEnabled(false);
@@ -1059,6 +1089,8 @@ void TrackRobotWidget::ImageUpdate( int id, const QImage& image, double fps )
     // Set optimum fps rate if not already set or
     // new fps is less than old smaller > larger.
 
+    QMutexLocker fpsLock( &m_fpsMutex );
+
     if ( (fps > 0 && !m_fpsSet) || (m_fpsSet && fps < m_fps) )
     {
         m_fps = fps;
@@ -1066,9 +1098,88 @@ void TrackRobotWidget::ImageUpdate( int id, const QImage& image, double fps )
         m_fpsSet = true;
     }
 
+    fpsLock.unlock();
+
     emit UpdateImage( id, image, fps );
 }
 
+/**
+    Show how fast frames are being tracked and how often the views are
+    redrawn; the two differ when the display rate is limited.
+**/
+void TrackRobotWidget::SetRates( double trackingRate, double displayRate )
+{
+    m_ui->m_ratesLabel->setText( tr( "Tracking: %1 fps  Display: %2 fps" )
+                                    .arg( trackingRate, 0, 'f', 1 )
+                                    .arg( displayRate, 0, 'f', 1 ) );
+}
+
+/**
+    Apply the display rate settings; they can be changed while running.
+**/
+void TrackRobotWidget::DisplayRateChanged()
+{
+    const bool headless = m_ui->m_headlessCheckBox->isChecked();
+
+    m_ui->m_displayRateSpinBox->setEnabled( !headless );
+
+    m_scene.SetDisplayRate( m_ui->m_displayRateSpinBox->value(), headless );
+}
+
+/**
+    Show each live camera's excess latency and how many frames it has
+    dropped to stay within the excess latency budget. Camera clocks are
+    not comparable with ours, so the latency is measured from the least
+    delayed frame seen rather than end to end: the excess latency is how
+    much later than that frame each frame is tracked.
+**/
+void TrackRobotWidget::SetExcessLatency( int camera, double excessLatencyMs, unsigned int framesDropped )
+{
+    m_excessLatencyText[camera] = tr( "Camera %1: %2 ms excess, %3 dropped" )
+                                      .arg( camera + 1 )
+                                      .arg( excessLatencyMs, 0, 'f', 0 )
+                                      .arg( framesDropped );
+
+    m_ui->m_excessLatencyLabel->setText( QStringList( m_excessLatencyText.values() ).join( "  " ) );
+}
+
+/**
+    Show how each camera's KLT tracker is doing: how often the motion
+    prediction seeded it, its search window and how far the tracked
+    position was from the seed.
+**/
+void TrackRobotWidget::SetKltStats( int camera, double predictedPercent, double windowPx, double residualPx )
+{
+    m_kltText[camera] = tr( "Camera %1: %2% predicted, window %3 px, residual %4 px" )
+                            .arg( camera + 1 )
+                            .arg( predictedPercent, 0, 'f', 0 )
+                            .arg( windowPx, 0, 'f', 0 )
+                            .arg( residualPx, 0, 'f', 1 );
+
+    m_ui->m_kltLabel->setText( QStringList( m_kltText.values() ).join( "  " ) );
+}
+
+/**
+    Show how much of each camera's view of the floor
+    has been swept by the brush bar so far.
+**/
+void TrackRobotWidget::SetCoverage( int camera, double percent )
+{
+    m_coverageText[camera] = tr( "Camera %1: %2% covered" )
+                                 .arg( camera + 1 )
+                                 .arg( percent, 0, 'f', 1 );
+
+    m_ui->m_coverageLabel->setText( QStringList( m_coverageText.values() ).join( "  " ) );
+}
+
+/**
+    Apply the live excess latency budget; it can be changed while running.
+**/
+void TrackRobotWidget::ExcessLatencyBudgetChanged()
+{
+    m_scene.SetExcessLatencyBudget( m_ui->m_excessLatencyBudgetSpinBox->value() );
+}
+
 void TrackRobotWidget::ImageSet( int id, const QImage& image, double fps )
 {
     emit SetImage( id, image, fps );
@@ -1083,9 +1194,19 @@ void TrackRobotWidget::SetPosition( double position )
 // ----------------------------------------------------------------------------------------------------------------------------
 // ----------------------------------------------------------------------------------------------------------------------------
 
+/**
+    Set up a view for every camera position in the run's room.
+
+    The per-camera setup (calibration, tracker and video) runs concurrently;
+    the GUI keeps processing events while it waits and the progress dialog,
+    if given, reports how many cameras are ready. Failures are logged per
+    camera position. Only the final window and thread setup happens here
+    on the main thread, once every camera has finished.
+**/
 const ExitStatus::Flags TrackRobotWidget::TrackLoad( const WbConfig&               trackConfig,
 											             ImageGrid*                imageGrid,
-											             RobotTracker::trackerType tracker )
+											             RobotTracker::trackerType tracker,
+											             UnknownLengthProgressDlg* progressDialog )
 {
     ExitStatus::Flags exitStatus = ExitStatus::OK_TO_CONTINUE;
 
@@ -1133,7 +1254,9 @@ const ExitStatus::Flags TrackRobotWidget::TrackLoad( const WbConfig&
     // Multi-camera ground truth system
     m_scene.LoadTarget( paramsConfig );
 
-    for ( int i = 0; i < cameraPositionIds.size() && successful; ++i )
+    std::vector<GtsScene::CameraSetup> setups;
+
+    for ( int i = 0; i < cameraPositionIds.size(); ++i )
     {
         const KeyId camPosId( cameraPositionIds.at( i ) );
         const WbConfig camPosConfig( camerasPositions.ElementById( camPosId ) );
@@ -1159,19 +1282,93 @@ const ExitStatus::Flags TrackRobotWidget::TrackLoad( const WbConfig&
         const QString timestampFileName =
            trackConfig.GetAbsoluteFileNameFor( captureEntry.second.at(combo->currentIndex()) );
 
-        successful = m_scene.LoadCameraConfig( camPosId,
-                                               videoFileName.toAscii().data(),
-                                               timestampFileName.toAscii().data(),
-                                               cameraConfig,
-                                               camPosConfig,
-                                               roomConfig,
-                                               robotConfig,
-                                               trackConfig,
-                                               tracker );
+        // The configs are only read here, on the GUI thread; the
+        // cameras are set up on the thread pool from plain values.
+        GtsScene::CameraSetup setup;
+
+        if ( !GtsScene::ReadCameraSetup( camPosId,
+                                         videoFileName,
+                                         timestampFileName,
+                                         cameraConfig,
+                                         camPosConfig,
+                                         roomConfig,
+                                         robotConfig,
+                                         trackConfig,
+                                         tracker,
+                                         setup ) )
+        {
+            LOG_ERROR(QObject::tr("Setup failed for camera position %1 (%2).")
+                         .arg(camPosId)
+                         .arg(videoFileName));
+
+            successful = false;
+            continue;
+        }
+
+        setups.push_back( setup );
+    }
+
+    std::vector< QFuture<bool> > pending;
+
+    for ( size_t i = 0; i < setups.size(); ++i )
+    {
+        pending.push_back( m_scene.LoadCameraConfigAsync( setups[i] ) );
+    }
+
+    // Wait for the cameras without blocking the event loop,
+    // reporting each one as it completes.
+    std::vector<bool> reported( pending.size(), false );
+    size_t numReported = 0;
+
+    while ( numReported < pending.size() )
+    {
+        for ( size_t i = 0; i < pending.size(); ++i )
+        {
+            if ( !reported[i] && pending[i].isFinished() )
+            {
+                reported[i] = true;
+                ++numReported;
+
+                if ( !pending[i].result() )
+                {
+                    LOG_ERROR(QObject::tr("Setup failed for camera position %1 (%2).")
+                                 .arg(setups[i].camPosId)
+                                 .arg(setups[i].videoFileName));
+
+                    successful = false;
+                }
+
+                if ( progressDialog )
+                {
+                    progressDialog->Start( tr( "Loading" ),
+                                           tr( "Loaded %1 of %2 cameras" ).arg( numReported )
+                                                                          .arg( pending.size() ) );
+                }
+            }
+        }
+
+        if ( numReported < pending.size() )
+        {
+            QEventLoop loop;
+            QTimer::singleShot( 50, &loop, SLOT( quit() ) );
+            loop.exec();
+        }
     }
 
     if (successful)
     {
+        DisplayRateChanged();
+        ExcessLatencyBudgetChanged();
+
+        m_excessLatencyText.clear();
+        m_ui->m_excessLatencyLabel->clear();
+
+        m_kltText.clear();
+        m_ui->m_kltLabel->clear();
+
+        m_coverageText.clear();
+        m_ui->m_coverageLabel->clear();
+
         m_scene.SetupViewWindows( this, imageGrid );
         m_scene.SetupThread( this );
     }
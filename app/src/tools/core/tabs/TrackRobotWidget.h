@@ -25,6 +25,7 @@
 #include <QPair>
 #include <QMap>
 #include <QTime>
+#include <QtCore/QMutex>
 
 #include "Tool.h"
 #include "ImageGrid.h"
@@ -38,6 +39,7 @@
 #include <utility>
 
 class GtsScene;
+class UnknownLengthProgressDlg;
 
 namespace Ui
 {
@@ -54,6 +56,10 @@ public slots:
      void ClearTrack( int id );
      void ThreadPaused( bool trackingLost );
      void ThreadFinished();
+     void SetRates( double trackingRate, double displayRate );
+     void SetExcessLatency( int camera, double excessLatencyMs, unsigned int framesDropped );
+     void SetKltStats( int camera, double predictedPercent, double windowPx, double residualPx );
+     void SetCoverage( int camera, double percent );
 
 public:
     explicit TrackRobotWidget( QWidget* parent = 0 );
@@ -85,6 +91,8 @@ private slots:
     void StopButtonClicked();
     void TrackLoadButtonClicked();
     void TrackSaveButtonClicked();
+    void DisplayRateChanged();
+    void ExcessLatencyBudgetChanged();
 
 private:
     void SetupUi();
@@ -111,7 +119,8 @@ private:
     const bool CreateVideoDirectory( const QString& videoDirectoryName );
     const ExitStatus::Flags TrackLoad( const WbConfig&           trackConfig,
                                        ImageGrid*                imageGrid,
-                                       RobotTracker::trackerType tracker );
+                                       RobotTracker::trackerType tracker,
+                                       UnknownLengthProgressDlg* progressDialog = 0 );
     const ExitStatus::Flags TrackRun( double rate,
                                       bool trackingActive,
                                       bool singleStep,
@@ -138,6 +147,10 @@ private:
     bool m_fpsSet;
     double m_fps;
     double m_optimumRate;
+    QMutex m_fpsMutex; // views may report frames from several threads
+    QMap< int, QString > m_excessLatencyText; // per live camera
+    QMap< int, QString > m_kltText; // per tracking camera
+    QMap< int, QString > m_coverageText; // per camera
     void SetupKeyboardShortcuts();
 
     std::vector<std::pair<std::string, uint>> m_scanFwdIconRatePair;
@@ -34,6 +34,10 @@ namespace TrackRobotSchema
         const KeyName biLevelThreshold("biLevelThreshold");
         const KeyName nccThreshold    ("nccThreshold");
         const KeyName resolution      ("resolution");
+        const KeyName motionPrediction("motionPrediction");
+        const KeyName displayRate     ("displayRate");
+        const KeyName displayHeadless ("displayHeadless");
+        const KeyName excessLatencyBudget("excessLatencyBudget");
     }
 
     namespace PerCameraTrackingParams
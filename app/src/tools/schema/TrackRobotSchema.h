@@ -37,6 +37,10 @@ namespace TrackRobotSchema
         extern const KeyName biLevelThreshold;
         extern const KeyName nccThreshold;
         extern const KeyName resolution;
+        extern const KeyName motionPrediction;
+        extern const KeyName displayRate;
+        extern const KeyName displayHeadless;
+        extern const KeyName excessLatencyBudget; // ms behind the least delayed live frame before skipping ahead
     }
 
     namespace PerCameraTrackingParams
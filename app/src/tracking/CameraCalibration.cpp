@@ -31,7 +31,14 @@
 #include <opencv/highgui.h>
 #include <opencv/cvaux.h>
 
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDateTime>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+
+#include <algorithm>
 #include <cassert>
+#include <cstring>
 
 struct CalibViewArgs
 {
@@ -45,9 +52,58 @@ struct CalibViewArgs
     const RobotMetrics& m_met;
 };
 
+namespace
+{
+    const quint32 WARP_CACHE_MAGIC   = 0x50575447; // "GTWP"
+    const quint32 WARP_CACHE_VERSION = 1;
+
+    /**
+        Fixed-size header of a warp cache file. It is followed by the
+        float x map, float y map, float gradient-magnitude map (all
+        width x height, densely packed) and the 8-bit warped calibration
+        image (also densely packed).
+    **/
+    struct WarpCacheHeader
+    {
+        quint32 magic;
+        quint32 version;
+        char    key[20];
+        qint32  width;
+        qint32  height;
+        float   offset[2];
+        float   rot[9];
+        float   trans[3];
+        float   cameraCentre[3];
+    };
+
+    qint64 WarpCacheSize( int width, int height )
+    {
+        const qint64 pixels = (qint64)width * height;
+        return sizeof( WarpCacheHeader ) + 3 * pixels * sizeof( float ) + pixels;
+    }
+
+    void CopyToDenseRows( uchar* dst, const uchar* src, int srcStep, int rowBytes, int rows )
+    {
+        for ( int i = 0; i < rows; ++i )
+        {
+            memcpy( dst + i * rowBytes, src + i * srcStep, rowBytes );
+        }
+    }
+
+    void CopyFromDenseRows( uchar* dst, int dstStep, const uchar* src, int rowBytes, int rows )
+    {
+        for ( int i = 0; i < rows; ++i )
+        {
+            memcpy( dst + i * dstStep, src + i * rowBytes, rowBytes );
+        }
+    }
+}
+
 CameraCalibration::CameraCalibration() :
     m_mapx         ( 0 ),
     m_mapy         ( 0 ),
+    m_mapxy        ( 0 ),
+    m_mapInterp    ( 0 ),
     m_mapDx        ( 0 ),
     m_mapDy        ( 0 ),
     m_mapGM        ( 0 ),
@@ -69,6 +125,7 @@ CameraCalibration::~CameraCalibration()
 {
     cvReleaseMat( &m_mapx );
     cvReleaseMat( &m_mapy );
+    ReleaseFixedPointMaps();
     cvReleaseMat( &m_mapDx );
     cvReleaseMat( &m_mapDy );
     cvReleaseMat( &m_mapGM );
@@ -77,60 +134,66 @@ CameraCalibration::~CameraCalibration()
 }
 
 /**
-    Load the intrinsic camera parameters from config.
+    Read the intrinsic camera parameters from config.
 **/
-bool CameraCalibration::LoadIntrinsicCalibration( const WbConfig& cameraCalCfg )
+bool CameraCalibration::ReadIntrinsicCalibration( const WbConfig& cameraCalCfg, ConfigParams& params )
 {
     bool successful = true;
 
-    m_imageWidth = cameraCalCfg.GetKeyValue(
+    CvMat intrinsic = cvMat( 3, 3, CV_32F, params.intrinsic );
+    CvMat distortion = cvMat( 1, 5, CV_32F, params.distortion );
+    CvMat inverse = cvMat( 1, 5, CV_32F, params.inverse );
+
+    params.imageWidth = cameraCalCfg.GetKeyValue(
                        CalibrationSchema::imageWidthKey ).ToInt();
-    m_imageHeight = cameraCalCfg.GetKeyValue(
+    params.imageHeight = cameraCalCfg.GetKeyValue(
                        CalibrationSchema::imageHeightKey ).ToInt();
 
     if (successful)
     {
         successful = cameraCalCfg.GetKeyValue(
-                       CalibrationSchema::cameraMatrixKey).ToCvMat(m_intrinsic);
+                       CalibrationSchema::cameraMatrixKey).ToCvMat(intrinsic);
     }
 
     if (successful)
     {
         successful = cameraCalCfg.GetKeyValue(
-                       CalibrationSchema::distortionCoefficientsKey).ToCvMat(m_distortion);
+                       CalibrationSchema::distortionCoefficientsKey).ToCvMat(distortion);
     }
 
     if (successful)
     {
         successful = cameraCalCfg.GetKeyValue(
-                       CalibrationSchema::invDistortionCoefficientsKey).ToCvMat(m_inverse);
+                       CalibrationSchema::invDistortionCoefficientsKey).ToCvMat(inverse);
     }
 
     if (successful)
     {
-        LOG_INFO(QObject::tr("Image dimensions (WxH): %1,%2").arg(m_imageWidth).
-                                                              arg(m_imageHeight));
+        LOG_INFO(QObject::tr("Image dimensions (WxH): %1,%2").arg(params.imageWidth).
+                                                              arg(params.imageHeight));
 
         LOG_INFO("Camera matrix:");
-        OpenCvUtility::LogCvMat32F(&m_intrinsic);
+        OpenCvUtility::LogCvMat32F(&intrinsic);
 
         LOG_INFO("Distortion coefficients:");
-        OpenCvUtility::LogCvMat32F(&m_distortion);
+        OpenCvUtility::LogCvMat32F(&distortion);
 
         LOG_INFO("Inverse coefficients:");
-        OpenCvUtility::LogCvMat32F(&m_inverse);
+        OpenCvUtility::LogCvMat32F(&inverse);
     }
 
     return successful;
 }
 
 /**
-    Load the camera transform parameters from config.
+    Read the camera transform parameters from config.
 **/
-bool CameraCalibration::LoadCameraTransform( const KeyId camPosId, const WbConfig& floorPlanCfg )
+bool CameraCalibration::ReadCameraTransform( const KeyId camPosId, const WbConfig& floorPlanCfg, ConfigParams& params )
 {
     bool successful = false;
 
+    CvMat transform = cvMat( 3, 3, CV_32F, params.transform );
+
     const WbKeyValues::ValueIdPairList cameraTransformIds =
         floorPlanCfg.GetKeyValues( FloorPlanSchema::transformKey );
     for (WbKeyValues::ValueIdPairList::const_iterator itt = cameraTransformIds.begin(); itt != cameraTransformIds.end(); ++itt)
@@ -161,10 +224,10 @@ bool CameraCalibration::LoadCameraTransform( const KeyId camPosId, const WbConfi
             transl_f[2] = offsetX;
             transl_f[5] = offsetY;
 
-            cvMatMul(&transl, &transf, &m_transform);
+            cvMatMul(&transl, &transf, &transform);
 
             LOG_INFO("With offsets:");
-            OpenCvUtility::LogCvMat32F(&m_transform);
+            OpenCvUtility::LogCvMat32F(&transform);
 
             break;
         }
@@ -173,6 +236,27 @@ bool CameraCalibration::LoadCameraTransform( const KeyId camPosId, const WbConfi
     return successful;
 }
 
+/**
+    Set the intrinsic camera parameters (as read by ReadIntrinsicCalibration).
+**/
+void CameraCalibration::SetIntrinsicCalibration( const ConfigParams& params )
+{
+    m_imageWidth = params.imageWidth;
+    m_imageHeight = params.imageHeight;
+
+    memcpy( m_intrinsic_f, params.intrinsic, sizeof(m_intrinsic_f) );
+    memcpy( m_distortion_f, params.distortion, sizeof(m_distortion_f) );
+    memcpy( m_inverse_f, params.inverse, sizeof(m_inverse_f) );
+}
+
+/**
+    Set the camera transform (as read by ReadCameraTransform).
+**/
+void CameraCalibration::SetCameraTransform( const ConfigParams& params )
+{
+    memcpy( m_transform_f, params.transform, sizeof(m_transform_f) );
+}
+
 /**
     Computes the external calibration parameters (rotation and translation) for a camera.
     @param boardSize The size of the chequer board calibration target
@@ -180,12 +264,27 @@ bool CameraCalibration::LoadCameraTransform( const KeyId camPosId, const WbConfi
     @param viewWarp  Pointer to the image to use for calibration
     @param interactive If it is true then the calibration will be interactive displaying images and waiting for key-presses before continuing.
 **/
-bool CameraCalibration::PerformExtrinsicCalibration( CvSize        boardSize,
-                                                     RobotMetrics& metrics,
-                                                     IplImage**    viewWarp,
-                                                     const bool    scaled,
-                                                     const char*   calImage  )
+bool CameraCalibration::PerformExtrinsicCalibration( CvSize         boardSize,
+                                                     RobotMetrics&  metrics,
+                                                     IplImage**     viewWarp,
+                                                     const bool     scaled,
+                                                     const char*    calImage,
+                                                     const QString& cacheFileName )
 {
+    // SCALED_PIXELS builds update the metrics from the detected
+    // chessboard, so they always have to go through detection.
+#ifndef SCALED_PIXELS
+    const QByteArray cacheKey( ComputeWarpCacheKey( boardSize, metrics, scaled, calImage ) );
+
+    if ( !cacheFileName.isEmpty() && LoadWarpCache( cacheFileName, cacheKey, viewWarp ) )
+    {
+        LOG_INFO(QObject::tr("Loaded ground-plane warp from cache: %1.")
+                    .arg(cacheFileName));
+
+        return true;
+    }
+#endif
+
     bool success = true;
     IplImage* view = cvLoadImage( calImage, 1 );
 
@@ -243,6 +342,7 @@ bool CameraCalibration::PerformExtrinsicCalibration( CvSize        boardSize,
 
             // Compute undistortion maps for the ground plane
             // (these will be used to undistort entire sequence)
+            ReleaseFixedPointMaps();
             *viewWarp = GroundPlaneUtility::computeGroundPlaneWarpBatch( viewGrey,
                                                                          GetIntrinsicParams(),
                                                                          GetDistortionParams(),
@@ -265,6 +365,14 @@ bool CameraCalibration::PerformExtrinsicCalibration( CvSize        boardSize,
             // Compute the warp gradients
             ComputeWarpGradientMagnitude();
 
+#ifndef SCALED_PIXELS
+            if ( !cacheFileName.isEmpty() && !SaveWarpCache( cacheFileName, cacheKey, *viewWarp ) )
+            {
+                LOG_WARN(QObject::tr("Could not write ground-plane warp cache: %1.")
+                            .arg(cacheFileName));
+            }
+#endif
+
             cvReleaseMat( &objectPoints );
         }
         else
@@ -300,6 +408,282 @@ float CameraCalibration::ComputeSquareSize(CvMat* imagePoints)
     return sqrt(x*x + y*y);
 }
 
+/**
+    Unwarps the ground plane from src into dst.
+
+    Uses the fixed-point maps (16-bit integer coordinates plus an index
+    into OpenCV's interpolation table): the fastest cvRemap path, and half
+    the memory traffic of the floating point maps. The difference from
+    remapping with the floating point maps is at most 1/32 pixel of position.
+**/
+void CameraCalibration::UnwarpGroundPlane( const IplImage* src, IplImage* dst )
+{
+    BuildFixedPointMaps();
+
+    cvRemap( src, dst, m_mapxy, m_mapInterp, CV_INTER_LINEAR );
+}
+
+/**
+    Unwarps only the region roi of the ground plane image dst (clipped to dst).
+    Pixels of dst outside roi are left untouched.
+**/
+void CameraCalibration::UnwarpGroundPlane( const IplImage* src, IplImage* dst, CvRect roi )
+{
+    const int x0 = std::max( roi.x, 0 );
+    const int y0 = std::max( roi.y, 0 );
+    const int x1 = std::min( roi.x + roi.width, std::min( dst->width, m_mapx->cols ) );
+    const int y1 = std::min( roi.y + roi.height, std::min( dst->height, m_mapx->rows ) );
+
+    if ( x1 <= x0 || y1 <= y0 )
+    {
+        return;
+    }
+
+    roi = cvRect( x0, y0, x1 - x0, y1 - y0 );
+
+    BuildFixedPointMaps();
+
+    CvMat mapxy;
+    CvMat mapInterp;
+    cvGetSubRect( m_mapxy, &mapxy, roi );
+    cvGetSubRect( m_mapInterp, &mapInterp, roi );
+
+    cvSetImageROI( dst, roi );
+    cvRemap( src, dst, &mapxy, &mapInterp, CV_INTER_LINEAR );
+    cvResetImageROI( dst );
+}
+
+/**
+    Replace the ground plane warp (floating point maps, as computed by
+    GroundPlaneUtility::computeGroundPlaneWarpBatch). Takes ownership of
+    the maps.
+**/
+void CameraCalibration::SetGroundPlaneMaps( CvMat* mapx, CvMat* mapy )
+{
+    ReleaseFixedPointMaps();
+
+    cvReleaseMat( &m_mapx );
+    cvReleaseMat( &m_mapy );
+
+    m_mapx = mapx;
+    m_mapy = mapy;
+}
+
+/**
+    Computes the key for a cached ground-plane warp.
+    @param boardSize The size of the chequer board calibration target
+    @param metrics   Parameters describing dimensions of robot
+    @param scaled    Whether the warp is at the tracking resolution
+    @param calImage  The calibration image file name
+    @return A hash of the intrinsic parameters, the board and square size,
+    the resolution, the image size and the calibration image itself (path,
+    size and modification time), so the board need not be detected first.
+**/
+QByteArray CameraCalibration::ComputeWarpCacheKey( CvSize              boardSize,
+                                                   const RobotMetrics& metrics,
+                                                   const bool          scaled,
+                                                   const char*         calImage ) const
+{
+    QCryptographicHash hash( QCryptographicHash::Sha1 );
+
+    hash.addData( (const char*)&WARP_CACHE_VERSION, sizeof(WARP_CACHE_VERSION) );
+    hash.addData( (const char*)m_intrinsic_f, sizeof(m_intrinsic_f) );
+    hash.addData( (const char*)m_distortion_f, sizeof(m_distortion_f) );
+    hash.addData( (const char*)m_inverse_f, sizeof(m_inverse_f) );
+
+    const qint32 sizes[] = { m_imageWidth, m_imageHeight,
+                             boardSize.width, boardSize.height,
+                             scaled ? 1 : 0 };
+    hash.addData( (const char*)sizes, sizeof(sizes) );
+
+    const float metricValues[] = { metrics.GetResolution(),
+                                   metrics.GetSquareSizePx(),
+                                   metrics.GetSquareSizeCm() };
+    hash.addData( (const char*)metricValues, sizeof(metricValues) );
+
+    const QFileInfo calImageInfo( calImage );
+    hash.addData( calImageInfo.absoluteFilePath().toUtf8() );
+
+    const qint64 calImageStamp[] = { calImageInfo.size(),
+                                     calImageInfo.lastModified().toMSecsSinceEpoch() };
+    hash.addData( (const char*)calImageStamp, sizeof(calImageStamp) );
+
+    return hash.result();
+}
+
+/**
+    Loads the ground-plane warp and extrinsic parameters from a cache file.
+    @param fileName The cache file written by SaveWarpCache
+    @param key      The key from ComputeWarpCacheKey
+    @param viewWarp Set to the warped calibration image
+    @return false if the file is missing or its key or size do not match.
+**/
+bool CameraCalibration::LoadWarpCache( const QString&    fileName,
+                                       const QByteArray& key,
+                                       IplImage**        viewWarp )
+{
+    QFile file( fileName );
+
+    if ( !file.open( QIODevice::ReadOnly ) ||
+         file.size() < (qint64)sizeof( WarpCacheHeader ) )
+    {
+        return false;
+    }
+
+    const uchar* data = file.map( 0, file.size() );
+
+    if ( !data )
+    {
+        return false;
+    }
+
+    WarpCacheHeader header;
+    memcpy( &header, data, sizeof(header) );
+
+    const bool valid = header.magic == WARP_CACHE_MAGIC &&
+                       header.version == WARP_CACHE_VERSION &&
+                       key.size() == (int)sizeof(header.key) &&
+                       memcmp( header.key, key.constData(), sizeof(header.key) ) == 0 &&
+                       header.width > 0 &&
+                       header.height > 0 &&
+                       file.size() == WarpCacheSize( header.width, header.height );
+
+    if ( valid )
+    {
+        const int w = header.width;
+        const int h = header.height;
+        const int mapBytes = w * h * sizeof(float);
+        const uchar* p = data + sizeof(header);
+
+        CvMat* mapx = cvCreateMat( h, w, CV_32F );
+        CvMat* mapy = cvCreateMat( h, w, CV_32F );
+
+        CopyFromDenseRows( mapx->data.ptr, mapx->step, p, w * sizeof(float), h );
+        p += mapBytes;
+        CopyFromDenseRows( mapy->data.ptr, mapy->step, p, w * sizeof(float), h );
+        p += mapBytes;
+
+        SetGroundPlaneMaps( mapx, mapy );
+
+        cvReleaseMat( &m_mapDx );
+        cvReleaseMat( &m_mapDy );
+        cvReleaseMat( &m_mapGM );
+        m_mapGM = cvCreateMat( h, w, CV_32F );
+        CopyFromDenseRows( m_mapGM->data.ptr, m_mapGM->step, p, w * sizeof(float), h );
+        p += mapBytes;
+
+        *viewWarp = cvCreateImage( cvSize( w, h ), IPL_DEPTH_8U, 1 );
+        CopyFromDenseRows( (uchar*)(*viewWarp)->imageData, (*viewWarp)->widthStep, p, w, h );
+
+        cvReleaseImage( &m_calWarpImg );
+        m_calWarpImg = cvCloneImage( *viewWarp );
+
+        m_offset = cvPoint2D32f( header.offset[0], header.offset[1] );
+        memcpy( m_rot_f, header.rot, sizeof(m_rot_f) );
+        memcpy( m_trans_f, header.trans, sizeof(m_trans_f) );
+        memcpy( m_cC_f, header.cameraCentre, sizeof(m_cC_f) );
+    }
+    else
+    {
+        LOG_INFO(QObject::tr("Ignoring stale ground-plane warp cache: %1.")
+                    .arg(fileName));
+    }
+
+    file.unmap( const_cast<uchar*>( data ) );
+
+    return valid;
+}
+
+/**
+    Saves the ground-plane warp and extrinsic parameters to a cache file.
+    @param fileName The cache file to (over)write
+    @param key      The key from ComputeWarpCacheKey
+    @param viewWarp The warped calibration image
+    @return false if there is no warp yet or the file cannot be written.
+**/
+bool CameraCalibration::SaveWarpCache( const QString&    fileName,
+                                       const QByteArray& key,
+                                       const IplImage*   viewWarp ) const
+{
+    if ( !m_mapx || !m_mapy || !m_mapGM || !viewWarp ||
+         key.size() != (int)sizeof(((WarpCacheHeader*)0)->key) )
+    {
+        return false;
+    }
+
+    const int w = m_mapx->cols;
+    const int h = m_mapx->rows;
+
+    WarpCacheHeader header;
+    header.magic = WARP_CACHE_MAGIC;
+    header.version = WARP_CACHE_VERSION;
+    memcpy( header.key, key.constData(), sizeof(header.key) );
+    header.width = w;
+    header.height = h;
+    header.offset[0] = m_offset.x;
+    header.offset[1] = m_offset.y;
+    memcpy( header.rot, m_rot_f, sizeof(header.rot) );
+    memcpy( header.trans, m_trans_f, sizeof(header.trans) );
+    memcpy( header.cameraCentre, m_cC_f, sizeof(header.cameraCentre) );
+
+    QFile file( fileName );
+
+    if ( !file.open( QIODevice::ReadWrite | QIODevice::Truncate ) ||
+         !file.resize( WarpCacheSize( w, h ) ) )
+    {
+        return false;
+    }
+
+    uchar* data = file.map( 0, file.size() );
+
+    if ( !data )
+    {
+        file.close();
+        file.remove();
+        return false;
+    }
+
+    const int mapBytes = w * h * sizeof(float);
+    uchar* p = data + sizeof(header);
+
+    CopyToDenseRows( p, m_mapx->data.ptr, m_mapx->step, w * sizeof(float), h );
+    p += mapBytes;
+    CopyToDenseRows( p, m_mapy->data.ptr, m_mapy->step, w * sizeof(float), h );
+    p += mapBytes;
+    CopyToDenseRows( p, m_mapGM->data.ptr, m_mapGM->step, w * sizeof(float), h );
+    p += mapBytes;
+    CopyToDenseRows( p, (const uchar*)viewWarp->imageData, viewWarp->widthStep, w, h );
+
+    // Header goes in last so a partially written file is never accepted.
+    memcpy( data, &header, sizeof(header) );
+
+    return file.unmap( data );
+}
+
+/**
+    Convert the floating point maps to the packed fixed-point
+    representation used for per-frame unwarping (once).
+    The floating point maps are kept for the warp gradients.
+**/
+void CameraCalibration::BuildFixedPointMaps()
+{
+    if ( m_mapxy || !m_mapx || !m_mapy )
+    {
+        return;
+    }
+
+    m_mapxy = cvCreateMat( m_mapx->rows, m_mapx->cols, CV_16SC2 );
+    m_mapInterp = cvCreateMat( m_mapx->rows, m_mapx->cols, CV_16UC1 );
+
+    cvConvertMaps( m_mapx, m_mapy, m_mapxy, m_mapInterp );
+}
+
+void CameraCalibration::ReleaseFixedPointMaps()
+{
+    cvReleaseMat( &m_mapxy );
+    cvReleaseMat( &m_mapInterp );
+}
+
 void CameraCalibration::ComputeWarpGradientMagnitude()
 {
     m_mapDx = OpenCvUtility::GradientMagCv32fc1( m_mapx );
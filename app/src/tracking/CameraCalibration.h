@@ -40,15 +40,33 @@ public:
     CameraCalibration();
     ~CameraCalibration();
 
-    bool LoadIntrinsicCalibration( const WbConfig& cameraCalCfg );
-
-    bool LoadCameraTransform( const KeyId camPosId, const WbConfig& floorPlanCfg );
-
-    bool PerformExtrinsicCalibration(CvSize        boardSize,
-                                      RobotMetrics& metrics,
-                                      IplImage**    viewWarp,
-                                      const bool    scaled,
-                                      const char*   calImage );
+    /**
+        The calibration values kept in the workbench configs. WbConfig
+        handles share their data, so the values are read into this on the
+        GUI thread and set from there on any thread.
+    **/
+    struct ConfigParams
+    {
+        int   imageWidth;
+        int   imageHeight;
+        float intrinsic[9];
+        float distortion[5];
+        float inverse[5];
+        float transform[9];
+    };
+
+    static bool ReadIntrinsicCalibration( const WbConfig& cameraCalCfg, ConfigParams& params );
+    static bool ReadCameraTransform( const KeyId camPosId, const WbConfig& floorPlanCfg, ConfigParams& params );
+
+    void SetIntrinsicCalibration( const ConfigParams& params );
+    void SetCameraTransform( const ConfigParams& params );
+
+    bool PerformExtrinsicCalibration(CvSize         boardSize,
+                                      RobotMetrics&  metrics,
+                                      IplImage**     viewWarp,
+                                      const bool     scaled,
+                                      const char*    calImage,
+                                      const QString& cacheFileName = QString() );
 
     void ComputeWarpGradientMagnitude();
 
@@ -56,7 +74,10 @@ public:
 
     void ComputeExtrinsicParams( const CvMat* objectPoints, const CvMat* imagePoints );
 
-    void UnwarpGroundPlane( const IplImage* src, IplImage* dst ) { cvRemap( src, dst, m_mapx, m_mapy, CV_INTER_LINEAR ); };
+    void UnwarpGroundPlane( const IplImage* src, IplImage* dst );
+    void UnwarpGroundPlane( const IplImage* src, IplImage* dst, CvRect roi );
+
+    void SetGroundPlaneMaps( CvMat* mapx, CvMat* mapy );
 
     void PlotCameraCentre( IplImage* img, const RobotMetrics& metrics );
 
@@ -99,8 +120,20 @@ public:
     const IplImage* GetWarpedCalibrationImage() const { return m_calWarpImg; };
 
 private:
+    QByteArray ComputeWarpCacheKey( CvSize              boardSize,
+                                    const RobotMetrics& metrics,
+                                    const bool          scaled,
+                                    const char*         calImage ) const;
+    bool LoadWarpCache( const QString& fileName, const QByteArray& key, IplImage** viewWarp );
+    bool SaveWarpCache( const QString& fileName, const QByteArray& key, const IplImage* viewWarp ) const;
+
+    void BuildFixedPointMaps();
+    void ReleaseFixedPointMaps();
+
     CvMat* m_mapx;         // Stores precomputed undistortion map x-coords
     CvMat* m_mapy;         // Stores precomputed undistortion map y-coords
+    CvMat* m_mapxy;        // Fixed-point (CV_16SC2) version of m_mapx/m_mapy, built on demand
+    CvMat* m_mapInterp;    // Interpolation table indices (CV_16UC1) to go with m_mapxy
     CvMat* m_mapDx;        // x gradient-magnitude of undistortion
     CvMat* m_mapDy;        // y gradient-magnitude of undistortion
     CvMat* m_mapGM;        // combined grad-mag of x and y map derivatives
@@ -0,0 +1,226 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "CoverageGrid.h"
+
+#include <algorithm>
+
+#include <assert.h>
+
+const int CoverageGrid::TILE_BITS;
+const int CoverageGrid::TILE_SIZE;
+const unsigned int CoverageGrid::MAX_COUNT;
+
+namespace
+{
+    const int TILE_PIXELS = CoverageGrid::TILE_SIZE * CoverageGrid::TILE_SIZE;
+}
+
+/**
+    Creates an empty grid covering an image of @a size; no tiles
+    are allocated until they are first written.
+ **/
+CoverageGrid::CoverageGrid( CvSize size ) :
+    m_size     ( size ),
+    m_tilesX   ( ( size.width + TILE_SIZE - 1 ) >> TILE_BITS ),
+    m_tilesY   ( ( size.height + TILE_SIZE - 1 ) >> TILE_BITS ),
+    m_allocated( 0 )
+{
+    m_tiles.resize( m_tilesX * m_tilesY, 0 );
+}
+
+CoverageGrid::~CoverageGrid()
+{
+    Clear();
+}
+
+/**
+    Releases every tile, returning all counts to zero.
+ **/
+void CoverageGrid::Clear()
+{
+    for ( size_t i = 0; i < m_tiles.size(); ++i )
+    {
+        delete[] m_tiles[i];
+        m_tiles[i] = 0;
+    }
+
+    m_allocated = 0;
+}
+
+/**
+    @return The pixels covered by tile (tx, ty), clipped to the grid.
+ **/
+CvRect CoverageGrid::TileRect( int tx, int ty ) const
+{
+    const int x = tx << TILE_BITS;
+    const int y = ty << TILE_BITS;
+
+    return cvRect( x, y,
+                   std::min( TILE_SIZE, m_size.width - x ),
+                   std::min( TILE_SIZE, m_size.height - y ) );
+}
+
+/**
+    @return The counts of tile (tx, ty) with rows TILE_SIZE apart,
+            or 0 if nothing has been written to it.
+ **/
+const unsigned short* CoverageGrid::Tile( int tx, int ty ) const
+{
+    return m_tiles[ty * m_tilesX + tx];
+}
+
+/**
+    Returns the counter for pixel (x, y), allocating its tile if needed.
+    The counters which follow it up to the right edge of the tile are
+    contiguous, so a run can be updated through the one pointer.
+ **/
+unsigned short* CoverageGrid::Acquire( int x, int y )
+{
+    assert( x >= 0 && x < m_size.width && y >= 0 && y < m_size.height );
+
+    unsigned short*& tile = m_tiles[( y >> TILE_BITS ) * m_tilesX + ( x >> TILE_BITS )];
+
+    if ( !tile )
+    {
+        tile = new unsigned short[TILE_PIXELS];
+        std::fill( tile, tile + TILE_PIXELS, (unsigned short)0 );
+        ++m_allocated;
+    }
+
+    return tile + ( ( y & ( TILE_SIZE - 1 ) ) << TILE_BITS ) + ( x & ( TILE_SIZE - 1 ) );
+}
+
+/**
+    @return The count at pixel (x, y).
+ **/
+unsigned int CoverageGrid::Get( int x, int y ) const
+{
+    const unsigned short* tile = Tile( x >> TILE_BITS, y >> TILE_BITS );
+
+    if ( !tile )
+    {
+        return 0;
+    }
+
+    return tile[( ( y & ( TILE_SIZE - 1 ) ) << TILE_BITS ) + ( x & ( TILE_SIZE - 1 ) )];
+}
+
+/**
+    Writes the counts to an image of the same size.
+
+    An 8-bit image gets the raw-coverage format written by
+    CoverageSystem::SaveMask, with counts above 255 saturated;
+    a 16-bit image gets the counts exactly.
+ **/
+void CoverageGrid::Export( IplImage* dst ) const
+{
+    assert( dst->width == m_size.width && dst->height == m_size.height && dst->nChannels == 1 );
+    assert( dst->depth == IPL_DEPTH_8U || dst->depth == IPL_DEPTH_16U );
+
+    cvZero( dst );
+
+    for ( int ty = 0; ty < m_tilesY; ++ty )
+    {
+        for ( int tx = 0; tx < m_tilesX; ++tx )
+        {
+            const unsigned short* tile = Tile( tx, ty );
+
+            if ( !tile )
+            {
+                continue;
+            }
+
+            const CvRect rect = TileRect( tx, ty );
+
+            for ( int r = 0; r < rect.height; ++r )
+            {
+                const unsigned short* pCount = tile + ( r << TILE_BITS );
+                char* pRow = dst->imageData + ( rect.y + r ) * dst->widthStep;
+
+                if ( dst->depth == IPL_DEPTH_16U )
+                {
+                    std::copy( pCount, pCount + rect.width, (unsigned short*)pRow + rect.x );
+                }
+                else
+                {
+                    unsigned char* pOut = (unsigned char*)pRow + rect.x;
+
+                    for ( int c = 0; c < rect.width; ++c )
+                    {
+                        pOut[c] = (unsigned char)std::min( (unsigned int)pCount[c], 255u );
+                    }
+                }
+            }
+        }
+    }
+}
+
+/**
+    Counts the pixels at each pass count, with 255 standing for 255 or more.
+
+    Only allocated tiles are read: all other pixels are at zero passes.
+
+    @param floorMask Optional mask; if given only its non-zero pixels are counted.
+    @param numPixels The number of pixels counted over the whole grid (the
+                     floor area, or the grid area without a floor mask).
+    @param histogram Receives the count of pixels at each level.
+ **/
+void CoverageGrid::Histogram( const IplImage* floorMask,
+                              unsigned int    numPixels,
+                              unsigned int    histogram[256] ) const
+{
+    std::fill( histogram, histogram + 256, 0u );
+
+    for ( int ty = 0; ty < m_tilesY; ++ty )
+    {
+        for ( int tx = 0; tx < m_tilesX; ++tx )
+        {
+            const unsigned short* tile = Tile( tx, ty );
+
+            if ( !tile )
+            {
+                continue;
+            }
+
+            const CvRect rect = TileRect( tx, ty );
+
+            for ( int r = 0; r < rect.height; ++r )
+            {
+                const unsigned short* pCount = tile + ( r << TILE_BITS );
+                const char* pFloor = floorMask ? floorMask->imageData + ( rect.y + r ) * floorMask->widthStep + rect.x : 0;
+
+                for ( int c = 0; c < rect.width; ++c )
+                {
+                    if ( pCount[c] != 0 && ( !pFloor || pFloor[c] != 0 ) )
+                    {
+                        ++histogram[std::min( (unsigned int)pCount[c], 255u )];
+                    }
+                }
+            }
+        }
+    }
+
+    unsigned int covered = 0;
+    for ( int v = 1; v < 256; ++v )
+    {
+        covered += histogram[v];
+    }
+
+    histogram[0] = numPixels - covered;
+}
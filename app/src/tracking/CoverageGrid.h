@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef COVERAGEGRID_H
+#define COVERAGEGRID_H
+
+#include <opencv/cv.h>
+
+#include <vector>
+
+/**
+    Per-pixel pass counters for a floor plan, stored as square tiles of
+    16-bit counts which are only allocated once something touches them.
+
+    Memory and the cost of whole-grid operations (export, statistics)
+    therefore grow with the area the robot visited rather than with the
+    size of the floor plan. Counts saturate at MAX_COUNT instead of
+    wrapping.
+**/
+class CoverageGrid
+{
+public:
+    static const int TILE_BITS = 6;
+    static const int TILE_SIZE = 1 << TILE_BITS;
+    static const unsigned int MAX_COUNT = 0xffff;
+
+    explicit CoverageGrid( CvSize size );
+    ~CoverageGrid();
+
+    CvSize GetSize() const { return m_size; }
+
+    int GetTilesX() const { return m_tilesX; }
+    int GetTilesY() const { return m_tilesY; }
+    unsigned int GetAllocatedTileCount() const { return m_allocated; }
+
+    CvRect TileRect( int tx, int ty ) const;
+    const unsigned short* Tile( int tx, int ty ) const;
+
+    unsigned short* Acquire( int x, int y );
+    unsigned int Get( int x, int y ) const;
+
+    void Clear();
+
+    void Export( IplImage* dst ) const;
+
+    void Histogram( const IplImage* floorMask,
+                    unsigned int    numPixels,
+                    unsigned int    histogram[256] ) const;
+
+private:
+    CoverageGrid( const CoverageGrid& );
+    CoverageGrid& operator=( const CoverageGrid& );
+
+    CvSize m_size;
+    int    m_tilesX;
+    int    m_tilesY;
+
+    unsigned int m_allocated;
+    std::vector<unsigned short*> m_tiles; // row-major, 0 until allocated
+};
+
+#endif // COVERAGEGRID_H
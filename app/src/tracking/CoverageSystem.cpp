@@ -18,27 +18,34 @@
 
 #include "CoverageSystem.h"
 
+#include "CoverageStatistics.h"
 #include "KltTracker.h"
+#include "OpenCvTools.h"
 #include "RobotMetrics.h"
 
 #include "Logging.h"
 
 #include <opencv/highgui.h>
 
+#include <algorithm>
+
 /**
     A coverage system is initialised with
     the dimensions of the tracking image.
+
+    Pass counts are kept in a sparse tiled grid, so
+    nothing the size of the image is allocated here.
  **/
 CoverageSystem::CoverageSystem( CvSize warpedImageSize ) :
+    m_grid       ( warpedImageSize ),
     m_cvgMask    ( 0 ),
     m_floorMask  ( 0 ),
-    m_floorPixels( 0 )
+    m_floorPixels( 0 ),
+    m_levelsValid( false ),
+    m_inOutMask  ( 0 ),
+    m_inOutRoi   ( cvRect( 0, 0, 0, 0 ) ),
+    m_colMap     ( 0 )
 {
-    m_cvgMask = cvCreateImage( warpedImageSize, IPL_DEPTH_8U, 1 );
-    cvZero( m_cvgMask );
-
-    m_inOutMask = cvCreateImage( warpedImageSize, IPL_DEPTH_8U, 1 );
-    m_colMap = cvCreateImage( warpedImageSize, IPL_DEPTH_8U, 3 );
 }
 
 /**
@@ -53,6 +60,20 @@ CoverageSystem::~CoverageSystem()
     cvReleaseImage( &m_colMap );
 }
 
+/**
+    Forget all coverage recorded so far (the floor mask is kept).
+ **/
+void CoverageSystem::Reset()
+{
+    m_grid.Clear();
+
+    ClearInOutMask();
+
+    std::fill( m_levelPixels, m_levelPixels + 256, 0u );
+    m_levelPixels[0] = m_floorPixels;
+    m_levelsValid = m_floorMask != 0;
+}
+
 /**
     This function does an update for repeat coverage monitoring.
     The robot moves in and out of pixels inthe floor plane, and
@@ -65,21 +86,43 @@ CoverageSystem::~CoverageSystem()
  **/
 void CoverageSystem::Update( CvPoint2D32f prev, CvPoint2D32f curr, float radiusPx )
 {
-    cvZero( m_inOutMask );
+    if ( !m_inOutMask )
+    {
+        m_inOutMask = cvCreateImage( m_grid.GetSize(), IPL_DEPTH_8U, 1 );
+        cvZero( m_inOutMask );
+    }
+
+    ClearInOutMask();
 
     int radius = (int)(radiusPx + .5f);
     CvPoint pp = cvPoint( (int)(prev.x + .5f), (int)(prev.y + .5f) );
     CvPoint pc = cvPoint( (int)(curr.x + .5f), (int)(curr.y + .5f) );
 
-    cvCircle( m_inOutMask, pp, radius, CV_RGB( 255, 255, 255 ), CV_FILLED ); // previous occupancy
-    cvCircle( m_inOutMask, pc, radius, CV_RGB( 0, 0, 0 ), CV_FILLED ); // effectively 'subtracts' current occupancy from previous
+    // Only pixels in the previous circle can be uncovered.
+    const CvRect roi = UpdateRegion( pp.x - radius, pp.y - radius, pp.x + radius, pp.y + radius );
+
+    if ( roi.width > 0 && roi.height > 0 )
+    {
+        cvSetImageROI( m_inOutMask, roi );
+
+        cvCircle( m_inOutMask, cvPoint( pp.x - roi.x, pp.y - roi.y ), radius, CV_RGB( 255, 255, 255 ), CV_FILLED ); // previous occupancy
+        cvCircle( m_inOutMask, cvPoint( pc.x - roi.x, pc.y - roi.y ), radius, CV_RGB( 0, 0, 0 ), CV_FILLED ); // effectively 'subtracts' current occupancy from previous
+
+        cvResetImageROI( m_inOutMask );
+
+        m_inOutRoi = roi;
 
-    IncrementUncoveredPixels();
+        IncrementUncoveredPixels( roi );
+    }
 }
 
 /**
     Updates the coverage system with the polygon swept out by the brush bar.
 
+    The corners keep their sub-pixel positions and the quadrilateral is
+    filled with a top-left convention, so consecutive sweeps (which share
+    the current/previous brush-bar edge) neither overlap nor leave gaps.
+
     @param pl Previous position of left edge of brush bar.
     @param pr Previous position of right edge of brush bar.
     @param cl Current position of left edge of brush bar.
@@ -90,25 +133,93 @@ void CoverageSystem::BrushBarUpdate( CvPoint2D32f pl,
                                      CvPoint2D32f cl,
                                      CvPoint2D32f cr )
 {
-    cvZero( m_inOutMask );
+    const CvPoint2D32f quad[4] = { pl, pr, cr, cl };
+
+    m_spans.clear();
+    ScanlineRasteriser::FillPolygon( quad, 4, m_grid.GetSize(), m_spans );
 
-    CvPoint poly[4] =
+    for ( size_t i = 0; i < m_spans.size(); ++i )
     {
-        cvPoint(static_cast<int>(pl.x), static_cast<int>(pl.y)),
-        cvPoint(static_cast<int>(pr.x), static_cast<int>(pr.y)),
-        cvPoint(static_cast<int>(cr.x), static_cast<int>(cr.y)),
-        cvPoint(static_cast<int>(cl.x), static_cast<int>(cl.y))
-    };
+        const ScanlineRasteriser::Span& span = m_spans[i];
 
-    cvFillConvexPoly( m_inOutMask, poly, 4, cvScalar( 255, 255, 255 ) );
+        IncrementRun( span.y, span.x0, span.x1, 0, true );
+    }
+}
 
-    // Erase last row of pixels
-    cvFillConvexPoly( m_inOutMask, &(poly[2]), 2, cvScalar( 0, 0, 0 ) );
+/**
+    The part of the image an update drawing within x0..x1, y0..y1 (inclusive)
+    needs to touch. There is a one pixel margin so that nothing drawn is clipped
+    by the region unless it would also have been clipped by the image, which keeps
+    the result identical to drawing on the whole image.
 
-    // intersect with floor mask
-    cvAnd( m_inOutMask, m_floorMask, m_inOutMask );
+    @return The region, clipped to the image (zero size if outside it).
+ **/
+CvRect CoverageSystem::UpdateRegion( int x0, int y0, int x1, int y1 ) const
+{
+    const int left   = std::max( x0 - 1, 0 );
+    const int top    = std::max( y0 - 1, 0 );
+    const int right  = std::min( x1 + 2, m_grid.GetSize().width );
+    const int bottom = std::min( y1 + 2, m_grid.GetSize().height );
+
+    if ( right <= left || bottom <= top )
+    {
+        return cvRect( 0, 0, 0, 0 );
+    }
+
+    return cvRect( left, top, right - left, bottom - top );
+}
+
+/**
+    Zero the part of m_inOutMask written by the last update
+    (the rest of it is always zero).
+ **/
+void CoverageSystem::ClearInOutMask()
+{
+    if ( m_inOutRoi.width > 0 && m_inOutRoi.height > 0 )
+    {
+        cvSetImageROI( m_inOutMask, m_inOutRoi );
+        cvZero( m_inOutMask );
+        cvResetImageROI( m_inOutMask );
+    }
+
+    m_inOutRoi = cvRect( 0, 0, 0, 0 );
+}
+
+namespace
+{
+    /**
+        The colours used for a pixel covered count times: shades of
+        green up to 7 passes, then cyan, blue and red for heavy repeats
+        (19 or more passes share the last entry).
+     **/
+    OpenCvTools::ColourPalette CreatePassPalette()
+    {
+        OpenCvTools::ColourPalette palette( 20 );
+
+        palette.SetColour( 0, CV_RGB( 0, 0, 0 ) );
+
+        for ( int count = 1; count <= 7; ++count )
+        {
+            palette.SetColour( count, CV_RGB( 0, std::min( count * 40, 255 ), 0 ) );
+        }
+
+        for ( int count = 8; count <= 13; ++count )
+        {
+            palette.SetColour( count, CV_RGB( 0, 255, 255 ) );
+        }
+
+        for ( int count = 14; count <= 18; ++count )
+        {
+            palette.SetColour( count, CV_RGB( 0, 128, 255 ) );
+        }
+
+        palette.SetColour( 19, CV_RGB( 255, 0, 0 ) );
+
+        return palette;
+    }
 
-    IncrementUncoveredPixels();
+    // Built once at start-up, so it can be shared between tracking threads.
+    const OpenCvTools::ColourPalette passPalette( CreatePassPalette() );
 }
 
 /**
@@ -117,86 +228,142 @@ void CoverageSystem::BrushBarUpdate( CvPoint2D32f pl,
  **/
 void CoverageSystem::CreateColouredMap()
 {
-    cvZero( m_colMap );
-
-    unsigned char colour[11][3] = { { 0, 0, 0 },
-                                    { 0, 40, 0 },
-                                    { 0, 80, 0 },
-                                    { 0, 120, 0 },
-                                    { 0, 160, 0 },
-                                    { 0, 200, 0 },
-                                    { 0, 240, 0 },
-                                    { 0, 255, 0 },
-                                    { 255, 255, 0 },
-                                    { 255, 128, 0 },
-                                    { 0, 0, 255 } };
-
-    int step = m_cvgMask->widthStep;
-    for ( int r = 0; r < m_cvgMask->height; ++r )
+    if ( !m_colMap )
     {
-        char* pMask = m_cvgMask->imageData + (r * step);
-        const char* const pEnd = pMask + (m_cvgMask->width * m_cvgMask->nChannels);
+        m_colMap = cvCreateImage( m_grid.GetSize(), IPL_DEPTH_8U, 3 );
+    }
 
-        char* pCol = m_colMap->imageData + (r * m_colMap->widthStep);
+    cvZero( m_colMap );
 
-        while ( pMask != pEnd )
+    // Untouched tiles keep colour zero (black).
+    for ( int ty = 0; ty < m_grid.GetTilesY(); ++ty )
+    {
+        for ( int tx = 0; tx < m_grid.GetTilesX(); ++tx )
         {
-            int index = *pMask++;
+            const unsigned short* tile = m_grid.Tile( tx, ty );
 
-            if ( index > 8 && index <= 13 )
-            {
-                index = 8;
-            }
-            else if ( index > 13 && index <= 18 )
+            if ( !tile )
             {
-                index = 9;
+                continue;
             }
-            else if ( index > 18 )
+
+            const CvRect rect = m_grid.TileRect( tx, ty );
+
+            for ( int r = 0; r < rect.height; ++r )
             {
-                index = 10;
-            }
+                const unsigned short* pCount = tile + ( r << CoverageGrid::TILE_BITS );
+                char* pCol = m_colMap->imageData + ((rect.y + r) * m_colMap->widthStep) + (rect.x * 3);
 
-            *pCol++ = colour[index][0];
-            *pCol++ = colour[index][1];
-            *pCol++ = colour[index][2];
+                passPalette.Apply( pCount, rect.width, (unsigned char*)pCol );
+            }
         }
     }
 }
 
 /**
-    Increment the coverage count for any pixels in m_cvgMask which
-    have just been uncovered (i.e. which are on in the m_inOutMask).
+    Increment the coverage count for any pixels which have just
+    been uncovered (i.e. which are on in the m_inOutMask).
 
-    This is a bit slow at the moment but can be much improved:
-    we only need to loop over pixels in  a square about the robot's
-    previous position pp (since only those pixels can be uncovered each
-    step). At the moment it checks every pixel in the image.
+    This checks every pixel in the image; the updates only check
+    the region they have drawn in.
  **/
 void CoverageSystem::IncrementUncoveredPixels()
 {
-    assert( m_cvgMask->widthStep == m_inOutMask->widthStep );
+    if ( m_inOutMask )
+    {
+        IncrementUncoveredPixels( cvRect( 0, 0, m_inOutMask->width, m_inOutMask->height ) );
+    }
+}
+
+/**
+    Increment the coverage count for uncovered pixels within roi only
+    (which must lie within the image).
+ **/
+void CoverageSystem::IncrementUncoveredPixels( CvRect roi )
+{
+    for ( int r = roi.y; r < roi.y + roi.height; ++r )
+    {
+        const char* pTest = m_inOutMask->imageData + (r * m_inOutMask->widthStep) + roi.x;
+
+        IncrementRun( r, roi.x, roi.x + roi.width, pTest, false );
+    }
+}
+
+/**
+    Increment the coverage count of pixels x0 <= x < x1 on row y.
+
+    Tiles are only allocated for pixels which are actually incremented,
+    and counts stop at CoverageGrid::MAX_COUNT.
+
+    @param pTest If given, only pixels where pTest[x - x0] is non-zero are incremented.
+    @param floorOnly If set (and there is a floor mask) pixels off the floor are skipped.
+ **/
+void CoverageSystem::IncrementRun( int y, int x0, int x1, const char* pTest, bool floorOnly )
+{
+    // Move floor pixels between levels as they are incremented.
+    const bool countLevels = m_levelsValid && m_floorMask;
 
-    int step = m_cvgMask->widthStep;
-    for ( int r = 0; r < m_cvgMask->height; ++r )
+    const char* pFloor = m_floorMask ? m_floorMask->imageData + (y * m_floorMask->widthStep) : 0;
+
+    int x = x0;
+    while ( x < x1 )
     {
-        char* pMask = m_cvgMask->imageData + (r * step);
-        const char* const pEnd = pMask + (m_cvgMask->width * m_cvgMask->nChannels);
+        // Counters are contiguous up to the end of the tile.
+        const int end = std::min( x1, ( x | ( CoverageGrid::TILE_SIZE - 1 ) ) + 1 );
 
-        char* pTest = m_inOutMask->imageData + (r * step);
+        unsigned short* pCount = 0;
 
-        while ( pMask != pEnd )
+        for ( int c = x; c < end; ++c )
         {
-            if ( (*pTest) != 0 )
+            if ( ( pTest && pTest[c - x0] == 0 ) || ( floorOnly && pFloor && pFloor[c] == 0 ) )
+            {
+                continue;
+            }
+
+            // The tile is only allocated once a pixel in it is incremented.
+            if ( !pCount )
+            {
+                pCount = m_grid.Acquire( x, y );
+            }
+
+            unsigned short& count = pCount[c - x];
+
+            if ( count == CoverageGrid::MAX_COUNT )
             {
-                (*pMask) += 1;
+                continue;
             }
 
-            pMask++;
-            pTest++;
+            // The top level holds everything covered 255 times or more.
+            if ( countLevels && pFloor[c] != 0 && count < 255 )
+            {
+                --m_levelPixels[count];
+                ++m_levelPixels[count + 1];
+            }
+
+            ++count;
         }
+
+        x = end;
     }
 }
 
+/**
+    Count the floor pixels at each pass count from scratch.
+ **/
+void CoverageSystem::CountLevels()
+{
+    if ( m_floorMask )
+    {
+        m_grid.Histogram( m_floorMask, m_floorPixels, m_levelPixels );
+    }
+    else
+    {
+        std::fill( m_levelPixels, m_levelPixels + 256, 0u );
+    }
+
+    m_levelsValid = true;
+}
+
 /**
     Pass in a tracker and update overage
     mask based on current robot position.
@@ -220,12 +387,52 @@ void CoverageSystem::IncrementUncoveredPixels()
 /**
     Update coverage mask by directly
     passing in position and radius.
+
+    The counts under an anti-aliased disc are blended towards 255.
  **/
 void CoverageSystem::DirectUpdate( CvPoint pb, float radiusPx )
 {
     int radius = (int)(radiusPx + .5f);
 
-    cvCircle( m_cvgMask, pb, radius, cvScalar( 255, 255, 255 ), CV_FILLED, CV_AA );
+    if ( !m_inOutMask )
+    {
+        m_inOutMask = cvCreateImage( m_grid.GetSize(), IPL_DEPTH_8U, 1 );
+        cvZero( m_inOutMask );
+    }
+
+    ClearInOutMask();
+
+    // Anti-aliasing can reach one pixel beyond the radius.
+    const CvRect roi = UpdateRegion( pb.x - radius - 1, pb.y - radius - 1, pb.x + radius + 1, pb.y + radius + 1 );
+
+    if ( roi.width > 0 && roi.height > 0 )
+    {
+        cvSetImageROI( m_inOutMask, roi );
+        cvCircle( m_inOutMask, cvPoint( pb.x - roi.x, pb.y - roi.y ), radius, cvScalar( 255, 255, 255 ), CV_FILLED, CV_AA );
+        cvResetImageROI( m_inOutMask );
+
+        m_inOutRoi = roi;
+
+        for ( int r = roi.y; r < roi.y + roi.height; ++r )
+        {
+            const unsigned char* pAlpha = (const unsigned char*)( m_inOutMask->imageData + (r * m_inOutMask->widthStep) );
+
+            for ( int c = roi.x; c < roi.x + roi.width; ++c )
+            {
+                if ( pAlpha[c] != 0 )
+                {
+                    unsigned short& count = *m_grid.Acquire( c, r );
+
+                    if ( count < 255 )
+                    {
+                        count = (unsigned short)( count + ( ( 255 - count ) * pAlpha[c] + 127 ) / 255 );
+                    }
+                }
+            }
+        }
+    }
+
+    m_levelsValid = false;
 }
 
 /**
@@ -236,50 +443,154 @@ void CoverageSystem::DirectUpdate( CvPoint pb, float radiusPx )
  **/
 void CoverageSystem::DrawMap( IplImage* img ) const
 {
-    cvAddWeighted( img, 0.4, m_colMap, 0.6, 0, img );
+    if ( m_colMap )
+    {
+        cvAddWeighted( img, 0.4, m_colMap, 0.6, 0, img );
+    }
+}
+
+/**
+    Blend the pass count colours (as used by CreateColouredMap)
+    half and half over the covered pixels of a BGR image the
+    size of the tracking image.
+
+    Only the allocated tiles are visited, so the cost depends on
+    the area covered so far rather than on the image size.
+
+    @param img The image to render to
+ **/
+void CoverageSystem::DrawOverlay( IplImage* img ) const
+{
+    assert( img->width == m_grid.GetSize().width );
+    assert( img->height == m_grid.GetSize().height );
+    assert( img->nChannels == 3 );
+
+    for ( int ty = 0; ty < m_grid.GetTilesY(); ++ty )
+    {
+        for ( int tx = 0; tx < m_grid.GetTilesX(); ++tx )
+        {
+            const unsigned short* tile = m_grid.Tile( tx, ty );
+
+            if ( !tile )
+            {
+                continue;
+            }
+
+            const CvRect rect = m_grid.TileRect( tx, ty );
+
+            for ( int j = 0; j < rect.height; ++j )
+            {
+                unsigned char* pImg = (unsigned char*)( img->imageData + (rect.y + j) * img->widthStep ) + rect.x * 3;
+                const unsigned short* pCount = tile + ( j << CoverageGrid::TILE_BITS );
+
+                for ( int i = 0; i < rect.width; ++i, pImg += 3 )
+                {
+                    if ( pCount[i] == 0 )
+                    {
+                        continue;
+                    }
+
+                    const unsigned char* colour = passPalette.GetColour( pCount[i] );
+
+                    pImg[0] = (unsigned char)( ( pImg[0] + colour[0] + 1 ) >> 1 );
+                    pImg[1] = (unsigned char)( ( pImg[1] + colour[1] + 1 ) >> 1 );
+                    pImg[2] = (unsigned char)( ( pImg[2] + colour[2] + 1 ) >> 1 );
+                }
+            }
+        }
+    }
 }
 
 /**
     Render coverage mask to another
     image as a transparent overlay.
 
+    Uncovered pixels are left as they are, so
+    only the allocated tiles need to be visited.
+
     @param img The image to render to
  **/
 void CoverageSystem::DrawMask( IplImage* img, CvScalar colour ) const
 {
-    assert( img->width == m_cvgMask->width );
-    assert( img->height == m_cvgMask->height );
+    assert( img->width == m_grid.GetSize().width );
+    assert( img->height == m_grid.GetSize().height );
 
-    int h = m_cvgMask->height;
-    int w = m_cvgMask->width;
-    for ( int j = 0; j < h; ++j )
+    for ( int ty = 0; ty < m_grid.GetTilesY(); ++ty )
     {
-        char* pImg = img->imageData + j * img->widthStep;
-        const char* pMask = m_cvgMask->imageData + j * m_cvgMask->widthStep;
-
-        for ( int i = 0; i < w; ++i )
+        for ( int tx = 0; tx < m_grid.GetTilesX(); ++tx )
         {
-            unsigned char mval = (unsigned char)*pMask++;
-            float a = (mval) / 255.f;
-            float b = 1.f - a;
+            const unsigned short* tile = m_grid.Tile( tx, ty );
 
-            for ( int c = 0; c < img->nChannels; ++c )
+            if ( !tile )
             {
-                unsigned char pxl = (unsigned char)*pImg;
-                float fill = (float)(colour.val[c]) * (pxl / 255.f);
-                float col = a * fill + b * pxl;
-                *pImg++ = (char)col;
+                continue;
+            }
+
+            const CvRect rect = m_grid.TileRect( tx, ty );
+
+            for ( int j = 0; j < rect.height; ++j )
+            {
+                char* pImg = img->imageData + (rect.y + j) * img->widthStep + rect.x * img->nChannels;
+                const unsigned short* pCount = tile + ( j << CoverageGrid::TILE_BITS );
+
+                for ( int i = 0; i < rect.width; ++i )
+                {
+                    unsigned char mval = (unsigned char)std::min( (unsigned int)*pCount++, 255u );
+                    float a = (mval) / 255.f;
+                    float b = 1.f - a;
+
+                    for ( int c = 0; c < img->nChannels; ++c )
+                    {
+                        unsigned char pxl = (unsigned char)*pImg;
+                        float fill = (float)(colour.val[c]) * (pxl / 255.f);
+                        float col = a * fill + b * pxl;
+                        *pImg++ = (char)col;
+                    }
+                }
             }
         }
     }
 }
 
 /**
+    The coverage counts as an 8-bit image, where each pixel value
+    is the number of passes made over it (saturating at 255).
 
+    The image is refreshed from the coverage grid on each call.
+ **/
+const IplImage* CoverageSystem::GetCoverageMask() const
+{
+    if ( !m_cvgMask )
+    {
+        m_cvgMask = cvCreateImage( m_grid.GetSize(), IPL_DEPTH_8U, 1 );
+    }
+
+    m_grid.Export( m_cvgMask );
+
+    return m_cvgMask;
+}
+
+/**
+    Save the raw coverage mask: an 8-bit image where each pixel value
+    is the number of passes made over it (saturating at 255).
  **/
 void CoverageSystem::SaveMask( const char* file_name )
 {
-    cvSaveImage( file_name, m_cvgMask );
+    cvSaveImage( file_name, GetCoverageMask() );
+}
+
+/**
+    Save the exact pass counts losslessly as a 16-bit single channel
+    image; @a file_name needs a format which keeps 16 bits (e.g. PNG).
+ **/
+void CoverageSystem::SaveCounts( const char* file_name ) const
+{
+    IplImage* counts = cvCreateImage( m_grid.GetSize(), IPL_DEPTH_16U, 1 );
+
+    m_grid.Export( counts );
+    cvSaveImage( file_name, counts );
+
+    cvReleaseImage( &counts );
 }
 
 /**
@@ -306,7 +617,12 @@ float CoverageSystem::EstimateCoverage( const IplImage* floormask ) const
  **/
 unsigned int CoverageSystem::GetCoveredPixelCount() const
 {
-    return cvCountNonZero( m_cvgMask );
+    const CvSize size = m_grid.GetSize();
+
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    m_grid.Histogram( 0, size.width * size.height, histogram );
+
+    return CoverageStatistics::AtLeast( histogram, 1 );
 }
 
 /**
@@ -325,19 +641,10 @@ unsigned int CoverageSystem::CountWhitePixels( const IplImage* mask )
 
     assert( mask->nChannels == 1 );
 
-    unsigned int count = 0;
-    for ( int j = 0; j < mask->height; ++j )
-    {
-        for ( int i = 0; i < mask->width; ++i )
-        {
-            if ( cvGet2D( mask, j, i ).val[0] == 255.0 )
-            {
-                count++;
-            }
-        }
-    }
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    CoverageStatistics::Compute( mask, 0, histogram );
 
-    return count;
+    return CoverageStatistics::Exactly( histogram, 255 );
 }
 
 /**
@@ -356,20 +663,10 @@ unsigned int CoverageSystem::CountRepeatCoverage( const IplImage* mask )
 
     assert( mask->nChannels == 1 );
 
-    unsigned int count = 0;
-    for ( int j = 0; j < mask->height; ++j )
-    {
-        for ( int i = 0; i < mask->width; ++i )
-        {
-            float val = cvGet2D( mask, j, i ).val[0];
-            if ( val > 1 )
-            {
-                count++;
-            }
-        }
-    }
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    CoverageStatistics::Compute( mask, 0, histogram );
 
-    return count;
+    return CoverageStatistics::AtLeast( histogram, 2 );
 }
 
 /**
@@ -395,8 +692,8 @@ bool CoverageSystem::LoadFloorMask( const char* filename )
     cvReleaseImage( &mask ); // SetFloorMask makes its own copy so release
 
     // Check size of loaded mask matches floor-coverage mask
-    if ( m_floorMask->width == m_cvgMask->width &&
-         m_floorMask->height == m_cvgMask->height &&
+    if ( m_floorMask->width == m_grid.GetSize().width &&
+         m_floorMask->height == m_grid.GetSize().height &&
          m_floorMask->nChannels == 1 )
     {
         return true;
@@ -405,8 +702,8 @@ bool CoverageSystem::LoadFloorMask( const char* filename )
     {
         LOG_ERROR("Floor mask has incorrect size or colour depth!");
 
-        LOG_ERROR(QObject::tr("Expected a %1x%2 grey-scale image!").arg(m_cvgMask->width)
-                                                                   .arg(m_cvgMask->height));
+        LOG_ERROR(QObject::tr("Expected a %1x%2 grey-scale image!").arg(m_grid.GetSize().width)
+                                                                   .arg(m_grid.GetSize().height));
         assert( 0 );
         return false;
     }
@@ -430,6 +727,8 @@ void CoverageSystem::SetFloorMask( const IplImage* mask )
         m_floorMask = cvCloneImage( mask );
         m_floorPixels = cvCountNonZero( m_floorMask );
     }
+
+    m_levelsValid = false;
 }
 
 /**
@@ -450,18 +749,46 @@ float CoverageSystem::EstimateCoverage() const
     return GetCoveredPixelCount() * (100.f / m_floorPixels);
 }
 
+/**
+    The percentage of the floor mask covered so far, taken from the pass
+    counts kept up to date by the updates. After the first call (which may
+    have to count them) this takes constant time, so it can be called after
+    every update while tracking.
+
+    @return The percentage coverage, or -1.f if there is no floor mask.
+ **/
+float CoverageSystem::EstimateCurrentCoverage()
+{
+    if ( !m_floorMask || m_floorPixels == 0 )
+    {
+        return -1.f;
+    }
+
+    if ( !m_levelsValid )
+    {
+        CountLevels();
+    }
+
+    return ( m_floorPixels - m_levelPixels[0] ) * (100.f / m_floorPixels);
+}
+
 /**
     Returns percentage of floor space
     that was covered more than once.
  **/
 float CoverageSystem::EstimateRepeatCoverage() const
 {
-    if ( !m_cvgMask || m_floorPixels == 0 )
+    if ( m_floorPixels == 0 )
     {
         return -1.f;
     }
 
-    return CountRepeatCoverage( m_cvgMask ) * (100.f / m_floorPixels);
+    const CvSize size = m_grid.GetSize();
+
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    m_grid.Histogram( 0, size.width * size.height, histogram );
+
+    return CoverageStatistics::AtLeast( histogram, 2 ) * (100.f / m_floorPixels);
 }
 
 /**
@@ -477,18 +804,14 @@ void CoverageSystem::CoverageHistogram( const char* file ) const
         return;
     }
 
-    // First make a copy of the coverage mask.
-    IplImage* mask = cvCloneImage( m_cvgMask );
-    IplImage* count = cvCloneImage( mask );
+    // Count the floor pixels at every pass count in one go
+    // (the last level holds those covered 255 times or more).
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    m_grid.Histogram( m_floorMask, m_floorPixels, histogram );
 
-    double t = 1.0;
     for ( int i = 1; i < 256; ++i )
     {
-        cvCmpS( m_cvgMask, t, mask, CV_CMP_EQ ); // Find all pixels that were covered 't' times
-        cvAnd( mask, m_floorMask, count ); // then intersect those pixels with floor mask
-        int nPixels = cvCountNonZero( count ); // then count the result
-
-        t += 1.0;
+        int nPixels = (int)CoverageStatistics::Exactly( histogram, i );
 
         // Work out percentage of floor area covered.
         float pc = nPixels * (100.f / m_floorPixels);
@@ -496,9 +819,6 @@ void CoverageSystem::CoverageHistogram( const char* file ) const
     }
 
     fclose( fp );
-
-    cvReleaseImage( &mask );
-    cvReleaseImage( &count );
 }
 
 /**
@@ -506,6 +826,9 @@ void CoverageSystem::CoverageHistogram( const char* file ) const
 
     For each level of coverage writes the percentage of floor covered by that amount.
 
+    Uses the running count of floor pixels at each level, so this
+    costs O(levels) rather than a pass over the image per level.
+
     @param fp A valid open file pointer to which the data will be written.
     @param count The maximum coverage count in which we are interested.
  **/
@@ -513,24 +836,27 @@ void CoverageSystem::WriteIncrementalCoverage( FILE* fp, unsigned int count )
 {
     if ( fp )
     {
-        IplImage* dst = cvCreateImage( cvSize( m_cvgMask->width,
-                                               m_cvgMask->height ), IPL_DEPTH_8U, 1 );
+        if ( !m_levelsValid )
+        {
+            CountLevels();
+        }
 
-        IplImage* countImage = cvCloneImage( dst );
+        // Floor pixels covered at least i times.
+        unsigned int atLeast[257];
+        atLeast[256] = 0;
+        for ( int i = 255; i >= 0; --i )
+        {
+            atLeast[i] = atLeast[i + 1] + m_levelPixels[i];
+        }
 
         for ( unsigned int i = 1; i <= count; ++i )
         {
-            cvCmpS( m_cvgMask, i, dst, CV_CMP_GE );
-
-            // Intersect pixels with floor mask.
-            cvAnd( dst, m_floorMask, countImage );
-            float cov = cvCountNonZero( countImage ) * (100.f / m_floorPixels);
+            const int nPixels = ( i < 256 ) ? (int)atLeast[i] : 0;
+            float cov = nPixels * (100.f / m_floorPixels);
             fprintf( fp, " %f", cov );
         }
 
         fprintf( fp, "\n" );
-
-        cvReleaseImage( &dst );
     }
 }
 
@@ -544,17 +870,42 @@ int CoverageSystem::MissedMask( const char* fileName )
 
     if ( m_floorMask )
     {
-        IplImage* dst = cvCreateImage( cvSize( m_cvgMask->width,
-                                               m_cvgMask->height ), IPL_DEPTH_8U, 1 );
+        // Start from the whole floor and clear whatever was covered.
+        IplImage* dst = cvCloneImage( m_floorMask );
 
-        cvCmpS( m_cvgMask, 1, dst, CV_CMP_GE );
+        for ( int ty = 0; ty < m_grid.GetTilesY(); ++ty )
+        {
+            for ( int tx = 0; tx < m_grid.GetTilesX(); ++tx )
+            {
+                const unsigned short* tile = m_grid.Tile( tx, ty );
+
+                if ( !tile )
+                {
+                    continue;
+                }
+
+                const CvRect rect = m_grid.TileRect( tx, ty );
+
+                for ( int r = 0; r < rect.height; ++r )
+                {
+                    const unsigned short* pCount = tile + ( r << CoverageGrid::TILE_BITS );
+                    char* pDst = dst->imageData + (rect.y + r) * dst->widthStep + rect.x;
+
+                    for ( int c = 0; c < rect.width; ++c )
+                    {
+                        if ( pCount[c] != 0 )
+                        {
+                            pDst[c] = 0;
+                        }
+                    }
+                }
+            }
+        }
 
-        cvSub( m_floorMask, dst, dst );
+        count = cvCountNonZero( dst );
 
         cvSaveImage( fileName, dst );
 
-        count = cvCountNonZero( dst );
-
         cvReleaseImage( &dst );
     }
 
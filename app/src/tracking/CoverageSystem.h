@@ -19,9 +19,14 @@
 #ifndef COVERAGESYSTEM_H
 #define COVERAGESYSTEM_H
 
+#include "CoverageGrid.h"
+#include "ScanlineRasteriser.h"
+
 #include <opencv/cv.h>
 #include <stdio.h>
 
+#include <vector>
+
 class RoboTrackKlt; // forward declaration
 
 /**
@@ -33,6 +38,8 @@ public:
 	CoverageSystem(CvSize warpedImageSize);
 	~CoverageSystem();
 
+	void Reset();
+
 	//void Update( const RoboTrackKlt& tracker );
 	void DirectUpdate( CvPoint pb, float robotRadiusPx );
 	void Update( CvPoint2D32f prev, CvPoint2D32f curr, float robotRadiusPx );
@@ -44,17 +51,22 @@ public:
 
 	void DrawMask( IplImage* img, CvScalar colour ) const;
 	void SaveMask( const char* filename );
+	void SaveCounts( const char* filename ) const;
 	void DrawMap( IplImage* img ) const;
+	void DrawOverlay( IplImage* img ) const;
 
 	unsigned int GetCoveredPixelCount() const;
 	float EstimateCoverage( const IplImage* floormask ) const;
 	float EstimateCoverage() const;
 	float EstimateRepeatCoverage() const;
+	float EstimateCurrentCoverage();
 	void CoverageHistogram( const char* file_name ) const;
 
 	bool LoadFloorMask( const char* filename );
 	void SetFloorMask( const IplImage* mask );
 	const IplImage* GetFloorMask() const { return m_floorMask; };
+	const IplImage* GetCoverageMask() const;
+	const CoverageGrid& GetCoverageGrid() const { return m_grid; };
 
 	static unsigned int CountWhitePixels( const IplImage* floormask );
 	static unsigned int CountRepeatCoverage( const IplImage* mask );
@@ -67,14 +79,30 @@ public:
     int MissedMask( const char* fileName );
 
 private:
+	CvRect UpdateRegion( int x0, int y0, int x1, int y1 ) const;
+	void ClearInOutMask();
+	void IncrementUncoveredPixels( CvRect roi );
+	void IncrementRun( int y, int x0, int x1, const char* pTest, bool floorOnly );
+	void CountLevels();
+
+	CoverageGrid m_grid;
+	mutable IplImage* m_cvgMask; // 8-bit export of m_grid, made on request
 
-	IplImage* m_cvgMask;
 	IplImage* m_floorMask;
 
 	unsigned int m_floorPixels;
 
-	IplImage* m_inOutMask;
-	IplImage* m_colMap;
+	// Number of floor pixels at each pass count, kept up to date
+	// by the updates while m_levelsValid (recounted otherwise).
+	unsigned int m_levelPixels[256];
+	bool m_levelsValid;
+
+	// Reused between brush-bar updates to avoid reallocating.
+	std::vector<ScanlineRasteriser::Span> m_spans;
+
+	IplImage* m_inOutMask; // allocated by the first Update
+	CvRect    m_inOutRoi; // the only part of m_inOutMask which may be non-zero
+	IplImage* m_colMap;   // allocated by the first CreateColouredMap
 };
 
 #endif // COVERAGESYSTEM_H
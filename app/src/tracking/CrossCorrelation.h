@@ -21,10 +21,52 @@
 
 #include <opencv/cv.h>
 
+#include <vector>
+
 #define PATCH_SIZE 256
 
+/**
+    Normalised cross-correlation of image windows.
+
+    Ncc2d() and Ncc2dRadial() accumulate all the sums they need in a single
+    pass over the window, using SSE2 or AVX2 when the CPU supports them
+    (selected automatically on first use). The original two-pass
+    implementations are kept as Ncc2dReference() and Ncc2dRadialReference().
+
+    The radial weights are not cached globally: callers that correlate many
+    windows of one size build a RadialWeights once (see KltTracker) so that
+    trackers running in parallel share no state.
+**/
 namespace CrossCorrelation
 {
+    enum Instructions
+    {
+        INSTRUCTIONS_SCALAR = 0,
+        INSTRUCTIONS_SSE2,
+        INSTRUCTIONS_AVX2
+    };
+
+    Instructions GetSupportedInstructions();
+    Instructions GetInstructions();
+    void SetInstructions( Instructions instructions );
+
+    /**
+        Radial weights (and their squares) for every byte of a ww x wh
+        window, stored row by row, together with their totals.
+    **/
+    struct RadialWeights
+    {
+        int ww; // window width (odd)
+        int wh; // window height (odd)
+        int c;  // channels
+        std::vector<float> w;
+        std::vector<float> w2;
+        double sumW;
+        double sumW2;
+    };
+
+    void CreateRadialWeights( int ww, int wh, int channels, RadialWeights& weights );
+
     struct Patch
     {
 	    int width;
@@ -51,6 +93,32 @@ namespace CrossCorrelation
                        int w,
                        int h);
 
+    float Ncc2dRadial( const IplImage*,
+                       const IplImage*,
+                       int x1,
+                       int y1,
+                       int x2,
+                       int y2,
+                       const RadialWeights& weights );
+
+    float Ncc2dReference( const IplImage*,
+                          const IplImage*,
+                          int x1,
+                          int y1,
+                          int x2,
+                          int y2,
+                          int w,
+                          int h);
+
+    float Ncc2dRadialReference( const IplImage*,
+                                const IplImage*,
+                                int x1,
+                                int y1,
+                                int x2,
+                                int y2,
+                                int w,
+                                int h);
+
     void GetPatch(Patch* patch);
 
     float NccPatch( const IplImage* img, int x1, int y1, const unsigned char* patch, int width, int height);
@@ -35,6 +35,141 @@
 
 namespace GroundTruthUI
 {
+    namespace
+    {
+        /** Gap between history entries (ms) beyond which the track is broken. **/
+        const double TRACK_BREAK_MS = 2000.0 / 3.0;
+
+        /** Colour of the track (BGR) in the tracking image. **/
+        const unsigned char TRACK_BGR[3] = { 0, 0, 255 };
+    }
+
+    TrackOverlay::TrackOverlay() :
+        m_coverage( 0 ),
+        m_frame   ( 0 ),
+        m_numDrawn( 0 ),
+        m_lastPos ( cvPoint( 0, 0 ) )
+    {
+    }
+
+    TrackOverlay::~TrackOverlay()
+    {
+        cvReleaseImage( &m_coverage );
+        cvReleaseImage( &m_frame );
+    }
+
+    void TrackOverlay::Invalidate()
+    {
+        m_numDrawn = 0;
+    }
+
+    /**
+     Draw the part of the tracker history that is not on the layer yet.
+     The layer is cleared and redrawn from the start if it has been
+     invalidated, the history has shrunk, or the image size has changed.
+     **/
+    void TrackOverlay::Update( const RobotTracker* tracker )
+    {
+        const IplImage* const currentImg = tracker->GetCurrentImage();
+        const TrackHistory::TrackLog& history = tracker->GetHistory();
+
+        if ( !m_coverage ||
+             m_coverage->width != currentImg->width ||
+             m_coverage->height != currentImg->height )
+        {
+            cvReleaseImage( &m_coverage );
+            m_coverage = cvCreateImage( cvGetSize( currentImg ), IPL_DEPTH_8U, 1 );
+            m_numDrawn = 0;
+        }
+
+        if ( history.size() < m_numDrawn )
+        {
+            m_numDrawn = 0;
+        }
+
+        if ( m_numDrawn == 0 )
+        {
+            cvSetZero( m_coverage );
+
+            if ( history.empty() )
+            {
+                return;
+            }
+
+            CvPoint2D32f posf = tracker->AdjustTrackForRobotHeight( history[0].GetPosition(),
+                                                                    history[0].GetOrientation() );
+            m_lastPos = cvPoint( ( int )posf.x, ( int )posf.y );
+            m_numDrawn = 1;
+        }
+
+        for ( size_t i = m_numDrawn; i < history.size(); ++i )
+        {
+            double tdiff = fabs( history[i].t() - history[i - 1].t() );
+
+            CvPoint2D32f posf = tracker->AdjustTrackForRobotHeight( history[i].GetPosition(),
+                                                                    history[i].GetOrientation() );
+            CvPoint pos = cvPoint( ( int )posf.x, ( int )posf.y );
+
+            if ( tdiff <= TRACK_BREAK_MS )
+            {
+                cvLine( m_coverage, m_lastPos, pos, cvScalarAll( 255 ), 1, CV_AA );
+            }
+
+            m_lastPos = pos;
+        }
+
+        m_numDrawn = history.size();
+    }
+
+    /**
+     Expand a grey image into a BGR one with the track blended on top.
+     Blending each anti-aliased line straight onto the frame in a constant
+     colour is equivalent to blending once with the accumulated coverage.
+
+     @return the composited image, owned by the overlay and overwritten
+     by the next call (callers may draw on it).
+     **/
+    IplImage* TrackOverlay::Composite( const IplImage* grey )
+    {
+        if ( !m_frame ||
+             m_frame->width != grey->width ||
+             m_frame->height != grey->height )
+        {
+            cvReleaseImage( &m_frame );
+            m_frame = cvCreateImage( cvGetSize( grey ), IPL_DEPTH_8U, 3 );
+        }
+
+        IplImage* dst = m_frame;
+
+        for ( int y = 0; y < grey->height; ++y )
+        {
+            const unsigned char* g = ( const unsigned char* )( grey->imageData + y * grey->widthStep );
+            const unsigned char* a = m_coverage ?
+                ( const unsigned char* )( m_coverage->imageData + y * m_coverage->widthStep ) : 0;
+            unsigned char* d = ( unsigned char* )( dst->imageData + y * dst->widthStep );
+
+            for ( int x = 0; x < grey->width; ++x, d += 3 )
+            {
+                const int v = g[x];
+                const int alpha = a ? a[x] : 0;
+
+                if ( alpha == 0 )
+                {
+                    d[0] = d[1] = d[2] = ( unsigned char )v;
+                }
+                else
+                {
+                    for ( int c = 0; c < 3; ++c )
+                    {
+                        d[c] = ( unsigned char )( v + ( ( TRACK_BGR[c] - v ) * alpha + ( TRACK_BGR[c] >= v ? 127 : -127 ) ) / 255 );
+                    }
+                }
+            }
+        }
+
+        return dst;
+    }
+
     /**
      Draw the robot position in the original image sequence.
      Need to know the entire camera calibration (and more) for this
@@ -146,56 +281,28 @@ namespace GroundTruthUI
 
     /**
      Draw the robot into a copy of the tracking image
-     before displaying in a named window.
+     before displaying in a named window. The coverage so far
+     is blended under the robot if a coverage system is given.
 
      TODO: this function has grown too big - need to refactor!
      **/
-    QImage showRobotTrack( const RobotTracker* tracker, bool tracking )
+    QImage showRobotTrack( const RobotTracker*   tracker,
+                           bool                  tracking,
+                           TrackOverlay&         overlay,
+                           const CoverageSystem* coverage )
     {
         const int DONT_FLIP = 0;
 
         const IplImage* const currentImg = tracker->GetCurrentImage();
 
-        IplImage* img = cvCreateImage( cvSize( currentImg->width,
-                                               currentImg->height ), IPL_DEPTH_8U, 3 );
-        cvConvertImage( currentImg, img );
+        // Draw the path taken so far: only the new part of the
+        // history is drawn, then the whole layer is blended at once.
+        overlay.Update( tracker );
+        IplImage* img = overlay.Composite( currentImg );
 
-        CvPoint2D32f oldPosf, newPosf;
-
-        // Draw the path taken so far (but each point needs
-        // to be converted from plane, to image co-ordinates)
-        const TrackHistory::TrackLog& history = tracker->GetHistory();
-
-        if ( history.size() > 1 )
+        if ( coverage )
         {
-            CvPoint2D32f pos = history[0].GetPosition();
-            float angle = history[0].GetOrientation();
-            oldPosf = tracker->AdjustTrackForRobotHeight( pos, angle );
-            CvPoint oldPos = cvPoint( ( int )oldPosf.x, ( int )oldPosf.y );
-
-            for ( unsigned int i = 1; i < history.size(); ++i )
-            {
-                double tdiff = fabs( history[i].t() - history[i - 1].t() );
-                pos = history[i].GetPosition();
-                angle = history[i].GetOrientation();
-
-                if ( tdiff > 2000.0 / 3.0 )
-                {
-                    oldPosf = tracker->AdjustTrackForRobotHeight( pos, angle );
-                    oldPos = cvPoint( ( int )oldPosf.x, ( int )oldPosf.y );
-                }
-                else
-                {
-                    newPosf = tracker->AdjustTrackForRobotHeight( pos, angle );
-                    CvPoint newPos = cvPoint( ( int )newPosf.x, ( int )newPosf.y );
-
-                    CvScalar colour;
-                    colour = cvScalar( 0, 0, 255 );
-                    cvLine( img, oldPos, newPos, colour, 1, CV_AA );
-
-                    oldPos = newPos;
-                }
-            }
+            coverage->DrawOverlay( img );
         }
 
         if (tracking)
@@ -281,8 +388,6 @@ namespace GroundTruthUI
 
         cvConvertImage( img, &mtxWrapper, DONT_FLIP );
 
-        cvReleaseImage( &img );
-
         return qimage;
     }
 }
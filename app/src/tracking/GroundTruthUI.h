@@ -42,12 +42,46 @@ namespace GroundTruthUI
 	    const RobotMetrics* m_met;
     };
 
+    /**
+        The track drawn so far for one view, kept between frames so that
+        only the segments added to the tracker history since the last
+        frame have to be drawn. The layer is an anti-aliased coverage mask
+        for the (single colour) track which is blended onto each frame.
+
+        Call Invalidate() whenever the history is changed other than by
+        appending to it (e.g. after a rewind or manual reposition).
+    **/
+    class TrackOverlay
+    {
+    public:
+        TrackOverlay();
+        ~TrackOverlay();
+
+        void Invalidate();
+
+        void Update( const RobotTracker* tracker );
+        IplImage* Composite( const IplImage* grey );
+
+    private:
+        IplImage*    m_coverage;
+        IplImage*    m_frame;
+        size_t       m_numDrawn;
+        CvPoint      m_lastPos;
+
+        // make uncopyable
+        TrackOverlay( const TrackOverlay& );
+        const TrackOverlay& operator = ( const TrackOverlay& );
+    };
+
     /**
     	This file contains drawing functionas and OpenCV-style mouse call-backs
     	used for the ground truth system user interface.
     **/
     QImage showRobotTrackUndistorted( IplImage* img, const RobotTracker* tracker, int flip=0 );
-    QImage showRobotTrack(const RobotTracker* tracker, bool tracking );
+    QImage showRobotTrack( const RobotTracker* tracker,
+                           bool tracking,
+                           TrackOverlay& overlay,
+                           const CoverageSystem* coverage=0 );
 }
 
 #endif // GROUNDTRUTHUI_H
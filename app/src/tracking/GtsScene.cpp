@@ -43,6 +43,10 @@
 
 #include <QTemporaryFile>
 #include <QObject>
+#include <QtCore/QFuture>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QThread>
+#include <QtCore/QtConcurrentRun>
 
 #include <stdio.h>
 
@@ -50,6 +54,7 @@
 #include <fstream>
 #include <string>
 #include <set>
+#include <algorithm>
 
 #define MATCH_BASE 0
 #define MATCH_REFN 1
@@ -59,12 +64,25 @@ GtsScene::GtsScene( ) :
     m_thread                    ( 0 ),
     m_filePositionInMilliseconds( 0.0 ),
     m_rateInMilliseconds        ( 0.0 ),
+    m_parallelStepping          ( QThread::idealThreadCount() > 1 ),
+    m_displayIntervalMs         ( 0 ),
+    m_excessLatencyBudgetMs     ( 0.0 ),
+    m_stepsSinceRate            ( 0 ),
+    m_displaysSinceRate         ( 0 ),
     m_ln                        ( 0 )
 {
+    for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
+    {
+        m_coverage[i] = 0;
+    }
 }
 
 GtsScene::~GtsScene()
 {
+    for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
+    {
+        delete m_coverage[i];
+    }
 }
 
 void GtsScene::Reset()
@@ -77,6 +95,9 @@ void GtsScene::Reset()
         {
             m_view[i].Reset();
         }
+
+        delete m_coverage[i];
+        m_coverage[i] = 0;
     }
 
     m_ln = 0;
@@ -93,24 +114,53 @@ bool GtsScene::LoadTarget( const WbConfig& targetCfg )
     return successful;
 }
 
-bool GtsScene::LoadCameraConfig( const KeyId               camPosId,
-                                 const char* const         selectedVideoFileName,
-                                 const char* const         timestampFileName,
-                                 const WbConfig&           cameraConfig,
-                                 const WbConfig&           camPosConfig,
-                                 const WbConfig&           roomConfig,
-                                 const WbConfig&           robotConfig,
-                                 const WbConfig&           trackConfig,
-                                 RobotTracker::trackerType tracker )
+/**
+  Set up the next free view from a camera position and wait for it.
+ **/
+bool GtsScene::LoadCameraConfig( const CameraSetup& setup )
+{
+    return LoadCameraConfigAt( m_ln++, setup );
+}
+
+/**
+  Reserve the next free view for a camera position and set it up on the
+  global thread pool. Views are independent until SetupViewWindows and
+  SetupThread are called, so several cameras can be loaded at once; the
+  caller must wait for every future before calling either of those.
+ **/
+QFuture<bool> GtsScene::LoadCameraConfigAsync( const CameraSetup& setup )
 {
-    LOG_INFO(QObject::tr("Getting camera parameters %1.").arg(m_ln));
+    return QtConcurrent::run( this, &GtsScene::LoadCameraConfigAt, m_ln++, setup );
+}
+
+/**
+  Read everything needed to set up the view for a camera position from
+  the workbench configs. This must be called on the GUI thread, as the
+  configs share their data with the workbench tree.
+ **/
+bool GtsScene::ReadCameraSetup( const KeyId&              camPosId,
+                                const QString&            videoFileName,
+                                const QString&            timestampFileName,
+                                const WbConfig&           cameraConfig,
+                                const WbConfig&           camPosConfig,
+                                const WbConfig&           roomConfig,
+                                const WbConfig&           robotConfig,
+                                const WbConfig&           trackConfig,
+                                RobotTracker::trackerType tracker,
+                                CameraSetup&              setup )
+{
+    setup.camPosId = camPosId;
+    setup.videoFileName = videoFileName;
+    setup.timestampFileName = timestampFileName;
+    setup.tracker = tracker;
 
     const WbKeyValues::ValueIdPairList cameraMappingIds =
         trackConfig.GetKeyValues( TrackRobotSchema::PerCameraTrackingParams::positionIdKey );
 
-    int biLevelThreshold = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::biLevelThreshold).ToInt();
-    double nccThreshold = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::nccThreshold).ToDouble();
-    int resolution = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::resolution).ToInt();
+    setup.biLevelThreshold = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::biLevelThreshold).ToInt();
+    setup.nccThreshold = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::nccThreshold).ToDouble();
+    setup.resolution = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::resolution).ToInt();
+    setup.motionPrediction = trackConfig.GetKeyValue(TrackRobotSchema::GlobalTrackingParams::motionPrediction).ToBool();
 
     for (WbKeyValues::ValueIdPairList::const_iterator it = cameraMappingIds.begin(); it != cameraMappingIds.end(); ++it)
     {
@@ -122,9 +172,9 @@ bool GtsScene::LoadCameraConfig( const KeyId               camPosId,
 
             if (!useGlobalParams)
             {
-                biLevelThreshold = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::biLevelThreshold, it->id).ToInt();
-                nccThreshold = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::nccThreshold, it->id).ToDouble();
-                resolution = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::resolution, it->id).ToInt();
+                setup.biLevelThreshold = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::biLevelThreshold, it->id).ToInt();
+                setup.nccThreshold = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::nccThreshold, it->id).ToDouble();
+                setup.resolution = trackConfig.GetKeyValue(TrackRobotSchema::PerCameraTrackingParams::resolution, it->id).ToInt();
             }
 
             break;
@@ -139,42 +189,57 @@ bool GtsScene::LoadCameraConfig( const KeyId               camPosId,
 
     const WbConfig& camPosCalConfig = camPosConfig.GetSubConfig( ExtrinsicCalibrationSchema::schemaName );
 
-    LOG_INFO(QObject::tr("Configuring camera %1.").arg(m_ln));
+    setup.metrics.LoadMetrics( metricsConfig, camPosCalConfig, setup.resolution );
+
+    return GtsView::ReadCalibrationSetup( camPosId,
+                                          cameraConfig,
+                                          camPosConfig,
+                                          floorPlanConfig,
+                                          setup.calibration );
+}
+
+bool GtsScene::LoadCameraConfigAt( unsigned int index, const CameraSetup& setup )
+{
+    const int    biLevelThreshold = setup.biLevelThreshold;
+    const double nccThreshold     = setup.nccThreshold;
+    const bool   motionPrediction = setup.motionPrediction;
+    RobotTracker::trackerType tracker = setup.tracker;
+
+    LOG_INFO(QObject::tr("Configuring camera %1.").arg(index));
 
     LOG_INFO(QObject::tr("Tracking param - biLevel: %1.").arg(biLevelThreshold));
     LOG_INFO(QObject::tr("Tracking param - ncc: %1.").arg(nccThreshold));
-    LOG_INFO(QObject::tr("Tracking param - resolution: %1.").arg(resolution));
+    LOG_INFO(QObject::tr("Tracking param - resolution: %1.").arg(setup.resolution));
+    LOG_INFO(QObject::tr("Tracking param - motion prediction: %1.").arg(motionPrediction));
+
+    GtsView& view = m_view[index];
 
-    m_view[m_ln].SetId( m_ln );
+    view.SetId( index );
 
-    m_view[m_ln].LoadMetrics ( metricsConfig, camPosCalConfig, resolution );
+    view.SetMetrics( setup.metrics );
 
-    bool status = m_view[m_ln].SetupCalibration( camPosId,
-                                                 cameraConfig,
-                                                 camPosConfig,
-                                                 floorPlanConfig,
-                                                 camPosCalConfig,
-                                                 m_view[m_ln].GetMetrics() );
+    bool status = view.SetupCalibration( setup.calibration, view.GetMetrics() );
     if ( !status )
     {
         LOG_ERROR("Calibration setup failed!");
         return false;
     };
 
-    LOG_INFO(QObject::tr("Configuring tracker %1.").arg(m_ln));
+    LOG_INFO(QObject::tr("Configuring tracker %1.").arg(index));
 
-    status = m_view[m_ln].SetupTracker( tracker,
-                                        m_view[m_ln].GetMetrics(),
-                                        //*m_metrics,
-                                        m_targetFile.toAscii().data(),
-                                        biLevelThreshold );
+    status = view.SetupTracker( tracker,
+                                view.GetMetrics(),
+                                //*m_metrics,
+                                m_targetFile.toAscii().data(),
+                                biLevelThreshold );
     if ( !status )
     {
         LOG_ERROR("Tracker setup failed!");
         return false;
     };
 
-    m_view[m_ln].SetTrackerParam( RobotTracker::PARAM_NCC_THRESHOLD, nccThreshold );
+    view.SetTrackerParam( RobotTracker::PARAM_NCC_THRESHOLD, nccThreshold );
+    view.SetTrackerParam( RobotTracker::PARAM_MOTION_PREDICTION, motionPrediction ? 1.f : 0.f );
 
     float shutter = 411;
     float gain = 75;
@@ -189,9 +254,19 @@ bool GtsScene::LoadCameraConfig( const KeyId               camPosId,
         break;
     }
 
-    LOG_INFO(QObject::tr("Setting up video %1.").arg(m_ln));
+    LOG_INFO(QObject::tr("Setting up video %1.").arg(index));
+
+    {
+        // Opening a capture is not safe to do from several threads at
+        // once with every OpenCV/FFmpeg build, so videos are opened in turn.
+        QMutexLocker lock( &m_videoSetupMutex );
+
+        status = view.SetupVideo( setup.videoFileName.toAscii().data(),
+                                  setup.timestampFileName.toAscii().data(),
+                                  shutter,
+                                  gain );
+    }
 
-    status = m_view[m_ln].SetupVideo( selectedVideoFileName, timestampFileName, shutter, gain );
     if ( !status )
     {
         LOG_ERROR("Video setup failed!");
@@ -199,9 +274,17 @@ bool GtsScene::LoadCameraConfig( const KeyId               camPosId,
         return false;
     }
 
-    LOG_INFO("Done.");
+    // The live coverage is measured against the part
+    // of the ground plane which this camera can see.
+    IplImage* groundPlaneMask = view.CreateGroundPlaneMask();
 
-    m_ln++;
+    delete m_coverage[index];
+    m_coverage[index] = new CoverageSystem( view.GetWarpImageSize() );
+    m_coverage[index]->SetFloorMask( groundPlaneMask );
+
+    cvReleaseImage( &groundPlaneMask );
+
+    LOG_INFO(QObject::tr("Done %1.").arg(index));
 
     return true;
 }
@@ -230,36 +313,62 @@ void GtsScene::DestroyViewWindows( ImageGrid* imageGrid )
 }
 
 /**
+  Step every configured view by one frame.
+
+  When parallel stepping is enabled each view decodes, unwarps and tracks
+  its frame as a separate task on the global thread pool. All tasks are
+  joined before the status is built, and the results are combined in camera
+  order, so the output is the same as stepping the views one after another.
+
+  Frames are only drawn and sent to the tool when the display is due
+  (see SetDisplayRate); the views keep the latest frame for RefreshDisplay.
+
   @return a TrackResult indicating how many trackers are currently active,
   and how many of those are lost.
  **/
 GtsScene::TrackStatus GtsScene::StepTrackers( const bool forward, const bool seek )
 {
     m_filePositionInMilliseconds = forward ? m_filePositionInMilliseconds+m_rateInMilliseconds : MAX(m_filePositionInMilliseconds-m_rateInMilliseconds, 0);
-    TrackStatus status = { m_filePositionInMilliseconds, 0, 0, false };
+    TrackStatus status = { m_filePositionInMilliseconds, 0, 0, false, false, 0.0, 0.0 };
 
-    for (unsigned int i = 0; i < GetNumMaxCameras(); ++i)
+    const double seekPosition = m_filePositionInMilliseconds;
+    const bool display = DisplayDue();
+    const double excessLatencyBudgetMs = ExcessLatencyBudget();
+
+    QFuture<ViewStepResult> pending[GtsScene::kMaxCameras];
+
+    if ( m_parallelStepping )
     {
-        if ( m_view[i].IsSetup() )
+        for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
         {
-            bool ready;
-            if ( seek )
+            if ( m_view[i].IsSetup() )
             {
-                ready = m_view[i].ReadySeekFrame( m_filePositionInMilliseconds );
+                pending[i] = QtConcurrent::run( this,
+                                                &GtsScene::StepView,
+                                                i,
+                                                forward,
+                                                seek,
+                                                seekPosition,
+                                                display,
+                                                excessLatencyBudgetMs );
             }
-            else
+        }
+    }
+
+    for (unsigned int i = 0; i < GetNumMaxCameras(); ++i)
+    {
+        if ( m_view[i].IsSetup() )
+        {
+            const ViewStepResult result = m_parallelStepping ? pending[i].result()
+                                                             : StepView( i, forward, seek, seekPosition, display, excessLatencyBudgetMs );
+
+            if ( !seek && result.ready )
             {
-                ready = m_view[i].ReadyNextFrame();
-                if ( ready )
-                {
-                    m_filePositionInMilliseconds = m_view[i].GetSeekPositionInMilliseconds();
-                }
+                m_filePositionInMilliseconds = result.position;
             }
 
-            if ( ready && m_view[i].GetNextFrame() )
+            if ( result.stepped )
             {
-                m_view[i].StepTracker( forward );
-
                 RobotTracker& tracker = m_view[i].GetTracker();
 
                 if ( tracker.IsLost() )
@@ -283,9 +392,178 @@ GtsScene::TrackStatus GtsScene::StepTrackers( const bool forward, const bool see
         }
     }
 
+    UpdateRates( status, display );
+
     return status;
 }
 
+/**
+  Limit how often stepped frames are drawn and sent to the tool.
+
+  @param rate maximum display updates per second, or 0 to show every frame.
+  @param headless if set nothing is shown while running; the latest frame
+  is shown by RefreshDisplay when the run pauses or stops.
+ **/
+void GtsScene::SetDisplayRate( double rate, bool headless )
+{
+    QMutexLocker lock( &m_displayMutex );
+
+    if ( headless )
+    {
+        m_displayIntervalMs = -1;
+    }
+    else
+    {
+        m_displayIntervalMs = ( rate > 0.0 ) ? (int)( 1000.0 / rate + .5 ) : 0;
+    }
+}
+
+/**
+  Set how far a live camera frame may lag the least delayed frame seen
+  (its excess latency) before tracking skips ahead to a newer one.
+
+  @param budgetMs the excess latency budget in milliseconds, or 0 to track every frame.
+ **/
+void GtsScene::SetExcessLatencyBudget( double budgetMs )
+{
+    QMutexLocker lock( &m_displayMutex );
+
+    m_excessLatencyBudgetMs = budgetMs;
+}
+
+/**
+  Send every view's latest frame to the tool if it has not been shown.
+ **/
+void GtsScene::RefreshDisplay()
+{
+    bool displayed = false;
+
+    for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
+    {
+        if ( m_view[i].IsSetup() )
+        {
+            displayed = m_view[i].ShowLatestFrame( m_coverage[i] ) || displayed;
+        }
+    }
+
+    if ( displayed )
+    {
+        ++m_displaysSinceRate;
+    }
+}
+
+bool GtsScene::DisplayDue()
+{
+    QMutexLocker lock( &m_displayMutex );
+
+    if ( m_displayIntervalMs <= 0 )
+    {
+        return m_displayIntervalMs == 0;
+    }
+
+    if ( m_displayTimer.isNull() || m_displayTimer.elapsed() >= m_displayIntervalMs )
+    {
+        m_displayTimer.start();
+        return true;
+    }
+
+    return false;
+}
+
+double GtsScene::ExcessLatencyBudget()
+{
+    QMutexLocker lock( &m_displayMutex );
+
+    return m_excessLatencyBudgetMs;
+}
+
+void GtsScene::UpdateRates( TrackStatus& status, bool displayed )
+{
+    const int RATE_PERIOD_MS = 1000;
+
+    if ( m_rateTimer.isNull() )
+    {
+        m_rateTimer.start();
+    }
+
+    ++m_stepsSinceRate;
+
+    if ( displayed )
+    {
+        ++m_displaysSinceRate;
+    }
+
+    const int elapsed = m_rateTimer.elapsed();
+
+    if ( elapsed >= RATE_PERIOD_MS )
+    {
+        status.ratesUpdated = true;
+        status.trackingRate = 1000.0 * m_stepsSinceRate / elapsed;
+        status.displayRate = 1000.0 * m_displaysSinceRate / elapsed;
+
+        m_stepsSinceRate = 0;
+        m_displaysSinceRate = 0;
+
+        for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
+        {
+            if ( m_view[i].IsSetup() && m_view[i].IsLive() )
+            {
+                status.live[i] = true;
+                m_view[i].TakeLiveStats( status.excessLatencyMs[i], status.framesDropped[i] );
+            }
+
+            if ( m_view[i].IsSetup() )
+            {
+                status.kltTracked[i] = m_view[i].TakeKltStats( status.kltPredictedPercent[i],
+                                                               status.kltWindowPx[i],
+                                                               status.kltResidualPx[i] );
+            }
+
+            status.coveragePercent[i] = ( m_view[i].IsSetup() && m_coverage[i] ) ?
+                                        m_coverage[i]->EstimateCurrentCoverage() : -1.0;
+        }
+        m_rateTimer.start();
+    }
+}
+
+/**
+  Ready, fetch and track the next frame of a single view.
+
+  Only touches state belonging to that view, so it is safe to
+  run for several views at once.
+ **/
+GtsScene::ViewStepResult GtsScene::StepView( unsigned int index,
+                                             const bool   forward,
+                                             const bool   seek,
+                                             const double seekPosition,
+                                             const bool   display,
+                                             const double excessLatencyBudgetMs )
+{
+    GtsView& view = m_view[index];
+    ViewStepResult result = { false, false, 0.0 };
+
+    if ( seek )
+    {
+        result.ready = view.ReadySeekFrame( seekPosition );
+    }
+    else
+    {
+        result.ready = view.ReadyNextFrame( excessLatencyBudgetMs );
+        if ( result.ready )
+        {
+            result.position = view.GetSeekPositionInMilliseconds();
+        }
+    }
+
+    if ( result.ready && view.GetNextFrame() )
+    {
+        view.StepTracker( forward, display, m_coverage[index] );
+        result.stepped = true;
+    }
+
+    return result;
+}
+
 void GtsScene::SetupThread( TrackRobotWidget* tool )
 {
     m_thread = new TrackThread( *this );
@@ -309,6 +587,30 @@ void GtsScene::SetupThread( TrackRobotWidget* tool )
                      (QObject*)tool,
                      SLOT( SetPosition ( double ) ),
                      Qt::AutoConnection );
+
+    QObject::connect((QObject*)m_thread,
+                     SIGNAL( rates( double, double ) ),
+                     (QObject*)tool,
+                     SLOT( SetRates( double, double ) ),
+                     Qt::AutoConnection );
+
+    QObject::connect((QObject*)m_thread,
+                     SIGNAL( excessLatency( int, double, unsigned int ) ),
+                     (QObject*)tool,
+                     SLOT( SetExcessLatency( int, double, unsigned int ) ),
+                     Qt::AutoConnection );
+
+    QObject::connect((QObject*)m_thread,
+                     SIGNAL( klt( int, double, double, double ) ),
+                     (QObject*)tool,
+                     SLOT( SetKltStats( int, double, double, double ) ),
+                     Qt::AutoConnection );
+
+    QObject::connect((QObject*)m_thread,
+                     SIGNAL( coverage( int, double ) ),
+                     (QObject*)tool,
+                     SLOT( SetCoverage( int, double ) ),
+                     Qt::AutoConnection );
 }
 
 void GtsScene::StartThread( double rate, bool trackingActive,
@@ -406,9 +708,12 @@ void GtsScene::PostProcessMultiCamera( TrackHistory::TrackLog& avg,
             ScanUtility::TransformLog( m_logPx[i], tlog, m_view[i].GetTracker().GetCalibration()->GetCameraTransform() );
             m_logPx[i] = tlog;
 
+            TrackHistory::DropLog drops;
+            m_view[i].GetTracker().ConvertDropsForProcessing( drops );
+
             // Write the individual transformed logs as these can be useful for external analysis:
             const QString fileName(FileUtilities::GetUniqueFileName(trackResultsTemplate));
-            TrackHistory::WriteHistoryLog( fileName.toAscii().data(), tlog );
+            TrackHistory::WriteHistoryLog( fileName.toAscii().data(), tlog, drops );
 
             ScanUtility::PlotLog( m_logPx[i],
                                  *compImgCol,
@@ -495,15 +800,31 @@ void GtsScene::SaveData( char* floorPlanFile,
     // Write composite image to file
     cvSaveImage( trackerResultsImgFile, compImgCol );
 
+    // Gather the frames dropped by every camera, in time order
+    TrackHistory::DropLog drops;
+
+    for ( unsigned int i = 0; i < GetNumMaxCameras(); ++i )
+    {
+        if ( m_view[i].IsSetup() )
+        {
+            TrackHistory::DropLog viewDrops;
+            m_view[i].GetTracker().ConvertDropsForProcessing( viewDrops );
+
+            drops.insert( drops.end(), viewDrops.begin(), viewDrops.end() );
+        }
+    }
+
+    std::sort( drops.begin(), drops.end() );
+
     // Write average log to file
     if ( trackerResultsTxtFile )
     {
-        TrackHistory::WriteHistoryLog( trackerResultsTxtFile, avg );
+        TrackHistory::WriteHistoryLog( trackerResultsTxtFile, avg, drops );
     }
 
     if ( trackerResultsCsvFile )
     {
-        TrackHistory::WriteHistoryCsv( trackerResultsCsvFile, avg );
+        TrackHistory::WriteHistoryCsv( trackerResultsCsvFile, avg, drops );
     }
 
     // Write origin-offset to file
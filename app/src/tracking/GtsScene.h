@@ -20,6 +20,9 @@
 #define GTSSCENE_H
 
 #include <QFile>
+#include <QtCore/QFuture>
+#include <QtCore/QMutex>
+#include <QtCore/QTime>
 
 #include "GtsView.h"
 #include "RobotTracker.h"
@@ -52,15 +55,39 @@ public:
 
     bool LoadTarget( const WbConfig& targetCfg );
 
-    bool LoadCameraConfig( const KeyId               camPosId,
-                           const char* const         selectedVideoFileName,
-                           const char* const         timestampFileName,
-                           const WbConfig&           cameraConfig,
-                           const WbConfig&           camPosConfig,
-                           const WbConfig&           roomConfig,
-                           const WbConfig&           robotConfig,
-                           const WbConfig&           trackConfig,
-                           RobotTracker::trackerType tracker );
+    /**
+        Everything needed to set up the view for one camera position,
+        read from the workbench configs by ReadCameraSetup. It holds
+        only plain values (no WbConfig handles), so the setup itself
+        can run on another thread.
+    **/
+    struct CameraSetup
+    {
+        KeyId                     camPosId;
+        QString                   videoFileName;
+        QString                   timestampFileName;
+        GtsView::CalibrationSetup calibration;
+        RobotMetrics              metrics;
+        int                       biLevelThreshold;
+        double                    nccThreshold;
+        int                       resolution;
+        bool                      motionPrediction;
+        RobotTracker::trackerType tracker;
+    };
+
+    static bool ReadCameraSetup( const KeyId&              camPosId,
+                                 const QString&            videoFileName,
+                                 const QString&            timestampFileName,
+                                 const WbConfig&           cameraConfig,
+                                 const WbConfig&           camPosConfig,
+                                 const WbConfig&           roomConfig,
+                                 const WbConfig&           robotConfig,
+                                 const WbConfig&           trackConfig,
+                                 RobotTracker::trackerType tracker,
+                                 CameraSetup&              setup );
+
+    bool LoadCameraConfig( const CameraSetup& setup );
+    QFuture<bool> LoadCameraConfigAsync( const CameraSetup& setup );
 
     unsigned int GetNumMaxCameras() const { return GtsScene::kMaxCameras; }
 
@@ -75,10 +102,40 @@ public:
         size_t numTrackersActive;
 
         bool eof;
+
+        // Steps and display updates per second, refreshed about once
+        // a second (when ratesUpdated is set).
+        bool   ratesUpdated;
+        double trackingRate;
+        double displayRate;
+
+        // Per camera, also refreshed with the rates: whether it is a
+        // live camera, its mean excess latency (ms) and total dropped frames.
+        bool         live[GTS_MAX_CAMERAS];
+        double       excessLatencyMs[GTS_MAX_CAMERAS];
+        unsigned int framesDropped[GTS_MAX_CAMERAS];
+
+        // Per camera, also refreshed with the rates: the KLT diagnostics
+        // averaged over the frames tracked (see GtsView::TakeKltStats).
+        bool         kltTracked[GTS_MAX_CAMERAS];
+        double       kltPredictedPercent[GTS_MAX_CAMERAS];
+        double       kltWindowPx[GTS_MAX_CAMERAS];
+        double       kltResidualPx[GTS_MAX_CAMERAS];
+
+        // Percentage of each camera's ground plane covered
+        // by the brush bar so far (-1 if not known).
+        double       coveragePercent[GTS_MAX_CAMERAS];
     };
 
     TrackStatus StepTrackers( const bool forward, const bool seek );
 
+    void SetDisplayRate( double rate, bool headless );
+    void SetExcessLatencyBudget( double budgetMs );
+    void RefreshDisplay();
+
+    void SetParallelStepping( bool parallel ) { m_parallelStepping = parallel; }
+    bool IsParallelStepping() const { return m_parallelStepping; }
+
     void SetupThread( TrackRobotWidget* tool );
     void StartThread( double rate, bool trackingActive = true,
                                    bool singleStep = false,
@@ -100,6 +157,31 @@ public:
     void ClrTrackPosition( int id );
 
 private:
+    /**
+        Outcome of stepping a single view, gathered so that the
+        aggregate TrackStatus can be built in camera order
+        regardless of which thread did the work.
+    **/
+    struct ViewStepResult
+    {
+        bool   ready;
+        bool   stepped;
+        double position;
+    };
+
+    bool LoadCameraConfigAt( unsigned int index, const CameraSetup& setup );
+
+    ViewStepResult StepView( unsigned int index,
+                             const bool   forward,
+                             const bool   seek,
+                             const double seekPosition,
+                             const bool   display,
+                             const double excessLatencyBudgetMs );
+
+    bool DisplayDue();
+    double ExcessLatencyBudget();
+    void UpdateRates( TrackStatus& status, bool displayed );
+
     int OrganiseLogs( TrackHistory::TrackLog* log,
                       QString pixelOffsetsTemplate );
 
@@ -118,6 +200,9 @@ private:
 
     GtsView m_view[GtsScene::kMaxCameras];
 
+    // Live coverage of each view's ground plane, updated as it is tracked.
+    CoverageSystem* m_coverage[GtsScene::kMaxCameras];
+
     QString m_targetFile;
 
     // post processing variables
@@ -135,6 +220,24 @@ private:
     double m_filePositionInMilliseconds;
     double m_rateInMilliseconds;
 
+    bool m_parallelStepping;
+
+    QMutex m_videoSetupMutex;
+
+    // Display updates: every step (0), at most every
+    // m_displayIntervalMs, or not while running (<0).
+    QMutex m_displayMutex;
+    int    m_displayIntervalMs;
+    QTime  m_displayTimer;
+
+    // Live cameras skip frames lagging the least delayed frame by more
+    // than this (ms); 0 keeps every frame.
+    double m_excessLatencyBudgetMs;
+
+    QTime        m_rateTimer;
+    unsigned int m_stepsSinceRate;
+    unsigned int m_displaysSinceRate;
+
     unsigned int m_ln;
 };
 
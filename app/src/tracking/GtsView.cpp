@@ -52,6 +52,7 @@
 #include <QObject>
 
 #include <sstream>
+#include <algorithm>
 
 #include <math.h>
 #include <stdio.h>
@@ -72,9 +73,30 @@ GtsView::GtsView() :
     m_sequencer   ( 0 ),
     m_imgFrame    ( 0 ),
     m_imgGrey     ( 0 ),
+    m_imgGreyPrev ( 0 ),
+    m_greyFrames  ( false ),
     m_thumbnail   ( 0 ),
     m_metrics     ( 0 ),
-    m_imgIndex    ( 0 )
+    m_imgIndex    ( 0 ),
+    m_roiUnwarp   ( true ),
+    m_lastUnwarpFull( true ),
+    m_displayPending( false ),
+    m_lastTracking( false ),
+    m_numCovered  ( 0 ),
+    m_coverageStale( true ),
+    m_liveClock   (),
+    m_liveOffsetValid( false ),
+    m_liveOffsetMs( 0.0 ),
+    m_liveFrameTimeMs( 0.0 ),
+    m_liveFrames  ( 0 ),
+    m_excessLatencySumMs( 0.0 ),
+    m_excessLatencyCount( 0 ),
+    m_framesDropped( 0 ),
+    m_kltFrames( 0 ),
+    m_kltPredicted( 0 ),
+    m_kltWindowSumPx( 0.0 ),
+    m_kltResidualSumPx( 0.0 ),
+    m_kltResidualCount( 0 )
 {
     m_imgWarp[0] = 0;
     m_imgWarp[1] = 0;
@@ -92,6 +114,7 @@ void GtsView::Reset()
     cvReleaseImage( &m_imgWarp[0] );
     cvReleaseImage( &m_imgWarp[1] );
     cvReleaseImage( &m_imgFrame );
+    cvReleaseImage( &m_imgGreyPrev );
     cvReleaseImage( &m_thumbnail );
 
     delete m_tracker;
@@ -100,6 +123,23 @@ void GtsView::Reset()
     delete m_sequencer;
     delete m_metrics;
 
+    m_lastUnwarpFull = true;
+    m_displayPending = false;
+    m_trackOverlay.Invalidate();
+    m_numCovered = 0;
+    m_coverageStale = true;
+
+    m_liveOffsetValid = false;
+    m_liveFrames = 0;
+    m_excessLatencySumMs = 0.0;
+    m_excessLatencyCount = 0;
+    m_framesDropped = 0;
+    m_kltFrames = 0;
+    m_kltPredicted = 0;
+    m_kltWindowSumPx = 0.0;
+    m_kltResidualSumPx = 0.0;
+    m_kltResidualCount = 0;
+
     m_id = -1;
 }
 
@@ -153,27 +193,23 @@ void GtsView::SaveThumbnail()
 }
 
 /**
- Allocate a RobotMetrics object and read data into it.
+ Allocate a RobotMetrics object holding a copy of @a metrics.
  **/
-bool GtsView::LoadMetrics( const WbConfig& metricsConfig,
-                           const WbConfig& camPosCalConfig,
-                           float trackingResolution )
+void GtsView::SetMetrics( const RobotMetrics& metrics )
 {
-    m_metrics = new RobotMetrics();
-
-    return m_metrics->LoadMetrics( metricsConfig, camPosCalConfig, trackingResolution );
+    m_metrics = new RobotMetrics( metrics );
 }
 
 /**
-    Pass in the names for the calibration-image and calibration-data files.
-    GtsView will then load/compute the calibration data.
+    Read the calibration settings for a camera position from the
+    workbench configs: the intrinsic and floor plan parameters, the
+    board size and the names of the calibration image and warp caches.
 **/
-bool GtsView::SetupCalibration( const KeyId     camPosId,
-                                const WbConfig& cameraConfig,
-                                const WbConfig& camPosConfig,
-                                const WbConfig& floorPlanConfig,
-                                const WbConfig& camPosCalConfig,
-                                RobotMetrics&   metrics )
+bool GtsView::ReadCalibrationSetup( const KeyId       camPosId,
+                                    const WbConfig&   cameraConfig,
+                                    const WbConfig&   camPosConfig,
+                                    const WbConfig&   floorPlanConfig,
+                                    CalibrationSetup& setup )
 {
     // first load calibration config
     const WbConfig cameraIntrisicConfig( cameraConfig.GetSubConfig( CalibrationSchema::schemaName ) );
@@ -181,36 +217,60 @@ bool GtsView::SetupCalibration( const KeyId     camPosId,
 
     const KeyValue fileNameKeyValue( cameraExtrisicConfig.GetKeyValue( ExtrinsicCalibrationSchema::calibrationImageKey ) );
     const QString fileName( fileNameKeyValue.ToQString() );
-    QString calibImageFileName = cameraExtrisicConfig.GetAbsoluteFileNameFor( fileName );
+    setup.calibImageFileName = cameraExtrisicConfig.GetAbsoluteFileNameFor( fileName );
 
-    m_calScaled = new CameraCalibration();
-    m_calNormal = new CameraCalibration();
-
-    if ( !m_calScaled->LoadIntrinsicCalibration( cameraIntrisicConfig ) ||
-         !m_calNormal->LoadIntrinsicCalibration( cameraIntrisicConfig ) )
+    if ( !CameraCalibration::ReadIntrinsicCalibration( cameraIntrisicConfig, setup.params ) )
     {
         LOG_ERROR("Load intrinsic calibration failed!");
 
-        m_id = -1;
         return false;
     }
 
-    CvSize m_boardsize = cvSize( camPosCalConfig.GetKeyValue(ExtrinsicCalibrationSchema::gridColumnsKey).ToInt(),
-                                 camPosCalConfig.GetKeyValue(ExtrinsicCalibrationSchema::gridRowsKey).ToInt() );
+    setup.boardSize = cvSize( cameraExtrisicConfig.GetKeyValue(ExtrinsicCalibrationSchema::gridColumnsKey).ToInt(),
+                              cameraExtrisicConfig.GetKeyValue(ExtrinsicCalibrationSchema::gridRowsKey).ToInt() );
+
+    // The ground-plane warps are cached next to the camera position
+    // config so reloading a run does not repeat the extrinsic calibration.
+    setup.scaledWarpCacheFileName = camPosConfig.GetAbsoluteFileNameFor( "groundPlaneWarpScaled.bin" );
+    setup.normalWarpCacheFileName = camPosConfig.GetAbsoluteFileNameFor( "groundPlaneWarpNormal.bin" );
+
+    if ( !CameraCalibration::ReadCameraTransform( camPosId, floorPlanConfig, setup.params ) )
+    {
+        LOG_ERROR("Load camera transform failed!");
+
+        return false;
+    }
+
+    return true;
+}
 
-    LOG_INFO(QObject::tr("Board size: %1,%2.").arg(m_boardsize.width)
-                                              .arg(m_boardsize.height));
+/**
+    Set up the calibrations from the settings read by ReadCalibrationSetup,
+    performing the extrinsic calibration (or loading it from the cache).
+**/
+bool GtsView::SetupCalibration( const CalibrationSetup& setup, RobotMetrics& metrics )
+{
+    m_calScaled = new CameraCalibration();
+    m_calNormal = new CameraCalibration();
+
+    m_calScaled->SetIntrinsicCalibration( setup.params );
+    m_calNormal->SetIntrinsicCalibration( setup.params );
+
+    LOG_INFO(QObject::tr("Board size: %1,%2.").arg(setup.boardSize.width)
+                                              .arg(setup.boardSize.height));
 
-    if ( !m_calScaled->PerformExtrinsicCalibration( m_boardsize,
+    if ( !m_calScaled->PerformExtrinsicCalibration( setup.boardSize,
                                                     metrics,
                                                     &m_imgWarp[m_imgIndex],
                                                     true,
-                                                    calibImageFileName.toAscii().data() ) ||
-         !m_calNormal->PerformExtrinsicCalibration( m_boardsize,
+                                                    setup.calibImageFileName.toAscii().data(),
+                                                    setup.scaledWarpCacheFileName ) ||
+         !m_calNormal->PerformExtrinsicCalibration( setup.boardSize,
                                                     metrics,
                                                     &m_imgWarp_[m_imgIndex],
                                                     false,
-                                                    calibImageFileName.toAscii().data() ) )
+                                                    setup.calibImageFileName.toAscii().data(),
+                                                    setup.normalWarpCacheFileName ) )
     {
         LOG_ERROR("Extrinsic calibration failed!");
 
@@ -218,15 +278,10 @@ bool GtsView::SetupCalibration( const KeyId     camPosId,
         return false;
     }
 
-    if ( !m_calScaled->LoadCameraTransform( camPosId, floorPlanConfig ) )
-    {
-        LOG_ERROR("Load camera transform failed!");
-
-        m_id = -1;
-        return false;
-    }
+    m_calScaled->SetCameraTransform( setup.params );
 
     m_imgGrey = cvCreateImage( m_calScaled->GetImageSize(), IPL_DEPTH_8U, 1 );
+    m_imgGreyPrev = cvCreateImage( m_calScaled->GetImageSize(), IPL_DEPTH_8U, 1 );
 
     m_imgWarp[1-m_imgIndex] = cvCloneImage( m_imgWarp[m_imgIndex] );
 
@@ -321,6 +376,13 @@ bool GtsView::SetupVideo( const char* const videoFile,
 
     m_fps = m_sequencer->GetFrameRate();
 
+    // Tracking and display only use the grey frame. Live
+    // sequences still need colour frames for the thumbnails.
+    m_greyFrames = !m_sequencer->IsLive();
+    m_sequencer->SetPreferGreyscale( m_greyFrames );
+
+    m_liveClock.start();
+
     LoadTimestampFile( timestampFile );
 
     return true;
@@ -383,9 +445,11 @@ bool GtsView::ReadySeekFrame( double msec )
     Simply ready the next consequetive frame in the video sequence - this is much more
     efficient than seeking (especially on video-files which have a broken/missing seek index).
 
+    @param excessLatencyBudgetMs for live sequences, skip to a newer frame if the next one
+    already lags the least delayed frame by more than this (0 to track every frame).
     @return true if frame is ready, false if there was an error.
 */
-bool GtsView::ReadyNextFrame()
+bool GtsView::ReadyNextFrame( double excessLatencyBudgetMs )
 {
     assert( m_sequencer );
     if ( !m_sequencer )
@@ -393,6 +457,11 @@ bool GtsView::ReadyNextFrame()
         return false;
     }
 
+    if ( m_sequencer->IsLive() )
+    {
+        return ReadyLiveFrame( excessLatencyBudgetMs );
+    }
+
     const double idx = m_sequencer->GetFrameIndex();
     const double final = m_sequencer->GetNumFrames();
 
@@ -404,10 +473,171 @@ bool GtsView::ReadyNextFrame()
     return false;
 }
 
+bool GtsView::IsLive() const
+{
+    return m_sequencer && m_sequencer->IsLive();
+}
+
+/**
+    Ready the next frame from a live sequence. If the tracker has fallen
+    behind so that the frame's excess latency exceeds the budget, frames are skipped
+    until one is within it (or the camera has no newer frame queued, or
+    fails to ready one, when the last frame readied is tracked), and the
+    skip is recorded in the tracker's drop log.
+**/
+bool GtsView::ReadyLiveFrame( double excessLatencyBudgetMs )
+{
+    if ( !m_sequencer->ReadyNextFrame() )
+    {
+        return false;
+    }
+
+    double age = ReadyLiveFrameAge();
+
+    unsigned int dropped = 0;
+
+    if ( excessLatencyBudgetMs > 0.0 )
+    {
+        while ( age > excessLatencyBudgetMs && dropped < m_maxFramesToDrop )
+        {
+            if ( !m_sequencer->ReadyNextFrame() )
+            {
+                // Keep the frame already readied rather than
+                // reporting the end of the sequence.
+                break;
+            }
+
+            ++dropped;
+            age = ReadyLiveFrameAge();
+        }
+    }
+
+    if ( dropped > 0 )
+    {
+        m_framesDropped += dropped;
+
+        if ( m_tracker )
+        {
+            m_tracker->RecordFrameDrop( m_sequencer->GetTimeStamp(), dropped );
+        }
+    }
+
+    return true;
+}
+
+/**
+    Time the frame just readied from a live sequence.
+
+    @return how much later than the least delayed frame so far it arrived (ms).
+**/
+double GtsView::ReadyLiveFrameAge()
+{
+    double frameTime = m_sequencer->GetTimeStamp();
+
+    if ( m_liveFrames > 0 && frameTime <= m_liveFrameTimeMs )
+    {
+        // The camera does not give usable time-stamps,
+        // so assume it delivers at its nominal rate.
+        frameTime = m_liveFrameTimeMs + ( ( m_fps > 0.0 ) ? 1000.0 / m_fps : 0.0 );
+    }
+
+    m_liveFrameTimeMs = frameTime;
+    ++m_liveFrames;
+
+    const double offset = m_liveClock.elapsed() - frameTime;
+
+    if ( !m_liveOffsetValid || offset < m_liveOffsetMs )
+    {
+        m_liveOffsetMs = offset;
+        m_liveOffsetValid = true;
+    }
+
+    return offset - m_liveOffsetMs;
+}
+
+/**
+    Age of the current live frame now, relative to the least delayed frame.
+**/
+double GtsView::LiveFrameExcessLatency() const
+{
+    return m_liveClock.elapsed() - m_liveFrameTimeMs - m_liveOffsetMs;
+}
+
+/**
+    Mean excess latency of the live frames tracked since the last call -
+    how far each lagged the least delayed frame seen, not the end to end
+    delay - and the total frames dropped.
+**/
+void GtsView::TakeLiveStats( double& meanExcessLatencyMs, unsigned int& framesDropped )
+{
+    meanExcessLatencyMs = ( m_excessLatencyCount > 0 ) ? m_excessLatencySumMs / m_excessLatencyCount : 0.0;
+    framesDropped = m_framesDropped;
+
+    m_excessLatencySumMs = 0.0;
+    m_excessLatencyCount = 0;
+}
+
+/**
+    KLT diagnostics averaged over the frames tracked since the last call:
+    the percentage seeded from the motion prediction, the mean search
+    window and the mean distance from seed to tracked position.
+
+    @return false if no frames were tracked by a KltTracker.
+**/
+bool GtsView::TakeKltStats( double& predictedPercent, double& meanWindowPx, double& meanResidualPx )
+{
+    const bool tracked = ( m_kltFrames > 0 );
+
+    if ( tracked )
+    {
+        predictedPercent = 100.0 * m_kltPredicted / m_kltFrames;
+        meanWindowPx = m_kltWindowSumPx / m_kltFrames;
+        meanResidualPx = ( m_kltResidualCount > 0 ) ? m_kltResidualSumPx / m_kltResidualCount : -1.0;
+    }
+
+    m_kltFrames = 0;
+    m_kltPredicted = 0;
+    m_kltWindowSumPx = 0.0;
+    m_kltResidualSumPx = 0.0;
+    m_kltResidualCount = 0;
+
+    return tracked;
+}
+
+/**
+    Add the diagnostics of the frame just tracked to the running totals.
+**/
+void GtsView::AccumulateKltStats()
+{
+    const KltTracker* klt = dynamic_cast<const KltTracker*>( m_tracker );
+
+    if ( klt )
+    {
+        const KltTracker::FrameStats& stats = klt->GetFrameStats();
+
+        ++m_kltFrames;
+        m_kltPredicted += stats.predicted ? 1 : 0;
+        m_kltWindowSumPx += stats.windowSize;
+
+        if ( stats.seedResidual >= 0.f )
+        {
+            m_kltResidualSumPx += stats.seedResidual;
+            ++m_kltResidualCount;
+        }
+    }
+}
+
 const IplImage* GtsView::GetNextFrame()
 {
     bool bad = true;
 
+    if ( m_sequencer && m_greyFrames )
+    {
+        // Straight from the source into the tracking image,
+        // flipping at the same time, with no colour copy.
+        return m_sequencer->RetrieveNextFrameGrey( m_imgGrey, m_sequencer->Flip() ) ? m_imgGrey : 0;
+    }
+
     if ( m_sequencer )
     {
         // New frame is available
@@ -478,24 +708,27 @@ const IplImage* GtsView::GetNextFrame()
 
     If the tracker is inactive then we just get the next image
     from the video sequence but do no processing on it.
+
+    The result is only drawn and sent to the tool if @a display is set;
+    otherwise it is kept so ShowLatestFrame() can send it later.
 **/
-void GtsView::StepTracker( bool forward, CoverageSystem* coverage )
+void GtsView::StepTracker( bool forward, bool display, CoverageSystem* coverage )
 {
-    Q_UNUSED(coverage);
-
     QImage qimage;
 
     bool tracking = false;
 
     if ( m_sequencer->TakeFrame() )
     {
-        assert( "video size & calibration size do not match" &&
-                m_imgFrame->width == m_imgGrey->width &&
-                m_imgFrame->height == m_imgGrey->height );
+        if ( !m_greyFrames )
+        {
+            assert( "video size & calibration size do not match" &&
+                    m_imgFrame->width == m_imgGrey->width &&
+                    m_imgFrame->height == m_imgGrey->height );
 
-        // Convert to grey-scale and flip at same time
-        cvConvertImage( m_imgFrame, m_imgGrey, m_sequencer->Flip() );
-        m_calScaled->UnwarpGroundPlane( m_imgGrey, m_imgWarp[m_imgIndex] );
+            // Convert to grey-scale and flip at same time
+            cvConvertImage( m_imgFrame, m_imgGrey, m_sequencer->Flip() );
+        }
 
         double videoTimeStampInMillisecs = -1.0;
         if ( m_timestamps.size() > 0 )
@@ -511,6 +744,15 @@ void GtsView::StepTracker( bool forward, CoverageSystem* coverage )
             videoTimeStampInMillisecs = m_sequencer->GetTimeStamp();
         }
 
+        // An active tracker only looks near the target. Loss recovery,
+        // rewinding and frames that are going to be shown need the whole frame.
+        const bool roiOnly = m_roiUnwarp &&
+                             forward &&
+                             !display &&
+                             m_tracker->IsActive();
+        const bool prevUnwarpFull = m_lastUnwarpFull;
+        UnwarpFrame( !roiOnly, videoTimeStampInMillisecs );
+
         m_tracker->SetCurrentImage( m_imgWarp[m_imgIndex] );
 
         // Perform motion detection so
@@ -519,9 +761,11 @@ void GtsView::StepTracker( bool forward, CoverageSystem* coverage )
         if ( m_tracker->IsActive() )
         {
             tracking = m_tracker->Track( videoTimeStampInMillisecs );
+            AccumulateKltStats();
 	    // If active but cannot track then go to lossRecovery
 	    if(!tracking)
 	    {
+		  UnwarpForLossRecovery( prevUnwarpFull );
 		  m_tracker->DoInactiveProcessing( videoTimeStampInMillisecs );
                   m_tracker->LossRecovery();
 	    }
@@ -532,6 +776,7 @@ void GtsView::StepTracker( bool forward, CoverageSystem* coverage )
             {
                 if ( m_tracker->IsLost() )
                 {
+                    UnwarpForLossRecovery( prevUnwarpFull );
                     m_tracker->DoInactiveProcessing( videoTimeStampInMillisecs );
                     m_tracker->LossRecovery();
                 }
@@ -539,27 +784,214 @@ void GtsView::StepTracker( bool forward, CoverageSystem* coverage )
             else
             {
                 m_tracker->Rewind( videoTimeStampInMillisecs );
+                m_trackOverlay.Invalidate();
+                m_coverageStale = true;
             }
         }
 
-        qimage = GroundTruthUI::showRobotTrack( m_tracker, tracking );
+        m_lastTracking = tracking;
+
+        if ( coverage && forward )
+        {
+            UpdateCoverage( *coverage );
+        }
+
+        if ( display )
+        {
+            qimage = GroundTruthUI::showRobotTrack( m_tracker,
+                                                    tracking,
+                                                    m_trackOverlay,
+                                                    m_coverageStale ? 0 : coverage );
+
+            m_tool->ImageUpdate( m_id, qimage.rgbSwapped(), m_fps );
+        }
 
-        m_tool->ImageUpdate( m_id, qimage.rgbSwapped(), m_fps );
+        m_displayPending = !display;
+
+        // Keep the grey frame behind a partly unwarped image, in
+        // case loss recovery needs the rest of it on the next step.
+        if ( !m_lastUnwarpFull )
+        {
+            cvCopy( m_imgGrey, m_imgGreyPrev );
+        }
 
         m_imgIndex = 1 - m_imgIndex;
+
+        if ( m_sequencer->IsLive() )
+        {
+            m_excessLatencySumMs += LiveFrameExcessLatency();
+            ++m_excessLatencyCount;
+        }
     }
 }
 
+/**
+    Send the most recently stepped frame to the tool if StepTracker
+    skipped it, e.g. when the run pauses between display updates.
+    The frame is unwarped in full first if only the area around the
+    target was done.
+
+    @return true if a frame was sent.
+**/
+bool GtsView::ShowLatestFrame( const CoverageSystem* coverage )
+{
+    if ( !m_displayPending )
+    {
+        return false;
+    }
+
+    if ( !m_lastUnwarpFull )
+    {
+        // The tracker's current image is the buffer StepTracker
+        // has just flipped away from.
+        m_calScaled->UnwarpGroundPlane( m_imgGrey, m_imgWarp[1 - m_imgIndex] );
+        m_lastUnwarpFull = true;
+    }
+
+    QImage qimage = GroundTruthUI::showRobotTrack( m_tracker,
+                                                   m_lastTracking,
+                                                   m_trackOverlay,
+                                                   m_coverageStale ? 0 : coverage );
+
+    m_tool->ImageUpdate( m_id, qimage.rgbSwapped(), m_fps );
+
+    m_displayPending = false;
+
+    return true;
+}
+
+/**
+    Unwarp the current grey frame into the current ground plane image,
+    either completely or just the box around where the tracker expects
+    the target in the frame at @a timestampInMillisecs (its motion
+    prediction if it has one, otherwise its last position).
+**/
+void GtsView::UnwarpFrame( bool full, double timestampInMillisecs )
+{
+    if ( full )
+    {
+        m_calScaled->UnwarpGroundPlane( m_imgGrey, m_imgWarp[m_imgIndex] );
+        m_lastUnwarpFull = true;
+        return;
+    }
+
+    CvPoint2D32f pos;
+    if ( !m_tracker->PredictPosition( timestampInMillisecs, pos ) )
+    {
+        pos = m_tracker->GetPosition();
+    }
+    const int pad = (int)( m_roiUnwarpPadRadii * m_metrics->GetRadiusPx() + .5f );
+
+    m_calScaled->UnwarpGroundPlane( m_imgGrey,
+                                    m_imgWarp[m_imgIndex],
+                                    cvRect( (int)pos.x - pad, (int)pos.y - pad, 2 * pad + 1, 2 * pad + 1 ) );
+    m_lastUnwarpFull = false;
+}
+
+/**
+    Loss recovery looks for motion between the current and previous ground
+    plane images, so both must be unwarped in full; pixels left over from
+    an older frame would show up as motion. The previous image is redone
+    from its saved grey frame if only the box around the target was done.
+
+    @param prevUnwarpFull Whether the previous image was unwarped in full.
+**/
+void GtsView::UnwarpForLossRecovery( bool prevUnwarpFull )
+{
+    if ( !m_lastUnwarpFull )
+    {
+        UnwarpFrame( true, -1.0 );
+    }
+
+    if ( !prevUnwarpFull )
+    {
+        m_calScaled->UnwarpGroundPlane( m_imgGreyPrev, m_imgWarp[1 - m_imgIndex] );
+    }
+}
+
+/**
+    Sweep the brush bar between the tracker history entries added since
+    the last call. If the history has been changed other than by appending
+    to it the coverage is cleared and the whole history swept again, which
+    only happens after a rewind or a manual reposition; otherwise the cost
+    depends only on the distance moved.
+
+    Entries further apart in time than a track break are not joined up, as
+    in PostProcessWidget.
+**/
+void GtsView::UpdateCoverage( CoverageSystem& coverage )
+{
+    const double COVERAGE_BREAK_MS = 750.0;
+
+    const TrackHistory::TrackLog& history = m_tracker->GetHistory();
+
+    if ( m_coverageStale || history.size() < m_numCovered )
+    {
+        coverage.Reset();
+        m_numCovered = 0;
+        m_coverageStale = false;
+    }
+
+    for ( size_t i = std::max( m_numCovered, (size_t)1 ); i < history.size(); ++i )
+    {
+        const TrackEntry& prev = history[i - 1];
+        const TrackEntry& curr = history[i];
+
+        if ( fabs( curr.t() - prev.t() ) >= COVERAGE_BREAK_MS )
+        {
+            continue;
+        }
+
+        const CvPoint2D32f prevBase = m_tracker->AdjustTrackForRobotHeight( prev.GetPosition(),
+                                                                           prev.GetOrientation() );
+        const CvPoint2D32f currBase = m_tracker->AdjustTrackForRobotHeight( curr.GetPosition(),
+                                                                           curr.GetOrientation() );
+
+        coverage.BrushBarUpdate( m_tracker->GetBrushBarLeft( prevBase, prev.GetOrientation() ),
+                                 m_tracker->GetBrushBarRight( prevBase, prev.GetOrientation() ),
+                                 m_tracker->GetBrushBarLeft( currBase, curr.GetOrientation() ),
+                                 m_tracker->GetBrushBarRight( currBase, curr.GetOrientation() ) );
+    }
+
+    m_numCovered = history.size();
+}
+
+/**
+    A mask of the part of the ground plane image this camera can see
+    (255 where the unwarped frame has image data, 0 elsewhere). The
+    caller owns the image.
+**/
+IplImage* GtsView::CreateGroundPlaneMask()
+{
+    IplImage* seen = cvCreateImage( cvGetSize( m_imgGrey ), IPL_DEPTH_8U, 1 );
+    cvSet( seen, cvScalar( 255 ) );
+
+    IplImage* mask = cvCreateImage( GetWarpImageSize(), IPL_DEPTH_8U, 1 );
+    m_calScaled->UnwarpGroundPlane( seen, mask );
+    cvCmpS( mask, 0, mask, CV_CMP_GT );
+
+    cvReleaseImage( &seen );
+
+    return mask;
+}
+
 void GtsView::ShowRobotTrack()
 {
-    QImage qimage = GroundTruthUI::showRobotTrack( m_tracker, true );
+    // The track has been repositioned by hand.
+    m_trackOverlay.Invalidate();
+    m_coverageStale = true;
+
+    QImage qimage = GroundTruthUI::showRobotTrack( m_tracker, true, m_trackOverlay );
 
     m_tool->ImageSet( m_id, qimage.rgbSwapped(), m_fps );
 }
 
 void GtsView::HideRobotTrack()
 {
-    QImage qimage = GroundTruthUI::showRobotTrack( m_tracker, false );
+    m_trackOverlay.Invalidate();
+    m_coverageStale = true;
+
+    QImage qimage = GroundTruthUI::showRobotTrack( m_tracker, false, m_trackOverlay );
 
     m_tool->ImageSet( m_id, qimage.rgbSwapped(), m_fps );
 }
@@ -23,12 +23,15 @@
 
 #include "RobotTracker.h"
 #include "RobotMetrics.h"
+#include "CameraCalibration.h"
+#include "GroundTruthUI.h"
 
 #include "WbConfig.h"
 
 #include <opencv/cv.h>
 
 #include <QtGui/QImage>
+#include <QtCore/QTime>
 
 #if defined(__MINGW32__) || defined(_MSC_VER)
     #include <WinTime.h>
@@ -38,7 +41,6 @@
 
 class CoverageSystem;
 class RobotMetrics;
-class CameraCalibration;
 class VideoSequence;
 class ImageView;
 class ImageGrid;
@@ -66,16 +68,28 @@ public:
     void SetId( int id );
     bool IsSetup() const { return m_id>=0; }
 
-    bool LoadMetrics( const WbConfig& metricsConfig,
-                      const WbConfig& camPosCalConfig,
-                      float trackingResolution );
+    /**
+        The calibration settings for a view, as read from the
+        workbench configs by ReadCalibrationSetup.
+    **/
+    struct CalibrationSetup
+    {
+        CameraCalibration::ConfigParams params;
+        CvSize                          boardSize;
+        QString                         calibImageFileName;
+        QString                         scaledWarpCacheFileName;
+        QString                         normalWarpCacheFileName;
+    };
+
+    static bool ReadCalibrationSetup( const KeyId       camPosId,
+                                      const WbConfig&   cameraConfig,
+                                      const WbConfig&   camPosConfig,
+                                      const WbConfig&   floorPlanConfig,
+                                      CalibrationSetup& setup );
+
+    void SetMetrics( const RobotMetrics& metrics );
 
-    bool SetupCalibration( const KeyId     camPosId,
-                           const WbConfig& cameraConfig,
-                           const WbConfig& camPosConfig,
-                           const WbConfig& floorPlanConfig,
-                           const WbConfig& camPosCalConfig,
-                           RobotMetrics&   metrics );
+    bool SetupCalibration( const CalibrationSetup& setup, RobotMetrics& metrics );
 
     bool SetupTracker( RobotTracker::trackerType type,
                        const RobotMetrics& met,
@@ -91,6 +105,9 @@ public:
 
     void SetTrackerParam( RobotTracker::paramType param, float value );
 
+    void SetRoiUnwarp( bool enable ) { m_roiUnwarp = enable; }
+    bool IsRoiUnwarp() const { return m_roiUnwarp; }
+
     CvSize GetWarpImageSize() const { assert(m_imgWarp[0]); return cvSize(m_imgWarp[0]->width,
                                                                           m_imgWarp[0]->height); }
 
@@ -98,16 +115,24 @@ public:
 
     double GetSeekPositionInMilliseconds() const;
     bool ReadySeekFrame( double msec );
-    bool ReadyNextFrame();
+    bool ReadyNextFrame( double excessLatencyBudgetMs = 0.0 );
     const IplImage* GetNextFrame();
 
+    bool IsLive() const;
+    void TakeLiveStats( double& meanExcessLatencyMs, unsigned int& framesDropped );
+    bool TakeKltStats( double& predictedPercent, double& meanWindowPx, double& meanResidualPx );
+
+    // Colour frame; only kept when frames are not retrieved straight to grey.
     const IplImage* GetCurrentImage() const { return m_imgFrame; }
     const IplImage* GetGroundPlaneImage() const { return m_imgWarp[m_imgIndex]; }
 
     RobotTracker& GetTracker() const { return *m_tracker; }
     RobotMetrics& GetMetrics() const { return *m_metrics; }
 
-    void StepTracker( bool forward, CoverageSystem* coverage=0 );
+    void StepTracker( bool forward, bool display, CoverageSystem* coverage=0 );
+    bool ShowLatestFrame( const CoverageSystem* coverage=0 );
+
+    IplImage* CreateGroundPlaneMask();
 
     const std::string& GetName() const { return m_name; }
     const std::string& GetTrackViewName() const { return m_trackView; }
@@ -128,6 +153,15 @@ public:
     }
 
 private:
+    void UnwarpFrame( bool full, double timestampInMillisecs );
+    void UnwarpForLossRecovery( bool prevUnwarpFull );
+    void AccumulateKltStats();
+    void UpdateCoverage( CoverageSystem& coverage );
+
+    bool ReadyLiveFrame( double excessLatencyBudgetMs );
+    double ReadyLiveFrameAge();
+    double LiveFrameExcessLatency() const;
+
     int                   m_id;
 
     double                m_fps;
@@ -140,6 +174,8 @@ private:
     VideoSequence*        m_sequencer;
     IplImage*             m_imgFrame;
     IplImage*             m_imgGrey;
+    IplImage*             m_imgGreyPrev;    // grey frame behind a partly unwarped previous image
+    bool                  m_greyFrames;     // retrieve frames straight into m_imgGrey
     IplImage*             m_thumbnail;
 
     RobotMetrics*         m_metrics;
@@ -150,6 +186,44 @@ private:
     IplImage*             m_imgWarp[2];
     IplImage*             m_imgWarp_[2];
 
+    // While tracking only a padded box around the target is unwarped;
+    // frames that are displayed are always unwarped in full.
+    bool                  m_roiUnwarp;
+    bool                  m_lastUnwarpFull;
+
+    // The most recent frame has not been sent to the display yet.
+    bool                  m_displayPending;
+    bool                  m_lastTracking;
+
+    static const int          m_roiUnwarpPadRadii = 4;   // half-size of box (robot radii)
+
+    GroundTruthUI::TrackOverlay m_trackOverlay;
+
+    // Tracker history entries swept into the live coverage so far. Once
+    // stale (rewind, manual reposition) the coverage is rebuilt.
+    size_t                m_numCovered;
+    bool                  m_coverageStale;
+
+    // Live sequences: frames are timed against the wall clock. The
+    // smallest (arrival - frame time) seen is taken as zero excess latency.
+    QTime                 m_liveClock;
+    bool                  m_liveOffsetValid;
+    double                m_liveOffsetMs;
+    double                m_liveFrameTimeMs;  // frame time of the ready frame
+    unsigned int          m_liveFrames;
+    double                m_excessLatencySumMs; // since TakeLiveStats
+    unsigned int          m_excessLatencyCount;
+    unsigned int          m_framesDropped;    // in total
+
+    // KltTracker::FrameStats summed over the frames tracked since TakeKltStats.
+    unsigned int          m_kltFrames;
+    unsigned int          m_kltPredicted;
+    double                m_kltWindowSumPx;
+    double                m_kltResidualSumPx;
+    unsigned int          m_kltResidualCount;
+
+    static const unsigned int m_maxFramesToDrop = 100; // per ready frame
+
     std::string           m_name;
 
 	std::string           m_trackView;
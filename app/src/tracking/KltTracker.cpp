@@ -20,6 +20,7 @@
 #include "CameraCalibration.h"
 #include "RobotMetrics.h"
 #include "CrossCorrelation.h"
+#include "TargetHeading.h"
 
 #include "OpenCvUtility.h"
 
@@ -32,6 +33,12 @@
 #include <opencv/cxcore.h>
 #include <opencv/highgui.h>
 
+#include <algorithm>
+
+const double KltTracker::m_maxPredictionGapMs = 500.0;
+const float KltTracker::m_confidentPredictionRadius = .1f;
+const float KltTracker::m_confidentWindowRadius = .5f;
+
 /**
  This tracker must be constructed by passing in camera calibration information
  and robot metrics.
@@ -58,17 +65,33 @@ KltTracker::KltTracker( const CameraCalibration* cal,
     m_weightImg     ( 0 ),
     m_targetImg     ( 0 ),
     m_appearanceImg ( 0 ),
+    m_appearancePyr ( 0 ),
+    m_appearanceBank(),
+    m_appearancePatch( 0 ),
+    m_appearanceRoi ( cvRect( 0, 0, 0, 0 ) ),
+    m_appearanceAltRoi( cvRect( 0, 0, 0, 0 ) ),
     m_avgFloat      ( 0 ),
     m_avg           ( 0 ),
     m_diff          ( 0 ),
     m_filtered      ( 0 ),
+    m_relocaliser   (),
+    m_nccWeights    (),
+    m_motionPrediction( false ),
+    m_predictionError( -1.f ),
     m_history       (),
     m_cal           ( cal ),
     m_metrics       ( metrics )
 {
     //assert(cal && metrics );
+    m_frameStats.predicted = false;
+    m_frameStats.windowSize = 0;
+    m_frameStats.seedResidual = -1.f;
+
     CreateWeightImage();
 
+    const int r = (int)m_metrics->GetRadiusPx();
+    CrossCorrelation::CreateRadialWeights( 2 * r, 2 * r, 1, m_nccWeights );
+
     LOG_INFO(QObject::tr("Bi-level threshold: %1.").arg(m_thresh1));
 
     SetCurrentImage( currentImage );
@@ -78,8 +101,10 @@ KltTracker::~KltTracker()
 {
     ReleasePyramids();
     ReleaseWeightImage();
+    ReleaseAppearanceBank();
     cvReleaseImage( &m_targetImg );
     cvReleaseImage( &m_appearanceImg );
+    cvReleaseImage( &m_appearancePyr );
 
     cvReleaseImage( &m_avgFloat );
     cvReleaseImage( &m_avg );
@@ -176,29 +201,39 @@ void KltTracker::ReleaseWeightImage()
 
 /**
  Creates an image of a radial weighting function,
- given by expf( -powf(r/(m_radius-1.f),12) ).
+ given by expf( -powf(r/radiusPx,12) ).
  This allows us to do a 'soft cut-out' of the
- circular robot target.
+ circular robot target. The caller owns the returned matrix.
  **/
-void KltTracker::CreateWeightImage()
+CvMat* KltTracker::CreateWeightImage( float radiusPx )
 {
-    ReleaseWeightImage();
-    int radius = (int)(2.f * (m_metrics->GetRadiusPx() + .5f));
-    m_weightImg = cvCreateMat( radius, radius, CV_32FC1 );
+    int size = (int)(2.f * (radiusPx + .5f));
+    CvMat* weightImg = cvCreateMat( size, size, CV_32FC1 );
 
-    float cx = m_weightImg->width / 2.f;
-    float cy = m_weightImg->height / 2.f;
-    for ( int i = 0; i < m_weightImg->width; ++i )
+    float cx = weightImg->width / 2.f;
+    float cy = weightImg->height / 2.f;
+    for ( int i = 0; i < weightImg->width; ++i )
     {
-        for ( int j = 0; j < m_weightImg->height; ++j )
+        for ( int j = 0; j < weightImg->height; ++j )
         {
             float x = i - cx;
             float y = j - cy;
             float r = sqrtf( x * x + y * y );
-            float w = expf( -powf( r / (m_metrics->GetRadiusPx()), 12 ) );
-            cvmSet( m_weightImg, i, j, w );
+            float w = expf( -powf( r / radiusPx, 12 ) );
+            cvmSet( weightImg, i, j, w );
         }
     }
+
+    return weightImg;
+}
+
+/**
+ Creates the weighting image for the robot target radius.
+ **/
+void KltTracker::CreateWeightImage()
+{
+    ReleaseWeightImage();
+    m_weightImg = CreateWeightImage( m_metrics->GetRadiusPx() );
 }
 
 void KltTracker::Activate()
@@ -210,7 +245,7 @@ void KltTracker::Activate()
 
     if (!m_appearanceImg)
     {
-        m_appearanceImg = cvCloneImage( m_currImg );
+        AllocateAppearanceImage();
     }
 
     AllocatePyramids();
@@ -249,7 +284,8 @@ bool KltTracker::Track( double timestampInMillisecs, bool flipCorrect, bool init
     AllocatePyramids();
     SwapPyramids();
 
-    int r = (int)(.9f * m_metrics->GetRadiusPx());
+    const float radius = m_metrics->GetRadiusPx();
+    int r = (int)(.9f * radius);
 
     int kltFlags = 0;
     if ( !init )
@@ -257,6 +293,23 @@ bool KltTracker::Track( double timestampInMillisecs, bool flipCorrect, bool init
         kltFlags = CV_LKFLOW_PYR_A_READY; // prev should be ready because TrackStage2 gets called in Activate().
     }
 
+    // Optionally start the KLT from where the motion model expects the
+    // target to be, with a smaller window if recent predictions were good.
+    newPos = m_pos;
+    bool seeded = m_motionPrediction && PredictPosition( timestampInMillisecs, newPos );
+
+    if ( seeded )
+    {
+        kltFlags |= CV_LKFLOW_INITIAL_GUESSES;
+
+        if ( m_predictionError >= 0.f && m_predictionError < m_confidentPredictionRadius * radius )
+        {
+            r = std::max( 3, (int)(m_confidentWindowRadius * radius) );
+        }
+    }
+
+    const CvPoint2D32f seed = newPos;
+
     cvCalcOpticalFlowPyrLK( m_prevImg,
                             m_currImg,
                             m_prevPyr,
@@ -271,6 +324,49 @@ bool KltTracker::Track( double timestampInMillisecs, bool flipCorrect, bool init
                             cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
                             kltFlags );
 
+    if ( seeded && !found )
+    {
+        // Bad prediction: fall back to the unseeded track (both pyramids are built now).
+        r = (int)(.9f * radius);
+        newPos = m_pos;
+
+        cvCalcOpticalFlowPyrLK( m_prevImg,
+                                m_currImg,
+                                m_prevPyr,
+                                m_currPyr,
+                                &m_pos,
+                                &newPos,
+                                1,
+                                cvSize( r, r ),
+                                1,
+                                &found,
+                                &m_error,
+                                cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
+                                CV_LKFLOW_PYR_A_READY | CV_LKFLOW_PYR_B_READY );
+
+        seeded = false;
+        m_predictionError = -1.f;
+    }
+
+    m_frameStats.predicted = seeded;
+    m_frameStats.windowSize = r;
+    m_frameStats.seedResidual = -1.f;
+    if ( found )
+    {
+        const CvPoint2D32f start = seeded ? seed : m_pos;
+        m_frameStats.seedResidual = sqrtf( ( newPos.x - start.x ) * ( newPos.x - start.x ) +
+                                           ( newPos.y - start.y ) * ( newPos.y - start.y ) );
+    }
+
+    if ( seeded )
+    {
+        m_predictionError = m_frameStats.seedResidual;
+    }
+
+    LOG_TRACE(QObject::tr("KLT %1: window %2, seed residual %3.").arg(m_frameStats.predicted ? "predicted" : "unseeded")
+                                                                  .arg(m_frameStats.windowSize)
+                                                                  .arg(m_frameStats.seedResidual));
+
     if ( found && TrackStage2( newPos, flipCorrect, false ) )
     {
         float ncc = GetError();
@@ -327,6 +423,60 @@ bool KltTracker::Track( double timestampInMillisecs, bool flipCorrect, bool init
     return false;
 }
 
+/**
+ Predict where the target will be at timestampInMillisecs by extrapolating
+ the last two history entries, assuming constant speed and turn rate.
+
+ @return false (and leaves prediction unchanged) unless the history ends
+ with a recent, continuous track of the current position.
+ **/
+bool KltTracker::PredictPosition( double timestampInMillisecs, CvPoint2D32f& prediction ) const
+{
+    if ( m_history.size() < 2 || !m_currImg )
+    {
+        return false;
+    }
+
+    const TrackEntry& last = m_history[m_history.size() - 1];
+    const TrackEntry& prev = m_history[m_history.size() - 2];
+
+    const double dt = last.GetTimeStamp() - prev.GetTimeStamp();
+    const double ahead = timestampInMillisecs - last.GetTimeStamp();
+
+    const CvPoint2D32f lastPos = last.GetPosition();
+
+    // Relocalised or rewound since the last entry, or a gap in the track.
+    if ( lastPos.x != m_pos.x || lastPos.y != m_pos.y ||
+         dt <= 0.0 || dt > m_maxPredictionGapMs ||
+         ahead <= 0.0 || ahead > m_maxPredictionGapMs )
+    {
+        return false;
+    }
+
+    const CvPoint2D32f prevPos = prev.GetPosition();
+    const double vx = ( lastPos.x - prevPos.x ) / dt;
+    const double vy = ( lastPos.y - prevPos.y ) / dt;
+
+    // Turn the velocity by the heading change over half the step (i.e. move
+    // along the chord of the arc). Ignore implausible turns such as a heading flip.
+    // Headings increase anticlockwise as seen, but image y points down (see
+    // GetBrushBarLeft), hence the negative rotation.
+    double turn = Angles::DiffAngle( last.GetOrientation(), prev.GetOrientation() ) / dt;
+    if ( fabs( turn * dt ) > MathsConstants::F_PI / 4.f )
+    {
+        turn = 0.0;
+    }
+
+    const double a = -.5 * turn * ahead;
+    const double dx = ( vx * cos( a ) - vy * sin( a ) ) * ahead;
+    const double dy = ( vx * sin( a ) + vy * cos( a ) ) * ahead;
+
+    prediction.x = (float)std::min( std::max( lastPos.x + dx, 0.0 ), (double)( m_currImg->width - 1 ) );
+    prediction.y = (float)std::min( std::max( lastPos.y + dy, 0.0 ), (double)( m_currImg->height - 1 ) );
+
+    return true;
+}
+
 void KltTracker::Rewind( double timeStamp )
 {
     while (!m_history.empty())
@@ -347,6 +497,58 @@ void KltTracker::Rewind( double timeStamp )
     }
 }
 
+/**
+ Decide where the opposite-heading appearance can be placed so that both
+ hypotheses can be tracked by a single two-point KLT call with exactly the
+ same result as tracking them one at a time.
+
+ Each hypothesis only sees the appearance image within its KLT window at
+ pyramid level 1 (plus gradient/interpolation support and the pyrDown
+ kernel), so the two patches must be further apart than that and both
+ neighbourhoods must lie inside the image (so border handling is identical).
+ The shift is even so level 1 is an exact translated copy, and negative so
+ that m_pos + shift is exact in floating point.
+
+ @param windowRadius The KLT window radius in pixels.
+ @param shift Set to the offset of the second hypothesis on success.
+ @return false if both hypotheses do not fit (use two KLT calls instead).
+ **/
+bool KltTracker::ChooseHypothesisShift( int windowRadius, CvPoint& shift ) const
+{
+    if ( !m_appearanceImg || !m_appearancePyr || !m_appearancePatch )
+    {
+        return false;
+    }
+
+    const int reach = 2 * ( windowRadius + 3 ) + 2;
+    int separation = m_appearancePatch->width / 2 + reach + 4;
+    separation += separation & 1;
+
+    const float w = (float)m_appearanceImg->width;
+    const float h = (float)m_appearanceImg->height;
+
+    const bool interior = ( m_pos.x - reach >= 0.f ) && ( m_pos.x + reach + 1 < w ) &&
+                          ( m_pos.y - reach >= 0.f ) && ( m_pos.y + reach + 1 < h );
+    if ( !interior )
+    {
+        return false;
+    }
+
+    if ( m_pos.x - separation - reach >= 0.f )
+    {
+        shift = cvPoint( -separation, 0 );
+        return true;
+    }
+
+    if ( m_pos.y - separation - reach >= 0.f )
+    {
+        shift = cvPoint( 0, -separation );
+        return true;
+    }
+
+    return false;
+}
+
 /**
  Uses result of successful frame to frame KLT-track to predict appearance template and
  use it to refine the tracking. We use the tracking result of the first stage (newPos)
@@ -361,9 +563,6 @@ bool KltTracker::TrackStage2( CvPoint2D32f newPos, bool flipCorrect, bool init )
     float oldAngle = m_angle;
     float newAngle = ComputeHeading( m_pos );
 
-    // Use heading to predict appearance
-    PredictTargetAppearance( newAngle, 0 );
-
     float error1;
     float error2;
     CvPoint2D32f newPos2 = newPos;
@@ -377,47 +576,95 @@ bool KltTracker::TrackStage2( CvPoint2D32f newPos, bool flipCorrect, bool init )
         kltFlags += CV_LKFLOW_PYR_B_READY;
     }
 
-    cvCalcOpticalFlowPyrLK( m_appearanceImg,
-                            m_currImg,
-                            0,
-                            m_currPyr,
-                            &m_pos,
-                            &newPos,
-                            1,
-                            cvSize( r, r ),
-                            1,
-                            &found1,
-                            &error1,
-                            cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
-                            kltFlags );
-
-    // Compute tracker error using normalised-cross-correlation
-    // of appearance image (at robots old position which is where the appearance was generated)
-    // with current image
-    float ncc1 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, m_pos.x, m_pos.y, newPos.x, newPos.y, 2 * r, 2 * r );
-
-    //cvSaveImage( "appearance1.png", m_appearanceImg );
+    float ncc1;
+    float ncc2;
 
-    // Predict again with opposite orientation so we can disambiguate heading
-    PredictTargetAppearance( newAngle, 180 );
-    cvCalcOpticalFlowPyrLK( m_appearanceImg,
-                            m_currImg,
-                            0,
-                            m_currPyr,
-                            &m_pos,
-                            &newPos2,
-                            1,
-                            cvSize( r, r ),
-                            1,
-                            &found2,
-                            &error2,
-                            cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
-                            kltFlags );
-
-    //cvSaveImage( "appearance2.png", m_appearanceImg );
-
-    // Compute tracker error using normalised-cross-correlation
-    float ncc2 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, m_pos.x, m_pos.y, newPos2.x, newPos2.y, 2 * r, 2 * r );
+    CvPoint shift;
+    if ( ChooseHypothesisShift( r, shift ) )
+    {
+        // Both orientation hypotheses go into one appearance image (the opposite
+        // one shifted well clear of the first) so that a single KLT call with
+        // two points tracks both against one appearance pyramid.
+        PredictOpposingAppearances( newAngle, shift );
+
+        CvPoint2D32f prevPts[2] = { m_pos, cvPoint2D32f( m_pos.x + shift.x, m_pos.y + shift.y ) };
+        CvPoint2D32f nextPts[2] = { newPos, newPos2 };
+        char found[2] = { 0, 0 };
+        float errors[2];
+
+        cvCalcOpticalFlowPyrLK( m_appearanceImg,
+                                m_currImg,
+                                m_appearancePyr,
+                                m_currPyr,
+                                prevPts,
+                                nextPts,
+                                2,
+                                cvSize( r, r ),
+                                1,
+                                found,
+                                errors,
+                                cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
+                                kltFlags );
+
+        newPos = nextPts[0];
+        newPos2 = nextPts[1];
+        found1 = found[0];
+        found2 = found[1];
+        error1 = errors[0];
+        error2 = errors[1];
+
+        // Compute tracker error using normalised-cross-correlation
+        // of appearance image (where each appearance was generated) with current image
+        ncc1 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, prevPts[0].x, prevPts[0].y, newPos.x, newPos.y, m_nccWeights );
+        ncc2 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, prevPts[1].x, prevPts[1].y, newPos2.x, newPos2.y, m_nccWeights );
+    }
+    else
+    {
+        // Too close to the image border to fit both hypotheses side by side.
+        // Use heading to predict appearance
+        PredictTargetAppearance( newAngle, 0 );
+
+        cvCalcOpticalFlowPyrLK( m_appearanceImg,
+                                m_currImg,
+                                m_appearancePyr,
+                                m_currPyr,
+                                &m_pos,
+                                &newPos,
+                                1,
+                                cvSize( r, r ),
+                                1,
+                                &found1,
+                                &error1,
+                                cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
+                                kltFlags );
+
+        // Compute tracker error using normalised-cross-correlation
+        // of appearance image (at robots old position which is where the appearance was generated)
+        // with current image
+        ncc1 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, m_pos.x, m_pos.y, newPos.x, newPos.y, m_nccWeights );
+
+        // The first call has built the current image pyramid if it wasn't already.
+        kltFlags |= CV_LKFLOW_PYR_B_READY;
+
+        // Predict again with opposite orientation so we can disambiguate heading
+        PredictTargetAppearance( newAngle, 180 );
+        cvCalcOpticalFlowPyrLK( m_appearanceImg,
+                                m_currImg,
+                                m_appearancePyr,
+                                m_currPyr,
+                                &m_pos,
+                                &newPos2,
+                                1,
+                                cvSize( r, r ),
+                                1,
+                                &found2,
+                                &error2,
+                                cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ),
+                                kltFlags );
+
+        // Compute tracker error using normalised-cross-correlation
+        ncc2 = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, m_pos.x, m_pos.y, newPos2.x, newPos2.y, m_nccWeights );
+    }
 
     int appearanceModelChosen = 0;
     if (found1)
@@ -480,111 +727,12 @@ bool KltTracker::TrackStage2( CvPoint2D32f newPos, bool flipCorrect, bool init )
  **/
 float KltTracker::ComputeHeading( CvPoint2D32f pos ) const
 {
-    if ( !m_currImg )
-    {
-        return m_angle;
-    }
-
-    float radius = m_metrics->GetRadiusPx();
-    CvRect roi = cvRect( (int)(pos.x - radius),
-                         (int)(pos.y - radius),
-                         (int)(radius * 2),
-                         (int)(radius * 2) );
-
-    // Check we will be within bounds.
-    if ( roi.x < 0 || roi.x > m_currImg->width - radius ||
-         roi.y < 0 || roi.y > m_currImg->height - radius )
-    {
-        return m_angle;
-    }
-
-    // Copy region of interest around tracked position
-    IplImage* tmpImg = cvCloneImage( m_currImg );
-    cvSetImageROI( tmpImg, roi );
-
-    IplImage* img = cvCreateImage( cvSize( tmpImg->roi->width,
-                                           tmpImg->roi->height ), IPL_DEPTH_8U, 1 );
-    cvCopyImage( tmpImg, img );
-    cvReleaseImage( &tmpImg );
-
-    float mx = 0.f; // mean x coord
-    float my = 0.f; // mean y coord
-    float sum = 0.f; // sum of weights
-    for ( int i = 0; i < img->height; ++i )
-    {
-        for ( int j = 0; j < img->width; ++j )
-        {
-            float w = (float)cvmGet( m_weightImg, i, j );
-            CvScalar v = cvGet2D( img, i, j );
-
-            float val = (float)(v.val[0] * w); // Remove background with soft cut-out
-            val = (255 * w) - val; // Invert
-
-            if ( val > m_thresh1 ) // Threshold
-            {
-                w = expf( -powf( ((val - 255.f) / (50.f)), 2 ) );
-                mx += i * w;
-                my += j * w;
-                sum += w;
-            }
-            else
-            {
-                val = 0;
-            }
-
-            cvSet2D( img, i, j, cvScalar( val ) );
-        }
-    }
-
-    float invSum = 1.f / sum;
-    mx *= invSum;
-    my *= invSum;
-
-    // Compute weighted covariance
-    float cov[4];
-    CvMat C = cvMat( 2, 2, CV_32F, cov );
-    cvSetZero( &C );
-    sum = 0.f;
-    for ( int i = 0; i < img->height; ++i )
-    {
-        for ( int j = 0; j < img->width; ++j )
-        {
-            //float w    = cvmGet(m_weightImg,i,j);
-            CvScalar v = cvGet2D( img, i, j );
-            int val = (int)(v.val[0]);
-            if ( val > m_thresh1 )
-            {
-                float vx = i - mx;
-                float vy = j - my;
-                float w = expf( -powf( ((val - 255.f) / (50.f)), 2 ) );
-                cov[0] += w * vx * vx;
-                cov[1] += w * vx * vy;
-                cov[3] += w * vy * vy;
-                sum += w;
-            }
-        }
-    }
-    invSum = 1.f / sum;
-    cov[0] *= invSum;
-    cov[1] *= invSum;
-    cov[2] = cov[1];
-    cov[3] *= invSum;
-
-    // Compute principle components (eigen values/vectors using SVD)
-    float w[4];
-    float u[4];
-    CvMat W = cvMat( 2, 2, CV_32F, w );
-    CvMat U = cvMat( 2, 2, CV_32F, u );
-    cvSVD( &C, &W, &U, 0, CV_SVD_MODIFY_A );
-
-    // Store heading angle
-    float angle = (float)(atan2( u[0], u[2] ) + (.25f * MathsConstants::F_PI));
-    angle = (MathsConstants::F_PI / 2.0f) - angle;
-
-    cvResetImageROI( img );
-    cvReleaseImage( &img );
-
-    return angle;
+    return TargetHeading::Estimate( m_currImg,
+                                    pos,
+                                    m_metrics->GetRadiusPx(),
+                                    m_weightImg,
+                                    m_thresh1,
+                                    m_angle );
 }
 
 /**
@@ -606,6 +754,8 @@ bool KltTracker::LoadTargetImage( const char* targetFilename )
 
     if ( img )
     {
+        cvReleaseImage( &m_targetImg );
+
         LOG_INFO(QObject::tr("Opened target image: %1.")
                     .arg(targetFilename));
 
@@ -634,6 +784,8 @@ bool KltTracker::LoadTargetImage( const char* targetFilename )
             }
         }
 
+        BuildAppearanceBank();
+
         return true;
     }
     else
@@ -645,6 +797,125 @@ bool KltTracker::LoadTargetImage( const char* targetFilename )
     }
 }
 
+/**
+ Pre-computes the appearance of the target at m_appearanceBankSize evenly
+ spaced orientations. Each entry is the rotated m_targetImg on a
+ m_targetBackGroundGreyLevel background, smoothed exactly as the full
+ appearance image used to be, so per-frame prediction only has to look up
+ a patch and place it (cost depends on target size, not frame size).
+ The smoothed patch is then faded into the background with the m_weightImg
+ soft cut-out, so nothing outside the robot's radius is matched.
+ **/
+void KltTracker::BuildAppearanceBank()
+{
+    assert( m_appearanceSmoothing % 2 ); // smoothing parameter must be odd
+    assert( m_metrics && m_weightImg );
+
+    ReleaseAppearanceBank();
+
+    if ( !m_targetImg )
+        return;
+
+    // Patch must hold the rotated target (its diagonal) plus
+    // a margin for interpolation, smoothing and sub-pixel shifts.
+    const float diagonal = sqrtf( (float)( m_targetImg->width * m_targetImg->width +
+                                           m_targetImg->height * m_targetImg->height ) );
+    const int size = (int)ceilf( diagonal ) + 2 * ( m_appearanceSmoothing + 1 );
+    const float patchCentre = size / 2.f;
+
+    CvPoint2D32f centre = cvPoint2D32f( m_targetImg->width / 2.f, m_targetImg->height / 2.f );
+
+    m_appearanceBank.reserve( m_appearanceBankSize );
+
+    for ( int k = 0; k < m_appearanceBankSize; ++k )
+    {
+        IplImage* patch = cvCreateImage( cvSize( size, size ), IPL_DEPTH_8U, 1 );
+        cvSet( patch, cvScalar( m_targetBackGroundGreyLevel ) );
+
+        const float angle = k * ( 360.f / m_appearanceBankSize );
+
+        float R[6];
+        CvMat rot = cvMat( 2, 3, CV_32F, R );
+        cv2DRotationMatrix( centre, angle, 1, &rot );
+        R[2] += patchCentre - m_targetImg->width / 2.f;
+        R[5] += patchCentre - m_targetImg->height / 2.f;
+        cvWarpAffine( m_targetImg, patch, &rot, CV_INTER_LINEAR );
+
+        cvSmooth( patch, patch, CV_GAUSSIAN, m_appearanceSmoothing );
+
+        ApplyRadialMask( patch );
+
+        m_appearanceBank.push_back( patch );
+    }
+
+    cvReleaseImage( &m_appearancePatch );
+    m_appearancePatch = cvCreateImage( cvSize( size, size ), IPL_DEPTH_8U, 1 );
+
+    m_relocaliser.SetTarget( m_appearanceBank, m_targetImg->width, m_metrics->GetRadiusPx() );
+}
+
+/**
+ Blend a patch centred on the target into the m_targetBackGroundGreyLevel
+ background using the radial weights in m_weightImg. Pixels beyond the
+ weight image are set to the background.
+ **/
+void KltTracker::ApplyRadialMask( IplImage* patch ) const
+{
+    const int ox = ( patch->width - m_weightImg->width ) / 2;
+    const int oy = ( patch->height - m_weightImg->height ) / 2;
+
+    for ( int y = 0; y < patch->height; ++y )
+    {
+        unsigned char* pPatch = (unsigned char*)( patch->imageData + y * patch->widthStep );
+
+        for ( int x = 0; x < patch->width; ++x )
+        {
+            const int wx = x - ox;
+            const int wy = y - oy;
+
+            float w = 0.f;
+
+            if ( wx >= 0 && wx < m_weightImg->width && wy >= 0 && wy < m_weightImg->height )
+            {
+                w = CV_MAT_ELEM( *m_weightImg, float, wy, wx );
+            }
+
+            pPatch[x] = (unsigned char)( w * pPatch[x] + ( 1.f - w ) * m_targetBackGroundGreyLevel + .5f );
+        }
+    }
+}
+
+/**
+ Free the pre-rotated appearance patches.
+ **/
+void KltTracker::ReleaseAppearanceBank()
+{
+    for ( size_t k = 0; k < m_appearanceBank.size(); ++k )
+    {
+        cvReleaseImage( &m_appearanceBank[k] );
+    }
+
+    m_appearanceBank.clear();
+
+    cvReleaseImage( &m_appearancePatch );
+}
+
+/**
+ Allocate the appearance image (same size as the tracking image)
+ and fill it with the background grey-level. Only the region
+ around the predicted target is rewritten after this.
+ **/
+void KltTracker::AllocateAppearanceImage()
+{
+    m_appearanceImg = cvCreateImage( cvSize( m_currImg->width, m_currImg->height ), IPL_DEPTH_8U, 1 );
+    cvSet( m_appearanceImg, cvScalar( m_targetBackGroundGreyLevel ) );
+    m_appearanceRoi = cvRect( 0, 0, 0, 0 );
+    m_appearanceAltRoi = cvRect( 0, 0, 0, 0 );
+
+    cvReleaseImage( &m_appearancePyr );
+    m_appearancePyr = cvCreateImage( cvSize( m_currImg->width, m_currImg->height ), IPL_DEPTH_8U, 1 );
+}
+
 /**
  Predicts the appearance of the target using computed heading.
 
@@ -656,55 +927,117 @@ bool KltTracker::LoadTargetImage( const char* targetFilename )
  **/
 void KltTracker::PredictTargetAppearance( float angleInRadians, float offsetAngleDegrees )
 {
-    if ( !m_targetImg )
-        return;
+    PredictTargetAppearance2( angleInRadians, offsetAngleDegrees, m_pos.x, m_pos.y );
+}
 
-    float angle = (float)((180 + MathsConstants::R2D * angleInRadians) + offsetAngleDegrees);
 
-    int smoothing = 5;
-    assert( smoothing % 2 ); // smoothing parameter must be odd
+/**
+ Predicts the appearance of the target using computed heading, using
+ an extra parameter for specifying the position
 
-    // Set the background 'color' that will be used for pixels in the
-    // appearance model outside the radius of the target.
-    cvSet( m_appearanceImg, cvScalar( m_targetBackGroundGreyLevel ) );
+ The nearest pre-rotated patch is taken from the appearance bank and
+ written (with sub-pixel offset) into m_appearanceImg centred on x,y.
+ The patches written by previous calls are reset to the background first.
+ **/
+void KltTracker::PredictTargetAppearance2( float angleInRadians, float offsetAngleDegrees, float x, float y )
+{
+    if ( !m_targetImg || m_appearanceBank.empty() )
+        return;
 
-    float R[6];
-    CvMat rot = cvMat( 2, 3, CV_32F, R );
-    CvPoint2D32f centre = cvPoint2D32f( m_targetImg->width / 2.f, m_targetImg->height / 2.f );
-    cv2DRotationMatrix( centre, angle, 1, &rot );
-    R[2] += m_pos.x - m_targetImg->width / 2.f;
-    R[5] += m_pos.y - m_targetImg->height / 2.f;
-    cvWarpAffine( m_targetImg, m_appearanceImg, &rot, CV_INTER_LINEAR );
+    ClearAppearance( m_appearanceRoi );
+    ClearAppearance( m_appearanceAltRoi );
 
-    cvSmooth( m_appearanceImg, m_appearanceImg, CV_GAUSSIAN, smoothing );
+    WriteAppearancePatch( angleInRadians, offsetAngleDegrees, x, y, cvPoint( 0, 0 ), m_appearanceRoi );
 }
 
-
 /**
- Predicts the appearance of the target using computed heading, using
- an extra parameter for specifying the position
+ Predicts both orientation hypotheses at once: the appearance for the
+ computed heading is written centred on m_pos as usual, and the appearance
+ for the opposite heading is written centred on m_pos + shift.
 
+ The shift is a whole (even) number of pixels and the sub-pixel patch is
+ rendered from m_pos, so the second patch is an exact translated copy of
+ what PredictTargetAppearance( angle, 180 ) would have produced.
  **/
-void KltTracker::PredictTargetAppearance2( float angleInRadians, float offsetAngleDegrees, float x, float y )
+void KltTracker::PredictOpposingAppearances( float angleInRadians, CvPoint shift )
 {
-    if ( !m_targetImg )
+    PredictTargetAppearance2( angleInRadians, 0, m_pos.x, m_pos.y );
+
+    if ( !m_targetImg || m_appearanceBank.empty() )
         return;
 
-    float angle = (float)((180 + MathsConstants::R2D * angleInRadians) + offsetAngleDegrees);
-    int smoothing = 5;
+    WriteAppearancePatch( angleInRadians, 180, m_pos.x, m_pos.y, shift, m_appearanceAltRoi );
+}
+
+/**
+ Reset a region of the appearance image to the background grey-level.
+ **/
+void KltTracker::ClearAppearance( CvRect& roi )
+{
     // Set the background 'color' that will be used for pixels in the
     // appearance model outside the radius of the target.
-    cvSet( m_appearanceImg, cvScalar( m_targetBackGroundGreyLevel ) );
+    if ( roi.width > 0 && roi.height > 0 )
+    {
+        cvSetImageROI( m_appearanceImg, roi );
+        cvSet( m_appearanceImg, cvScalar( m_targetBackGroundGreyLevel ) );
+        cvResetImageROI( m_appearanceImg );
+    }
 
-    float R[6];
-    CvMat rot = cvMat( 2, 3, CV_32F, R );
-    CvPoint2D32f centre = cvPoint2D32f( m_targetImg->width / 2.f, m_targetImg->height / 2.f );
-    cv2DRotationMatrix( centre, angle, 1, &rot );
-    R[2] += x - m_targetImg->width / 2.f;
-    R[5] += y - m_targetImg->height / 2.f;
-    cvWarpAffine( m_targetImg, m_appearanceImg, &rot, CV_INTER_LINEAR );
+    roi = cvRect( 0, 0, 0, 0 );
+}
+
+/**
+ Write the bank patch nearest to the given heading into m_appearanceImg
+ centred on (x,y) + shift, and record the region written in roi.
+ **/
+void KltTracker::WriteAppearancePatch( float angleInRadians,
+                                       float offsetAngleDegrees,
+                                       float x,
+                                       float y,
+                                       CvPoint shift,
+                                       CvRect& roi )
+{
+    float angle = (float)((180 + MathsConstants::R2D * angleInRadians) + offsetAngleDegrees);
+
+    const float step = 360.f / m_appearanceBankSize;
+    int index = (int)floorf( angle / step + .5f ) % m_appearanceBankSize;
+    if ( index < 0 )
+    {
+        index += m_appearanceBankSize;
+    }
 
-    cvSmooth( m_appearanceImg, m_appearanceImg, CV_GAUSSIAN, smoothing );
+    const IplImage* bankPatch = m_appearanceBank[index];
+    const int size = bankPatch->width;
+
+    // Shift the bank patch so the target centre lands on (x,y).
+    const int ox = (int)floorf( x ) - size / 2;
+    const int oy = (int)floorf( y ) - size / 2;
+    const float half = ( size - 1 ) * .5f;
+    cvGetRectSubPix( bankPatch,
+                     m_appearancePatch,
+                     cvPoint2D32f( size / 2.f + ( ox - x ) + half,
+                                   size / 2.f + ( oy - y ) + half ) );
+
+    // Clip to the image and copy across.
+    const int sx = ox + shift.x;
+    const int sy = oy + shift.y;
+    const int x0 = std::max( sx, 0 );
+    const int y0 = std::max( sy, 0 );
+    const int x1 = std::min( sx + size, m_appearanceImg->width );
+    const int y1 = std::min( sy + size, m_appearanceImg->height );
+
+    roi = cvRect( 0, 0, 0, 0 );
+
+    if ( x1 > x0 && y1 > y0 )
+    {
+        roi = cvRect( x0, y0, x1 - x0, y1 - y0 );
+
+        cvSetImageROI( m_appearancePatch, cvRect( x0 - sx, y0 - sy, x1 - x0, y1 - y0 ) );
+        cvSetImageROI( m_appearanceImg, roi );
+        cvCopy( m_appearancePatch, m_appearanceImg );
+        cvResetImageROI( m_appearanceImg );
+        cvResetImageROI( m_appearancePatch );
+    }
 }
 
 /**
@@ -771,9 +1104,12 @@ void KltTracker::LossRecovery()
 }
 
 /**
- Perform a brute force search for the robot-localisation target
- in the image. If the optional mask is specified then only pixels
- where the mask is non-zero will be searched by the algorithm.
+ Search for the robot-localisation target in the image.
+
+ The relocaliser first finds a few candidate positions by matching a
+ downscaled, rotation-averaged target where the mask is non-zero. Only
+ the neighbourhood of each candidate (one coarse pixel in each direction)
+ is then searched with the heading-aware normalised cross correlation.
  **/
 void KltTracker::TargetSearch( const IplImage* mask )
 {
@@ -782,11 +1118,6 @@ void KltTracker::TargetSearch( const IplImage* mask )
     int w = mask->width;
     int h = mask->height;
 
-    IplImage* ncc = cvCreateImage( cvSize( w, h ), IPL_DEPTH_32F, 1 );
-    cvZero( ncc );
-    int fStep = ncc->widthStep / sizeof(float);
-    int iStep = mask->widthStep;
-
     float maxVal = -1.f;
     CvPoint2D32f maxPos;
   
@@ -796,37 +1127,38 @@ void KltTracker::TargetSearch( const IplImage* mask )
     float y_lost = std::min( std::max(float(ws/2), m_pos.y) , float(m_appearanceImg->height-ws/2));
     
     PredictTargetAppearance2(0,0,x_lost, y_lost);
-    for ( int j = r; j < h - r; j = j+2 )
+
+    const std::vector<CvPoint>& candidates = m_relocaliser.FindCandidates( m_currImg, mask );
+    const int reach = m_relocaliser.GetScale();
+
+    for ( size_t c = 0; c < candidates.size(); ++c )
     {
-        for ( int i = r; i < w - r; i = i + 2 )
+        const int j0 = std::max( r, candidates[c].y - reach );
+        const int j1 = std::min( h - r - 1, candidates[c].y + reach );
+        const int i0 = std::max( r, candidates[c].x - reach );
+        const int i1 = std::min( w - r - 1, candidates[c].x + reach );
+
+        for ( int j = j0; j <= j1; j = j+2 )
         {
-            char* pMask = mask->imageData;
-            float* pNcc = reinterpret_cast< float* > ( ncc->imageData );
-
-            pMask += j * iStep + i;
-            pNcc += j * fStep + i;
-	    if ( *pMask )
-	    { 
-	      //Compute the heading of the robot for a given candidate position 
-	      // and creates a patch taking into account the orientation
-	      float newAngle = ComputeHeading(cvPoint2D32f( (float)i, (float)j ));
-	      PredictTargetAppearance2(newAngle,0,x_lost, y_lost);
-	      //Compare candidate with target appearance
-	      float val = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, x_lost, y_lost, i, j, ws, ws );
-	      *pNcc = val;
-	      if ( val > maxVal )
-	      {
-		maxVal = val;
-		maxPos.x = i;
-		maxPos.y = j;
-		m_angle = newAngle;
-	       }
-	    }
+            for ( int i = i0; i <= i1; i = i + 2 )
+            {
+                //Compute the heading of the robot for a given candidate position
+                // and creates a patch taking into account the orientation
+                float newAngle = ComputeHeading(cvPoint2D32f( (float)i, (float)j ));
+                PredictTargetAppearance2(newAngle,0,x_lost, y_lost);
+                //Compare candidate with target appearance
+                float val = CrossCorrelation::Ncc2dRadial( m_appearanceImg, m_currImg, x_lost, y_lost, i, j, m_nccWeights );
+                if ( val > maxVal )
+                {
+                    maxVal = val;
+                    maxPos.x = i;
+                    maxPos.y = j;
+                    m_angle = newAngle;
+                }
+            }
         }
     }
 
-    cvReleaseImage( &ncc );
-
     if ( maxVal > 0.7 )
     {
         LOG_INFO(QObject::tr("Relocalised at %1 %2 (score: %3).").arg(maxPos.x)
@@ -872,5 +1204,10 @@ void KltTracker::SetParam( paramType param, float value )
         case PARAM_NCC_THRESHOLD:
             m_nccThresh = value;
             break;
+
+        case PARAM_MOTION_PREDICTION:
+            m_motionPrediction = ( value != 0.f );
+            m_predictionError = -1.f;
+            break;
     }
 }
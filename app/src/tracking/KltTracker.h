@@ -20,6 +20,10 @@
 #define KLTTRACKER_H
 
 #include "RobotTracker.h"
+#include "TargetRelocaliser.h"
+#include "CrossCorrelation.h"
+
+#include <vector>
 
 class CameraCalibration;
 class RobotMetrics;
@@ -38,6 +42,19 @@ class KltTracker: public RobotTracker
 {
 public:
 
+    /**
+     Diagnostics for the frame-to-frame KLT stage of the last call to Track().
+     OpenCV does not report the number of iterations used, so the distance
+     from the seed to the tracked position is given instead: it is the
+     displacement the KLT iterations had to recover.
+     **/
+    struct FrameStats
+    {
+        bool  predicted;    // KLT was seeded from the motion prediction
+        int   windowSize;   // KLT search window (pixels)
+        float seedResidual; // distance from seed to tracked position (pixels), -1 if not found
+    };
+
     KltTracker( const CameraCalibration* cal,
                 const RobotMetrics* metrics,
                 const IplImage* currentImage,
@@ -109,8 +126,23 @@ public:
 
     void Rewind( double timeStamp );
 
+    bool PredictPosition( double timestampInMillisecs, CvPoint2D32f& prediction ) const;
+
+    const FrameStats& GetFrameStats() const
+    {
+        return m_frameStats;
+    }
+
     bool LoadTargetImage( const char* fileName );
 
+    /** Smoothed, radially masked rotations of the target, one per bank step. **/
+    const std::vector<IplImage*>& GetAppearanceBank() const
+    {
+        return m_appearanceBank;
+    }
+
+    static CvMat* CreateWeightImage( float radiusPx );
+
     const CameraCalibration* GetCalibration() const
     {
         return m_cal;
@@ -152,14 +184,36 @@ private:
     CvMat* m_weightImg;
     IplImage* m_targetImg;
     IplImage* m_appearanceImg;
+    IplImage* m_appearancePyr; // pyramid buffer for m_appearanceImg, reused every frame
 
     static const int m_targetBackGroundGreyLevel = 128;
 
+    // Smoothed, radially masked copies of m_targetImg pre-rotated at fixed
+    // angular steps, each on a m_targetBackGroundGreyLevel background.
+    std::vector<IplImage*> m_appearanceBank;
+    IplImage* m_appearancePatch; // sub-pixel positioned patch taken from the bank
+    CvRect m_appearanceRoi;      // region of m_appearanceImg holding the last patch
+    CvRect m_appearanceAltRoi;   // region holding the shifted opposite-heading patch (if any)
+
+    static const int m_appearanceBankSize = 360;
+    static const int m_appearanceSmoothing = 5;
+
     IplImage* m_avgFloat; // Temporal-average (floating point)
     IplImage* m_avg; // Temporal average image
     IplImage* m_diff; // Difference image for motion detection
     IplImage* m_filtered; // filtered motion image
 
+    TargetRelocaliser m_relocaliser; // coarse candidate search for loss recovery
+    CrossCorrelation::RadialWeights m_nccWeights; // Ncc2dRadial weights for the target-sized window
+
+    bool m_motionPrediction;  // seed KLT from a constant velocity prediction
+    float m_predictionError;  // seed residual of the last predicted frame (-1 if unknown)
+    FrameStats m_frameStats;
+
+    static const double m_maxPredictionGapMs;       // don't predict across gaps longer than this
+    static const float m_confidentPredictionRadius; // fraction of radius below which the prediction is trusted
+    static const float m_confidentWindowRadius;     // KLT window (fraction of radius) when trusted
+
     // History stores the position, orientation, tracker error and time stamp.
     TrackHistory::TrackLog m_history;
 
@@ -176,8 +230,18 @@ private:
     void ReleasePyramids();
     void SwapPyramids();
 
+    void BuildAppearanceBank();
+    void ApplyRadialMask( IplImage* patch ) const;
+    void ReleaseAppearanceBank();
+    void AllocateAppearanceImage();
+
     void PredictTargetAppearance( float angleInRadians, float offsetAngleDegrees );
     void PredictTargetAppearance2( float angleInRadians, float offsetAngleDegrees, float x, float y );
+    void PredictOpposingAppearances( float angleInRadians, CvPoint shift );
+    void ClearAppearance( CvRect& roi );
+    void WriteAppearancePatch( float angleInRadians, float offsetAngleDegrees,
+                               float x, float y, CvPoint shift, CvRect& roi );
+    bool ChooseHypothesisShift( int windowRadius, CvPoint& shift ) const;
     bool TrackStage2( CvPoint2D32f initialPosition, bool flipCorrect, bool init );
 
     void InitialiseRecoverySystem();
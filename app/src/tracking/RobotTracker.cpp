@@ -119,6 +119,35 @@ CvPoint2D32f RobotTracker::ConvertTrackToPx( CvPoint2D32f p ) const
     return p;
 }
 
+/**
+    Note that frames were skipped (so not tracked) before the frame
+    with the given time-stamp.
+**/
+void RobotTracker::RecordFrameDrop( double timeStamp, unsigned int numFrames )
+{
+    if ( numFrames == 0 )
+    {
+        return;
+    }
+
+    const TrackHistory::FrameDrop drop = { timeStamp, numFrames };
+    m_drops.push_back( drop );
+}
+
+/**
+    Convert the time-stamps of the recorded frame drops from
+    milliseconds to seconds to match ConvertLogForProcessing().
+**/
+void RobotTracker::ConvertDropsForProcessing( TrackHistory::DropLog& newdrops ) const
+{
+    newdrops = m_drops;
+
+    for ( unsigned int i=0; i<newdrops.size(); ++i )
+    {
+        newdrops[i].timeStamp /= 1000.0; // convert timestamp from millisecs to secs
+    }
+}
+
 /**
     Convert the stored robot log to cm in the ground plane coordinate system
     (adjusting for robot height). Also converts the timestamps from milliseconds
@@ -195,7 +224,11 @@ void RobotTracker::WriteTrackData( const char* trackerOutput, bool relative ) co
         return;
     }
 
-    TrackHistory::WriteHistoryLog( trackerOutput, history );
+    TrackHistory::DropLog drops;
+
+    ConvertDropsForProcessing( drops );
+
+    TrackHistory::WriteHistoryLog( trackerOutput, history, drops );
 }
 
 bool RobotTracker::IsActive() const
@@ -43,7 +43,8 @@ public:
 
     enum paramType
     {
-        PARAM_NCC_THRESHOLD = 0
+        PARAM_NCC_THRESHOLD = 0,
+        PARAM_MOTION_PREDICTION // non-zero to seed tracking from a motion prediction
     };
 
     enum trackerStatus
@@ -54,7 +55,7 @@ public:
         TRACKER_JUST_LOST // Tracker has just transitioned into lost state on previous frame
     };
 
-    RobotTracker() : m_status(TRACKER_INACTIVE) {}
+    RobotTracker() : m_status(TRACKER_INACTIVE), m_drops() {}
     virtual ~RobotTracker() {}
 
     virtual CvPoint2D32f GetPosition() const = 0;
@@ -83,6 +84,7 @@ public:
     virtual void Deactivate();
     virtual void DoInactiveProcessing(double timeStamp) = 0;
     virtual void LossRecovery() {}
+    virtual bool PredictPosition( double /*timestampInMillisecs*/, CvPoint2D32f& /*prediction*/ ) const { return false; }
 
     virtual const CameraCalibration* GetCalibration()    const = 0;
     virtual const RobotMetrics*      GetMetrics()        const = 0;
@@ -98,10 +100,16 @@ public:
     CvPoint2D32f ConvertTrackToCm( CvPoint2D32f pos ) const;
     CvPoint2D32f ConvertTrackToPx( CvPoint2D32f p ) const;
 
+    void RecordFrameDrop( double timeStamp, unsigned int numFrames );
+    const TrackHistory::DropLog& GetFrameDrops() const { return m_drops; }
+    void ConvertDropsForProcessing( TrackHistory::DropLog& newdrops ) const;
+
 protected:
     trackerStatus m_status; // status is recorded and managed in base class
 
 private:
+    TrackHistory::DropLog m_drops; // gaps in the history due to dropped live frames
+
     RobotTracker( RobotTracker& rt ); // Trackers are deliberately uncopyable!
 };
 
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "ScanlineRasteriser.h"
+
+#include <algorithm>
+
+#include <assert.h>
+#include <math.h>
+
+namespace ScanlineRasteriser
+{
+    namespace
+    {
+        const long long ONE  = 1LL << SUBPIXEL_BITS;
+        const long long HALF = ONE / 2;
+
+        // Vertices further outside the image than this are clamped so the
+        // edge arithmetic below cannot overflow.
+        const float MAX_COORD = (float)( 1 << 20 );
+
+        long long ToFixed( float v )
+        {
+            if ( !( v == v ) )
+            {
+                v = 0.f;
+            }
+
+            v = std::max( -MAX_COORD, std::min( v, MAX_COORD ) );
+
+            return (long long)floor( (double)v * ONE + .5 );
+        }
+
+        /** Rounds a/b towards +infinity (b > 0). **/
+        long long CeilDiv( long long a, long long b )
+        {
+            return ( a >= 0 ) ? ( a + b - 1 ) / b : -( ( -a ) / b );
+        }
+
+        /** The first pixel whose centre is at or right of fixed-point x. **/
+        long long FirstPixelFrom( long long num, long long den )
+        {
+            return CeilDiv( num - HALF * den, ONE * den );
+        }
+    }
+
+    /**
+        Appends the spans covered by a polygon to @a spans.
+
+        Rows are visited top to bottom and each row is filled between
+        successive pairs of edge crossings (even-odd rule), so a
+        self-intersecting quadrilateral fills both of its triangles.
+
+        @param pts The polygon vertices in image coordinates, where pixel
+                   (x, y) covers [x, x+1) x [y, y+1).
+        @param numPts Number of vertices (at most MAX_VERTICES).
+        @param clip Size of the image; no span leaves it.
+        @param spans Receives the spans, in increasing row order.
+    **/
+    void FillPolygon( const CvPoint2D32f* pts,
+                      int                 numPts,
+                      CvSize              clip,
+                      std::vector<Span>&  spans )
+    {
+        assert( numPts <= MAX_VERTICES );
+
+        if ( numPts < 3 )
+        {
+            return;
+        }
+
+        long long fx[MAX_VERTICES];
+        long long fy[MAX_VERTICES];
+
+        long long top = 0;
+        long long bottom = 0;
+
+        for ( int i = 0; i < numPts; ++i )
+        {
+            fx[i] = ToFixed( pts[i].x );
+            fy[i] = ToFixed( pts[i].y );
+
+            top    = ( i == 0 ) ? fy[i] : std::min( top, fy[i] );
+            bottom = ( i == 0 ) ? fy[i] : std::max( bottom, fy[i] );
+        }
+
+        // Rows whose centres lie in [top, bottom).
+        const long long firstRow = std::max( FirstPixelFrom( top, 1 ), 0LL );
+        const long long endRow = std::min( FirstPixelFrom( bottom, 1 ), (long long)clip.height );
+
+        for ( long long row = firstRow; row < endRow; ++row )
+        {
+            const long long yc = row * ONE + HALF;
+
+            long long crossings[MAX_VERTICES];
+            int numCrossings = 0;
+
+            for ( int i = 0; i < numPts; ++i )
+            {
+                const int j = ( i + 1 ) % numPts;
+
+                long long x0 = fx[i];
+                long long y0 = fy[i];
+                long long x1 = fx[j];
+                long long y1 = fy[j];
+
+                if ( y0 == y1 )
+                {
+                    continue;
+                }
+
+                if ( y0 > y1 )
+                {
+                    std::swap( x0, x1 );
+                    std::swap( y0, y1 );
+                }
+
+                // Top inclusive, bottom exclusive.
+                if ( yc < y0 || yc >= y1 )
+                {
+                    continue;
+                }
+
+                const long long den = y1 - y0;
+                const long long num = x0 * den + ( yc - y0 ) * ( x1 - x0 );
+
+                crossings[numCrossings++] = FirstPixelFrom( num, den );
+            }
+
+            std::sort( crossings, crossings + numCrossings );
+
+            // Left inclusive, right exclusive.
+            for ( int k = 0; k + 1 < numCrossings; k += 2 )
+            {
+                const long long x0 = std::max( crossings[k], 0LL );
+                const long long x1 = std::min( crossings[k + 1], (long long)clip.width );
+
+                if ( x0 < x1 )
+                {
+                    Span span;
+                    span.y  = (int)row;
+                    span.x0 = (int)x0;
+                    span.x1 = (int)x1;
+                    spans.push_back( span );
+                }
+            }
+        }
+    }
+}
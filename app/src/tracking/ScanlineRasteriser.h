@@ -0,0 +1,55 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef SCANLINERASTERISER_H
+#define SCANLINERASTERISER_H
+
+#include <opencv/cv.h>
+
+#include <vector>
+
+/**
+    Scan-converts polygons with sub-pixel vertices into runs of pixels.
+
+    Vertices are snapped to a fixed-point grid and a pixel is inside when
+    its centre is; centres lying exactly on an edge belong to the polygon
+    below or to the right of that edge, as rows are top-inclusive and
+    bottom-exclusive and spans left-inclusive and right-exclusive. Polygons
+    which share an edge therefore never both claim, nor both miss, a pixel
+    along it.
+**/
+namespace ScanlineRasteriser
+{
+    const int SUBPIXEL_BITS = 8;
+    const int MAX_VERTICES  = 8;
+
+    /** Pixels x0 <= x < x1 on row y. **/
+    struct Span
+    {
+        int y;
+        int x0;
+        int x1;
+    };
+
+    void FillPolygon( const CvPoint2D32f* pts,
+                      int                 numPts,
+                      CvSize              clip,
+                      std::vector<Span>&  spans );
+}
+
+#endif // SCANLINERASTERISER_H
@@ -0,0 +1,172 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TargetHeading.h"
+
+#include "MathsConstants.h"
+
+#include <algorithm>
+
+#include <math.h>
+
+namespace TargetHeading
+{
+    namespace
+    {
+        const int kWeightBits = 24;
+
+        /**
+            Fixed-point weights exp(-((v-255)/50)^2) for every inverted
+            grey-level v, so the per-pixel exponential becomes a lookup.
+        **/
+        class LevelWeights
+        {
+        public:
+            LevelWeights()
+            {
+                for ( int v = 0; v < 256; ++v )
+                {
+                    const double w = exp( -pow( ( v - 255.0 ) / 50.0, 2 ) );
+                    m_table[v] = (long long)( w * ( 1 << kWeightBits ) + .5 );
+                }
+            }
+
+            long long operator[]( int v ) const { return m_table[v]; }
+
+        private:
+            long long m_table[256];
+        };
+
+        const LevelWeights levelWeights;
+    }
+
+    /**
+        Simple technique for determining robot heading using
+        the distribution of light and dark pixels on the target.
+
+        Pixels are soft cut-out with @a radialWeights, inverted and
+        thresholded; the principal axis of the remaining (weighted)
+        pixels gives the heading.
+
+        @param img The (single channel) tracking image.
+        @param pos The image coordinate at which to perform the computation.
+        @param radius Radius of the target in pixels.
+        @param radialWeights Soft cut-out weights (at least 2*radius square).
+        @param threshold Inverted grey-level below which pixels are ignored.
+        @param fallbackAngle Returned if the window leaves the image or is empty.
+    **/
+    float Estimate( const IplImage* img,
+                    CvPoint2D32f    pos,
+                    float           radius,
+                    const CvMat*    radialWeights,
+                    int             threshold,
+                    float           fallbackAngle )
+    {
+        if ( !img )
+        {
+            return fallbackAngle;
+        }
+
+        CvRect roi = cvRect( (int)(pos.x - radius),
+                             (int)(pos.y - radius),
+                             (int)(radius * 2),
+                             (int)(radius * 2) );
+
+        // Check we will be within bounds.
+        if ( roi.x < 0 || roi.x > img->width - radius ||
+             roi.y < 0 || roi.y > img->height - radius )
+        {
+            return fallbackAngle;
+        }
+
+        // Clip the window to the image (as an IplImage ROI would be).
+        const int w = std::min( roi.width, img->width - roi.x );
+        const int h = std::min( roi.height, img->height - roi.y );
+
+        // Zeroth, first and second order moments (fixed point).
+        long long s0 = 0;
+        long long si = 0;
+        long long sj = 0;
+        long long sii = 0;
+        long long sij = 0;
+        long long sjj = 0;
+
+        for ( int i = 0; i < h; ++i )
+        {
+            const unsigned char* pImg = reinterpret_cast<const unsigned char*>( img->imageData ) +
+                                        ( roi.y + i ) * img->widthStep + roi.x;
+            const float* pWeight = reinterpret_cast<const float*>( radialWeights->data.ptr +
+                                                                   i * radialWeights->step );
+
+            long long r0 = 0;
+            long long r1 = 0;
+            long long r2 = 0;
+
+            // No branches in the inner loop: pixels at or below the
+            // threshold are masked to a zero weight instead of skipped.
+            for ( int j = 0; j < w; ++j )
+            {
+                // Remove background with soft cut-out then invert.
+                const float cutOut = pWeight[j];
+                const int val = (int)( cutOut * ( 255.f - pImg[j] ) + .5f );
+
+                const long long keep = -(long long)( val > threshold );
+                const long long lw = levelWeights[val] & keep;
+                r0 += lw;
+                r1 += lw * j;
+                r2 += lw * j * j;
+            }
+
+            s0  += r0;
+            si  += r0 * i;
+            sii += r0 * i * i;
+            sj  += r1;
+            sij += r1 * i;
+            sjj += r2;
+        }
+
+        if ( s0 == 0 )
+        {
+            return fallbackAngle;
+        }
+
+        const double invSum = 1.0 / (double)s0;
+        const double mx = si * invSum;
+        const double my = sj * invSum;
+
+        // Weighted covariance about the mean.
+        float cov[4];
+        CvMat C = cvMat( 2, 2, CV_32F, cov );
+        cov[0] = (float)( sii * invSum - mx * mx );
+        cov[1] = (float)( sij * invSum - mx * my );
+        cov[2] = cov[1];
+        cov[3] = (float)( sjj * invSum - my * my );
+
+        // Compute principle components (eigen values/vectors using SVD)
+        float wv[4];
+        float u[4];
+        CvMat W = cvMat( 2, 2, CV_32F, wv );
+        CvMat U = cvMat( 2, 2, CV_32F, u );
+        cvSVD( &C, &W, &U, 0, CV_SVD_MODIFY_A );
+
+        float angle = (float)(atan2( u[0], u[2] ) + (.25f * MathsConstants::F_PI));
+        angle = (MathsConstants::F_PI / 2.0f) - angle;
+
+        return angle;
+    }
+}
@@ -0,0 +1,42 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TARGETHEADING_H
+#define TARGETHEADING_H
+
+#include <opencv/cv.h>
+
+/**
+    Estimates the heading of the robot target from the distribution of
+    light and dark pixels in a window around a position.
+
+    The window is read in place from the tracking image and the weighted
+    moments and covariance are gathered in a single pass using integer
+    accumulators, so no images are allocated per call.
+**/
+namespace TargetHeading
+{
+    float Estimate( const IplImage* img,
+                    CvPoint2D32f    pos,
+                    float           radius,
+                    const CvMat*    radialWeights,
+                    int             threshold,
+                    float           fallbackAngle );
+}
+
+#endif // TARGETHEADING_H
@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "TargetRelocaliser.h"
+
+#include <algorithm>
+
+TargetRelocaliser::TargetRelocaliser() :
+    m_scale         ( 1 ),
+    m_suppressRadius( 1 ),
+    m_dilation      ( 1 ),
+    m_template      ( 0 ),
+    m_coarseImg     ( 0 ),
+    m_coarseMask    ( 0 ),
+    m_scores        ( 0 ),
+    m_scoreMask     ( 0 ),
+    m_candidates    ()
+{
+}
+
+TargetRelocaliser::~TargetRelocaliser()
+{
+    Release();
+}
+
+/**
+ Build the coarse template from the pre-rotated appearance bank.
+
+ Averaging over all orientations gives a template that does not depend
+ on the (unknown) heading. The pyramid level is the coarsest power of
+ two which still leaves the target radius at least m_minCoarseRadius
+ pixels.
+
+ @param appearanceBank the rotated target patches (all the same size).
+ @param targetSize side of the (unrotated) target image in pixels.
+ @param radiusPx robot radius in pixels.
+ **/
+void TargetRelocaliser::SetTarget( const std::vector<IplImage*>& appearanceBank,
+                                   int targetSize,
+                                   float radiusPx )
+{
+    Release();
+
+    if ( appearanceBank.empty() || targetSize <= 0 )
+    {
+        return;
+    }
+
+    m_scale = 1;
+    while ( radiusPx / ( 2 * m_scale ) >= m_minCoarseRadius )
+    {
+        m_scale *= 2;
+    }
+
+    const CvSize patchSize = cvGetSize( appearanceBank[0] );
+    IplImage* sum = cvCreateImage( patchSize, IPL_DEPTH_32F, 1 );
+    cvZero( sum );
+
+    for ( size_t k = 0; k < appearanceBank.size(); ++k )
+    {
+        cvAcc( appearanceBank[k], sum );
+    }
+
+    IplImage* mean = cvCreateImage( patchSize, IPL_DEPTH_8U, 1 );
+    cvConvertScale( sum, mean, 1.0 / appearanceBank.size() );
+
+    targetSize = std::min( targetSize, std::min( patchSize.width, patchSize.height ) );
+    cvSetImageROI( mean, cvRect( ( patchSize.width - targetSize ) / 2,
+                                 ( patchSize.height - targetSize ) / 2,
+                                 targetSize,
+                                 targetSize ) );
+
+    const int coarseSize = std::max( 3, targetSize / m_scale );
+    m_template = cvCreateImage( cvSize( coarseSize, coarseSize ), IPL_DEPTH_8U, 1 );
+    cvResize( mean, m_template, CV_INTER_AREA );
+
+    cvReleaseImage( &mean );
+    cvReleaseImage( &sum );
+
+    const int coarseRadius = (int)( radiusPx / m_scale + .5f );
+    m_suppressRadius = std::max( 1, coarseRadius );
+    m_dilation = std::max( 1, coarseRadius );
+}
+
+/**
+ Find up to m_maxCandidates positions where the target may be.
+
+ @param img the (grey-level) tracking image.
+ @param mask non-zero where there is motion.
+ @return candidate target centres in image coordinates, best first.
+ **/
+const std::vector<CvPoint>& TargetRelocaliser::FindCandidates( const IplImage* img,
+                                                               const IplImage* mask )
+{
+    m_candidates.clear();
+
+    if ( !m_template )
+    {
+        return m_candidates;
+    }
+
+    AllocateWorkImages( cvGetSize( img ) );
+
+    if ( !m_scores )
+    {
+        return m_candidates;
+    }
+
+    cvResize( img, m_coarseImg, CV_INTER_AREA );
+
+    // Any motion inside a coarse pixel marks it; then grow the mask so
+    // the target centre is included when only its edge has moved.
+    cvResize( mask, m_coarseMask, CV_INTER_AREA );
+    cvThreshold( m_coarseMask, m_coarseMask, 0, 255, CV_THRESH_BINARY );
+    cvDilate( m_coarseMask, m_coarseMask, 0, m_dilation );
+
+    cvMatchTemplate( m_coarseImg, m_template, m_scores, CV_TM_CCOEFF_NORMED );
+
+    // Scores are indexed by the template's top-left corner.
+    const int offsetX = m_template->width / 2;
+    const int offsetY = m_template->height / 2;
+
+    cvSetImageROI( m_coarseMask, cvRect( offsetX, offsetY, m_scores->width, m_scores->height ) );
+    cvCopy( m_coarseMask, m_scoreMask );
+    cvResetImageROI( m_coarseMask );
+
+    while ( (int)m_candidates.size() < m_maxCandidates && cvCountNonZero( m_scoreMask ) > 0 )
+    {
+        double maxVal = 0.0;
+        CvPoint maxLoc = cvPoint( 0, 0 );
+        cvMinMaxLoc( m_scores, 0, &maxVal, 0, &maxLoc, m_scoreMask );
+
+        m_candidates.push_back( cvPoint( ( maxLoc.x + offsetX ) * m_scale + m_scale / 2,
+                                         ( maxLoc.y + offsetY ) * m_scale + m_scale / 2 ) );
+
+        // Non-maximum suppression: the next peak must be a different blob.
+        cvCircle( m_scoreMask, maxLoc, m_suppressRadius, cvScalar( 0 ), CV_FILLED );
+    }
+
+    return m_candidates;
+}
+
+/**
+ (Re)allocate the coarse images when the tracking image size changes.
+ m_scores is left null if the image is smaller than the template.
+ **/
+void TargetRelocaliser::AllocateWorkImages( CvSize imageSize )
+{
+    const CvSize coarseSize = cvSize( imageSize.width / m_scale, imageSize.height / m_scale );
+
+    if ( m_coarseImg &&
+         m_coarseImg->width == coarseSize.width &&
+         m_coarseImg->height == coarseSize.height )
+    {
+        return;
+    }
+
+    ReleaseWorkImages();
+
+    if ( coarseSize.width < m_template->width || coarseSize.height < m_template->height )
+    {
+        return;
+    }
+
+    const CvSize scoreSize = cvSize( coarseSize.width - m_template->width + 1,
+                                     coarseSize.height - m_template->height + 1 );
+
+    m_coarseImg = cvCreateImage( coarseSize, IPL_DEPTH_8U, 1 );
+    m_coarseMask = cvCreateImage( coarseSize, IPL_DEPTH_8U, 1 );
+    m_scores = cvCreateImage( scoreSize, IPL_DEPTH_32F, 1 );
+    m_scoreMask = cvCreateImage( scoreSize, IPL_DEPTH_8U, 1 );
+}
+
+void TargetRelocaliser::ReleaseWorkImages()
+{
+    cvReleaseImage( &m_coarseImg );
+    cvReleaseImage( &m_coarseMask );
+    cvReleaseImage( &m_scores );
+    cvReleaseImage( &m_scoreMask );
+}
+
+void TargetRelocaliser::Release()
+{
+    ReleaseWorkImages();
+    cvReleaseImage( &m_template );
+    m_candidates.clear();
+    m_scale = 1;
+}
@@ -0,0 +1,76 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef TARGETRELOCALISER_H
+#define TARGETRELOCALISER_H
+
+#include <opencv/cv.h>
+
+#include <vector>
+
+/**
+    Coarse stage of loss recovery.
+
+    The rotation-averaged target (the mean of the appearance bank) is
+    matched against a downscaled copy of the tracking image, restricted
+    to a dilated copy of the motion mask. The best few non-overlapping
+    peaks are returned in full resolution coordinates so that only
+    those neighbourhoods need the (expensive) heading-aware correlation.
+**/
+class TargetRelocaliser
+{
+public:
+    TargetRelocaliser();
+    ~TargetRelocaliser();
+
+    void SetTarget( const std::vector<IplImage*>& appearanceBank,
+                    int targetSize,
+                    float radiusPx );
+
+    const std::vector<CvPoint>& FindCandidates( const IplImage* img,
+                                                const IplImage* mask );
+
+    /** Full resolution pixels per coarse pixel. **/
+    int GetScale() const
+    {
+        return m_scale;
+    }
+
+    static const int m_maxCandidates = 8;
+
+private:
+    void Release();
+    void ReleaseWorkImages();
+    void AllocateWorkImages( CvSize imageSize );
+
+    int m_scale;
+    int m_suppressRadius;
+    int m_dilation;
+
+    IplImage* m_template;   // rotation-averaged target at coarse scale
+    IplImage* m_coarseImg;
+    IplImage* m_coarseMask;
+    IplImage* m_scores;     // CV_TM_CCOEFF_NORMED match scores
+    IplImage* m_scoreMask;  // coarse mask aligned with m_scores
+
+    std::vector<CvPoint> m_candidates;
+
+    static const int m_minCoarseRadius = 6;
+};
+
+#endif // TARGETRELOCALISER_H
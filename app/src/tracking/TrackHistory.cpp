@@ -26,15 +26,30 @@
 #include <QObject>
 
 #include <string>
+#include <string.h>
 
 const float TrackEntry::unknownWgm = 0.f;
 
+namespace
+{
+    const char* const dropTag = "#dropped";
+
+    void WriteDrop( FILE* to, const TrackHistory::FrameDrop& drop )
+    {
+        fprintf( to, "%s %4.4f %u\n", dropTag, drop.timeStamp, drop.numFrames );
+    }
+}
+
 namespace TrackHistory
 {
     /**
         Write a robot-track history log to file.
+
+        Frame drops (in time order) are written as '#dropped time(s) frames'
+        comment lines just before the entry tracking resumed on, so readers
+        which skip comments see the same log as before.
     **/
-    bool WriteHistoryLog( const char* filename, const TrackLog& history )
+    bool WriteHistoryLog( const char* filename, const TrackLog& history, const DropLog& drops )
     {
         FILE* to = fopen( filename, "w" );
 
@@ -48,8 +63,15 @@ namespace TrackHistory
 
             fprintf( to, "#Track log: %s\n# time(s)\tx(cm)\ty(cm)\theading(deg)\terror\t[wgm]\n", buf );
 
+            unsigned int d = 0;
+
             for ( unsigned int i=0; i<history.size(); ++i )
             {
+                for ( ; d < drops.size() && drops[d].timeStamp <= history[i].GetTimeStamp(); ++d )
+                {
+                    WriteDrop( to, drops[d] );
+                }
+
                 const std::string* str = history[i].GetString();
                 if ( str )
                 {
@@ -72,6 +94,11 @@ namespace TrackHistory
                 }
             }
 
+            for ( ; d < drops.size(); ++d )
+            {
+                WriteDrop( to, drops[d] );
+            }
+
             fclose(to);
 
             return true;
@@ -87,8 +114,12 @@ namespace TrackHistory
 
     /**
         Write a robot-track history log to CSV file.
+
+        The last column holds the number of frames dropped since the
+        previous entry; drops (in time order) after the last entry are
+        not written as no tracked frame follows them.
     **/
-    bool WriteHistoryCsv( const char* filename, const TrackLog& history )
+    bool WriteHistoryCsv( const char* filename, const TrackLog& history, const DropLog& drops )
     {
         FILE* to = fopen( filename, "w" );
 
@@ -100,17 +131,27 @@ namespace TrackHistory
             char buf[1024];
             strftime( buf, sizeof(buf)-1, "%c", t2 );
 
-            fprintf( to, "Time(s),X(cm),Y(cm),H(deg),Err,WGM\n");
+            fprintf( to, "Time(s),X(cm),Y(cm),H(deg),Err,WGM,Dropped\n");
+
+            unsigned int d = 0;
 
             for ( unsigned int i=0; i<history.size(); ++i )
             {
-                fprintf( to, "%4.4f,%.3f,%.3f,%.3f,%f,%f\n",
+                unsigned int dropped = 0;
+
+                for ( ; d < drops.size() && drops[d].timeStamp <= history[i].GetTimeStamp(); ++d )
+                {
+                    dropped += drops[d].numFrames;
+                }
+
+                fprintf( to, "%4.4f,%.3f,%.3f,%.3f,%f,%f,%u\n",
                     history[i].GetTimeStamp(),
                     history[i].GetPosition().x,
                     -history[i].GetPosition().y,  // convert to right handed coords
                     history[i].GetOrientation() * MathsConstants::R2D,
                     history[i].GetError(),
-                    history[i].wgm() );
+                    history[i].wgm(),
+                    dropped );
             }
 
             fclose(to);
@@ -133,6 +174,17 @@ namespace TrackHistory
         but when read it is not converted back!
     **/
     bool ReadHistoryLog( const char* filename, TrackLog& log )
+    {
+        DropLog drops;
+
+        return ReadHistoryLog( filename, log, drops );
+    }
+
+    /**
+        Read a robot-track history log and the frame drops
+        recorded in it from file.
+    **/
+    bool ReadHistoryLog( const char* filename, TrackLog& log, DropLog& drops )
     {
         FILE* fp = fopen( filename, "r" );
         char s[10000];
@@ -141,6 +193,7 @@ namespace TrackHistory
         if (fp)
         {
             log.clear();
+            drops.clear();
             while (!feof(fp))
             {
                 cnt = fscanf(fp,"%s",s);
@@ -148,6 +201,14 @@ namespace TrackHistory
                 {
                     if(s[0]=='#') //comment?
                     {
+                        FrameDrop drop;
+
+                        if ( ( strcmp( s, dropTag ) == 0 ) &&
+                             ( fscanf( fp, "%lf %u", &drop.timeStamp, &drop.numFrames ) == 2 ) )
+                        {
+                            drops.push_back( drop );
+                        }
+
                         FileUtilities::LineSkip(fp);
                     }
                     else //data
@@ -177,6 +238,8 @@ namespace TrackHistory
                     }
                 }
             }
+
+            fclose(fp);
         }
         else
         {
@@ -190,6 +253,18 @@ namespace TrackHistory
     }
 
     bool ReadHistoryCsv( const char* filename, TrackLog& log )
+    {
+        DropLog drops;
+
+        return ReadHistoryCsv( filename, log, drops );
+    }
+
+    /**
+        Read a robot-track history log and the frame drops recorded
+        in it from CSV file. Files without the drop column are read
+        as having no drops.
+    **/
+    bool ReadHistoryCsv( const char* filename, TrackLog& log, DropLog& drops )
     {
         FILE* fp = fopen( filename, "r" );
         int cnt;
@@ -197,20 +272,30 @@ namespace TrackHistory
         if (fp)
         {
             log.clear();
+            drops.clear();
 
             // Skip headers
             FileUtilities::LineSkip(fp);
 
-            while (!feof(fp))
+            float t,x,y,th,e,w;
+
+            // The leading space skips the end of the previous row, so
+            // EOF is only returned once there are no more rows.
+            while ( ( cnt = fscanf( fp, " %f,%f,%f,%f,%f,%f", &t, &x, &y, &th, &e, &w ) ) != EOF )
             {
-                float t,x,y,th,e,w;
+                unsigned int dropped = 0;
 
-                cnt = fscanf( fp, "%f,%f,%f,%f,%f,%f\n", &t, &x, &y, &th, &e, &w );
                 if ( cnt != 6 )
                 {
                     LOG_ERROR(QObject::tr("Unexpected data (%1) in log %2!").arg(cnt).arg(filename));
                 }
 
+                if ( ( fscanf( fp, ",%u", &dropped ) == 1 ) && ( dropped > 0 ) )
+                {
+                    const FrameDrop drop = { t, dropped };
+                    drops.push_back( drop );
+                }
+
                 log.push_back( TrackEntry( cvPoint2D32f(x,y), th*MathsConstants::F_D2R, e, t, w ) );
             }
 
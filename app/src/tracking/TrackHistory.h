@@ -150,11 +150,24 @@ namespace TrackHistory
 {
     typedef std::vector<TrackEntry> TrackLog;
 
-    bool WriteHistoryLog( const char* filename, const TrackLog& hist );
-    bool WriteHistoryCsv( const char* filename, const TrackLog& hist );
+    /** Frames skipped by live tracking to keep within its latency budget. **/
+    struct FrameDrop
+    {
+        double       timeStamp; ///< Time-stamp of the frame tracking resumed on
+        unsigned int numFrames; ///< Number of frames skipped before it
+
+        bool operator < ( const FrameDrop& fd ) const { return timeStamp < fd.timeStamp; };
+    };
+
+    typedef std::vector<FrameDrop> DropLog;
+
+    bool WriteHistoryLog( const char* filename, const TrackLog& hist, const DropLog& drops = DropLog() );
+    bool WriteHistoryCsv( const char* filename, const TrackLog& hist, const DropLog& drops = DropLog() );
 
     bool ReadHistoryLog( const char* filename, TrackLog& hist );
+    bool ReadHistoryLog( const char* filename, TrackLog& hist, DropLog& drops );
     bool ReadHistoryCsv( const char* filename, TrackLog& hist );
+    bool ReadHistoryCsv( const char* filename, TrackLog& hist, DropLog& drops );
 
     TrackEntry InterpolateEntries( TrackEntry a, TrackEntry b, float w );
 }
@@ -29,6 +29,7 @@
 #include <QtCore/QTime>
 #include <QtCore/QThread>
 #include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
 #include <QtGui/QApplication>
 
 #include "Debugging.h"
@@ -46,7 +47,8 @@ TrackThread::TrackThread( GtsScene& scene ) :
     m_paused  ( false ),
     m_forward ( true ),
     m_thread  ( new QThread() ),
-    m_mutex   ()
+    m_mutex   (),
+    m_wake    ()
 {
     QObject::connect( m_thread.get(),
                       SIGNAL( started() ),
@@ -80,16 +82,40 @@ void TrackThread::Execute()
         bool trackingLost = ( status.numTrackersActive == status.numTrackersLost && status.numTrackersActive==0  );
        emit position( status.videoPosition );
 
+        if ( status.ratesUpdated )
+        {
+            emit rates( status.trackingRate, status.displayRate );
+
+            for ( unsigned int i = 0; i < m_scene.GetNumMaxCameras(); ++i )
+            {
+                if ( status.live[i] )
+                {
+                    emit excessLatency( i, status.excessLatencyMs[i], status.framesDropped[i] );
+                }
+
+                if ( status.kltTracked[i] )
+                {
+                    emit klt( i, status.kltPredictedPercent[i], status.kltWindowPx[i], status.kltResidualPx[i] );
+                }
+
+                if ( status.coveragePercent[i] >= 0.0 )
+                {
+                    emit coverage( i, status.coveragePercent[i] );
+                }
+            }
+        }
+
         if ( ShouldPause() || (ShouldTrack() && trackingLost) )
         {
-            m_paused = true;
+            // The display may be throttled, so make sure
+            // the frame we stop on is the one shown.
+            m_scene.RefreshDisplay();
+
+            Hold();
             emit paused( trackingLost );
         }
 
-		while ( m_paused )
-		{
-			if ( ShouldStop() ) { break; }
-		}
+        WaitWhilePaused();
 
         if ( status.eof )
 		{
@@ -97,6 +123,8 @@ void TrackThread::Execute()
 		}
 	}
 
+    m_scene.RefreshDisplay();
+
     emit finished();
     m_thread->quit();
 }
@@ -129,6 +157,7 @@ void TrackThread::SetStopFlag()
 {
     QMutexLocker mutexLock( &m_mutex );
     m_stop = true;
+    m_wake.wakeAll();
 }
 
 void TrackThread::ClearStopFlag()
@@ -161,10 +190,31 @@ void TrackThread::SetBackward()
     m_forward = false;
 }
 
+void TrackThread::Hold()
+{
+    QMutexLocker mutexLock( &m_mutex );
+    m_paused = true;
+}
+
 void TrackThread::Release()
 {
     QMutexLocker mutexLock( &m_mutex );
     m_paused = false;
+    m_wake.wakeAll();
+}
+
+/** @brief Block the tracking thread while it is paused.
+ *
+ *  Sleeps on a wait condition (rather than polling) until Run() releases
+ *  the pause or Stop() is called, so a paused thread uses no CPU.
+ */
+void TrackThread::WaitWhilePaused()
+{
+    QMutexLocker mutexLock( &m_mutex );
+    while ( m_paused && !m_stop )
+    {
+        m_wake.wait( &m_mutex );
+    }
 }
 
 void TrackThread::Run()
@@ -24,6 +24,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
 
 class GtsScene;
 
@@ -60,6 +61,10 @@ signals:
     void finished();
 
 	void position( double position );
+    void rates( double trackingRate, double displayRate );
+    void excessLatency( int camera, double excessLatencyMs, unsigned int framesDropped );
+    void klt( int camera, double predictedPercent, double windowPx, double residualPx );
+    void coverage( int camera, double percent );
 
 private:
 
@@ -82,7 +87,9 @@ private:
     void SetForward();
     void SetBackward();
 
+    void Hold();
     void Release();
+    void WaitWhilePaused();
 
 
     const bool Tracking() const { return m_track; };
@@ -102,6 +109,7 @@ private:
     std::unique_ptr<QThread> m_thread;
 
     mutable QMutex m_mutex;
+    QWaitCondition m_wake; // signalled (with m_mutex) on release and stop
 };
 
 #endif // TRACKTHREAD_H
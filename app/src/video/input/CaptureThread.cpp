@@ -27,6 +27,7 @@
 
 #include <QtCore/QThread>
 #include <QtCore/QMutex>
+#include <QtCore/QWaitCondition>
 #include <QtGui/QApplication>
 
 #include "Debugging.h"
@@ -41,6 +42,7 @@ CaptureThread::CaptureThread( VideoSequence* const videoSeq ) :
     m_internalImage ( 0 ),
     m_image         (),
     m_capturingMutex(),
+    m_stopCondition (),
     m_thread        ( new QThread() )
 {
     QObject::connect( m_thread.get(),
@@ -67,21 +69,27 @@ CaptureThread::~CaptureThread()
  *
  *  And emit the GotImage() signal when we have a new image, and the finished()
  *  signal at the end.
+ *
+ *  This is reduced polling rather than event driven: a live sequence blocks in
+ *  its own grab while a frame is on the way, but if it has nothing (or no
+ *  sequence is set up) the loop sleeps for a fixed time and asks again, since
+ *  VideoSequence has no frame-ready notification to wait on.
  */
 void CaptureThread::run()
 {
     while ( !ShouldStopCapturing() )
     {
-        if ( !m_videoSeq.get() )
-        {
-            continue;
-        }
-        if ( !m_videoSeq->IsSetup() )
+        if ( !m_videoSeq.get() || !m_videoSeq->IsSetup() )
         {
+            // Nothing to capture from: sleep until asked to stop.
+            WaitForStopCapturing( IDLE_WAIT_MS );
             continue;
         }
         if ( !m_videoSeq->ReadyNextFrame() )
         {
+            // No frame available yet: back off briefly rather than
+            // hammering the camera API.
+            WaitForStopCapturing( FRAME_RETRY_WAIT_MS );
             continue;
         }
 
@@ -145,6 +153,7 @@ void CaptureThread::SetStopCapturingFlag()
 {
     QMutexLocker capturingMutexLock(&m_capturingMutex);
     m_stopCapturing = true;
+    m_stopCondition.wakeAll();
 }
 
 /** @brief Stop Capturing images.
@@ -179,3 +188,21 @@ bool CaptureThread::ShouldStopCapturing() const
     return m_stopCapturing;
 }
 
+/** @brief Sleep until StopCapturing() is called or the timeout expires.
+ *
+ *  Used instead of spinning when there is nothing to capture, so the
+ *  idle capture thread does not use any CPU but still stops promptly.
+ *
+ * @param timeoutMs The longest time to wait in milliseconds.
+ * @return Whether we should stop capturing.
+ */
+bool CaptureThread::WaitForStopCapturing( unsigned long timeoutMs )
+{
+    QMutexLocker capturingMutexLock( &m_capturingMutex );
+    if ( !m_stopCapturing )
+    {
+        m_stopCondition.wait( &m_capturingMutex, timeoutMs );
+    }
+    return m_stopCapturing;
+}
+
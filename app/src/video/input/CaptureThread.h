@@ -25,6 +25,7 @@
 #include <QtCore/QObject>
 #include <QtCore/QMutex>
 #include <QtCore/QThread>
+#include <QtCore/QWaitCondition>
 
 #include <memory>
 
@@ -65,6 +66,7 @@ signals:
     void GotImage(const QImage& newImage, const timespec stamp, const double fps );
 private:
     bool ShouldStopCapturing() const;
+    bool WaitForStopCapturing( unsigned long timeoutMs );
     void UpdateQImage();
     void SetStopCapturingFlag();
 
@@ -76,6 +78,10 @@ private:
     QImage  m_image;
 
     mutable QMutex m_capturingMutex;
+    QWaitCondition m_stopCondition; // signalled (with m_capturingMutex) by StopCapturing
+
+    static const unsigned long IDLE_WAIT_MS = 100;      // re-check interval when there is no sequence
+    static const unsigned long FRAME_RETRY_WAIT_MS = 5; // back-off when a frame is not ready
 
     std::unique_ptr<QThread> m_thread;
 };
@@ -38,6 +38,7 @@ FileCapture::FileCapture( const char* filename ) :
 	m_path		(""),
 	m_sequence	(0),
 	m_img		(0),
+	m_loadFlags	(CV_LOAD_IMAGE_COLOR),
 	m_index		(0),
 	m_numFrames	(0),
 	m_IsSetup (false)
@@ -124,7 +125,7 @@ bool FileCapture::ReadyNextFrame()
 
 	std::string file = m_path + m_sequence[m_index++].file;
 
-	m_img = cvLoadImage( file.c_str() );
+	m_img = cvLoadImage( file.c_str(), m_loadFlags );
 
 	if ( m_img )
 	{
@@ -138,6 +139,15 @@ bool FileCapture::ReadyNextFrame()
 	return ( m_img != 0 );
 }
 
+/**
+	Decode the images in the sequence straight to grey (or back to colour)
+	from the next frame on.
+**/
+void FileCapture::SetPreferGreyscale( bool grey )
+{
+	m_loadFlags = grey ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+}
+
 bool FileCapture::ReadyNextFrame( double msec )
 {
     Q_UNUSED(msec);
@@ -51,6 +51,8 @@ public:
 
 	virtual const IplImage* RetrieveNextFrame() const { return m_img; };
 
+	virtual void SetPreferGreyscale( bool grey );
+
 	virtual double GetTimeStamp()	const;
 	virtual double GetFrameIndex()	const { return (double)(m_index-1); };
 	virtual double GetNumFrames()	const { return m_numFrames; };
@@ -84,6 +86,7 @@ private:
 	std::string			m_path;
 	std::vector<Frame>	m_sequence;
 	IplImage*			m_img;
+	int					m_loadFlags;	// cvLoadImage flags (colour or grey)
 	unsigned int		m_index;
 	unsigned int		m_numFrames;
 	bool				m_IsSetup;
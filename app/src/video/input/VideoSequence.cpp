@@ -17,3 +17,32 @@
  */
 
 #include "VideoSequence.h"
+
+#include <opencv/highgui.h>
+
+#include <QtGlobal>
+
+#include <cassert>
+
+void VideoSequence::SetPreferGreyscale( bool grey )
+{
+    Q_UNUSED(grey);
+}
+
+bool VideoSequence::RetrieveNextFrameGrey( IplImage* grey, int flip ) const
+{
+    const IplImage* img = RetrieveNextFrame();
+
+    if ( !img )
+    {
+        return false;
+    }
+
+    assert( "frame & destination size do not match" &&
+            img->width == grey->width &&
+            img->height == grey->height );
+
+    cvConvertImage( img, grey, flip );
+
+    return true;
+}
@@ -58,6 +58,26 @@ public:
      */
     virtual const IplImage* RetrieveNextFrame() const = 0;
 
+    /** @brief Hint that frames will be retrieved as single-channel images.
+     *
+     *  Sources that can decode straight to grey do so (RetrieveNextFrame
+     *  then returns single-channel frames); the default ignores the hint.
+     *
+     *  @param grey @a true to prefer single-channel frames.
+     */
+    virtual void SetPreferGreyscale( bool grey );
+
+    /** @brief Write the ready frame into a single-channel 8-bit image.
+     *
+     *  Avoids an intermediate colour copy when the caller only wants
+     *  grey. The default converts whatever RetrieveNextFrame returns.
+     *
+     *  @param grey Destination image, the same size as the frame.
+     *  @param flip Flags as for cvConvertImage (e.g. CV_CVTIMG_FLIP).
+     *  @return @a false if there is no frame to retrieve.
+     */
+    virtual bool RetrieveNextFrameGrey( IplImage* grey, int flip ) const;
+
     /** @brief return timestamp of ready frame
      */
     virtual double GetTimeStamp() const = 0;
@@ -0,0 +1,222 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "CameraCalibration.h"
+
+#include <opencv/cv.h>
+
+#include <math.h>
+
+namespace
+{
+    const int srcWidth  = 320;
+    const int srcHeight = 240;
+    const int dstWidth  = 400;
+    const int dstHeight = 300;
+
+    /**
+        Ground plane style maps: a perspective view of the plane with
+        some radial distortion. Part of the output maps outside the source.
+    **/
+    void CreateMaps( CvMat** mapx, CvMat** mapy )
+    {
+        *mapx = cvCreateMat( dstHeight, dstWidth, CV_32FC1 );
+        *mapy = cvCreateMat( dstHeight, dstWidth, CV_32FC1 );
+
+        for ( int v = 0; v < dstHeight; ++v )
+        {
+            for ( int u = 0; u < dstWidth; ++u )
+            {
+                const double w = 1.0 + 0.0008 * v;
+                double x = ( 0.8 * u - 0.1 * v + 10.0 ) / w;
+                double y = ( 0.05 * u + 0.9 * v - 20.0 ) / w;
+
+                const double dx = x - srcWidth / 2.0;
+                const double dy = y - srcHeight / 2.0;
+                const double k = 1.0 + 1e-6 * ( dx * dx + dy * dy );
+
+                CV_MAT_ELEM( **mapx, float, v, u ) = (float)( srcWidth / 2.0 + dx * k );
+                CV_MAT_ELEM( **mapy, float, v, u ) = (float)( srcHeight / 2.0 + dy * k );
+            }
+        }
+    }
+
+    /** Smooth texture with a bright disc (the target) centred on cx,cy. **/
+    IplImage* CreateFrame( float cx, float cy )
+    {
+        IplImage* img = cvCreateImage( cvSize( srcWidth, srcHeight ), IPL_DEPTH_8U, 1 );
+
+        for ( int y = 0; y < srcHeight; ++y )
+        {
+            unsigned char* row = reinterpret_cast<unsigned char*>( img->imageData + y * img->widthStep );
+            for ( int x = 0; x < srcWidth; ++x )
+            {
+                const float ddx = x - cx;
+                const float ddy = y - cy;
+                const float disc = 100.f * expf( -( ddx * ddx + ddy * ddy ) / 200.f );
+                row[x] = (unsigned char)( 90.f + 40.f * sinf( x * .13f ) * cosf( y * .09f ) + disc );
+            }
+        }
+
+        return img;
+    }
+
+    IplImage* CreateGroundPlaneImage()
+    {
+        IplImage* img = cvCreateImage( cvSize( dstWidth, dstHeight ), IPL_DEPTH_8U, 1 );
+        cvZero( img );
+        return img;
+    }
+
+    /** Unwarp with the floating point maps, as CameraCalibration used to. **/
+    IplImage* ReferenceUnwarp( const IplImage* src, const CvMat* mapx, const CvMat* mapy )
+    {
+        IplImage* dst = CreateGroundPlaneImage();
+        cvRemap( src, dst, mapx, mapy, CV_INTER_LINEAR );
+        return dst;
+    }
+
+    /** Track a grid of points from prev to curr. **/
+    void TrackPoints( const IplImage* prev, const IplImage* curr, CvPoint2D32f* points, CvPoint2D32f* tracked, char* found, int count )
+    {
+        float error[64];
+        cvCalcOpticalFlowPyrLK( prev, curr, 0, 0, points, tracked, count, cvSize( 15, 15 ), 1,
+                                found, error, cvTermCriteria( CV_TERMCRIT_ITER | CV_TERMCRIT_EPS, 20, 0.03 ), 0 );
+    }
+}
+
+TEST(CameraCalibrationTests, FixedPointUnwarpMatchesFloatMaps)
+{
+    CvMat* mapx;
+    CvMat* mapy;
+    CreateMaps( &mapx, &mapy );
+
+    CameraCalibration cal;
+    cal.SetGroundPlaneMaps( cvCloneMat( mapx ), cvCloneMat( mapy ) );
+
+    IplImage* src = CreateFrame( 150.f, 110.f );
+    IplImage* expected = ReferenceUnwarp( src, mapx, mapy );
+    IplImage* actual = CreateGroundPlaneImage();
+    cal.UnwarpGroundPlane( src, actual );
+
+    IplImage* diff = CreateGroundPlaneImage();
+    cvAbsDiff( expected, actual, diff );
+
+    double maxDiff = 0.0;
+    cvMinMaxLoc( diff, 0, &maxDiff );
+
+    // 1/32 pixel of position on gradients of a few grey levels per pixel.
+    EXPECT_LE( maxDiff, 2.0 );
+
+    cvReleaseImage( &diff );
+    cvReleaseImage( &actual );
+    cvReleaseImage( &expected );
+    cvReleaseImage( &src );
+    cvReleaseMat( &mapy );
+    cvReleaseMat( &mapx );
+}
+
+TEST(CameraCalibrationTests, RoiUnwarpMatchesFullUnwarpInsideRoiOnly)
+{
+    CvMat* mapx;
+    CvMat* mapy;
+    CreateMaps( &mapx, &mapy );
+
+    CameraCalibration cal;
+    cal.SetGroundPlaneMaps( mapx, mapy );
+
+    IplImage* src = CreateFrame( 150.f, 110.f );
+    IplImage* full = CreateGroundPlaneImage();
+    cal.UnwarpGroundPlane( src, full );
+
+    IplImage* roi = CreateGroundPlaneImage();
+    const CvRect box = cvRect( 350, 40, 100, 60 ); // partly outside the image
+    cal.UnwarpGroundPlane( src, roi, box );
+
+    const CvRect clipped = cvRect( 350, 40, dstWidth - 350, 60 );
+    for ( int y = 0; y < dstHeight; ++y )
+    {
+        for ( int x = 0; x < dstWidth; ++x )
+        {
+            const bool inside = x >= clipped.x && x < clipped.x + clipped.width &&
+                                y >= clipped.y && y < clipped.y + clipped.height;
+            const int expected = inside ? (unsigned char)full->imageData[y * full->widthStep + x] : 0;
+
+            ASSERT_EQ( expected, (unsigned char)roi->imageData[y * roi->widthStep + x] ) << x << "," << y;
+        }
+    }
+
+    cvReleaseImage( &roi );
+    cvReleaseImage( &full );
+    cvReleaseImage( &src );
+}
+
+TEST(CameraCalibrationTests, TrackingUnchangedByFixedPointUnwarp)
+{
+    CvMat* mapx;
+    CvMat* mapy;
+    CreateMaps( &mapx, &mapy );
+
+    CameraCalibration cal;
+    cal.SetGroundPlaneMaps( cvCloneMat( mapx ), cvCloneMat( mapy ) );
+
+    IplImage* frame1 = CreateFrame( 150.f, 110.f );
+    IplImage* frame2 = CreateFrame( 153.5f, 108.25f );
+
+    IplImage* expected1 = ReferenceUnwarp( frame1, mapx, mapy );
+    IplImage* expected2 = ReferenceUnwarp( frame2, mapx, mapy );
+    IplImage* actual1 = CreateGroundPlaneImage();
+    IplImage* actual2 = CreateGroundPlaneImage();
+    cal.UnwarpGroundPlane( frame1, actual1 );
+    cal.UnwarpGroundPlane( frame2, actual2 );
+
+    const int count = 16;
+    CvPoint2D32f points[count];
+    for ( int i = 0; i < count; ++i )
+    {
+        points[i] = cvPoint2D32f( 100.f + 40.f * ( i % 4 ), 80.f + 30.f * ( i / 4 ) );
+    }
+
+    CvPoint2D32f expectedTrack[count];
+    CvPoint2D32f actualTrack[count];
+    char expectedFound[count];
+    char actualFound[count];
+    TrackPoints( expected1, expected2, points, expectedTrack, expectedFound, count );
+    TrackPoints( actual1, actual2, points, actualTrack, actualFound, count );
+
+    for ( int i = 0; i < count; ++i )
+    {
+        EXPECT_EQ( expectedFound[i], actualFound[i] );
+        if ( expectedFound[i] && actualFound[i] )
+        {
+            EXPECT_NEAR( expectedTrack[i].x, actualTrack[i].x, 0.1f ) << "point " << i;
+            EXPECT_NEAR( expectedTrack[i].y, actualTrack[i].y, 0.1f ) << "point " << i;
+        }
+    }
+
+    cvReleaseImage( &actual2 );
+    cvReleaseImage( &actual1 );
+    cvReleaseImage( &expected2 );
+    cvReleaseImage( &expected1 );
+    cvReleaseImage( &frame2 );
+    cvReleaseImage( &frame1 );
+    cvReleaseMat( &mapy );
+    cvReleaseMat( &mapx );
+}
@@ -0,0 +1,184 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "CoverageGrid.h"
+#include "CoverageStatistics.h"
+#include "CoverageSystem.h"
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <cstdio>
+
+namespace
+{
+    // Not a multiple of the tile size, so the last tiles are partial.
+    const int imageWidth  = 150;
+    const int imageHeight = 100;
+
+    void Increment( CoverageGrid& grid, int x, int y, int times )
+    {
+        unsigned short* count = grid.Acquire( x, y );
+        *count = (unsigned short)( *count + times );
+    }
+
+    IplImage* CreateFloorMask()
+    {
+        IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvSet( mask, cvScalar( 255 ) );
+        cvRectangle( mask, cvPoint( 60, 20 ), cvPoint( 80, 90 ), cvScalar( 0 ), CV_FILLED );
+        return mask;
+    }
+}
+
+TEST( CoverageGridTests, TilesAreOnlyAllocatedWhenWritten )
+{
+    CoverageGrid grid( cvSize( imageWidth, imageHeight ) );
+
+    EXPECT_EQ( 3, grid.GetTilesX() );
+    EXPECT_EQ( 2, grid.GetTilesY() );
+    EXPECT_EQ( 0u, grid.GetAllocatedTileCount() );
+    EXPECT_EQ( 0u, grid.Get( 140, 90 ) );
+
+    Increment( grid, 140, 90, 3 );
+
+    EXPECT_EQ( 1u, grid.GetAllocatedTileCount() );
+    EXPECT_TRUE( grid.Tile( 2, 1 ) != 0 );
+    EXPECT_TRUE( grid.Tile( 0, 0 ) == 0 );
+    EXPECT_EQ( 3u, grid.Get( 140, 90 ) );
+    EXPECT_EQ( 0u, grid.Get( 141, 90 ) );
+
+    const CvRect rect = grid.TileRect( 2, 1 );
+    EXPECT_EQ( 2 * CoverageGrid::TILE_SIZE, rect.x );
+    EXPECT_EQ( CoverageGrid::TILE_SIZE, rect.y );
+    EXPECT_EQ( imageWidth - 2 * CoverageGrid::TILE_SIZE, rect.width );
+    EXPECT_EQ( imageHeight - CoverageGrid::TILE_SIZE, rect.height );
+
+    grid.Clear();
+
+    EXPECT_EQ( 0u, grid.GetAllocatedTileCount() );
+    EXPECT_EQ( 0u, grid.Get( 140, 90 ) );
+}
+
+TEST( CoverageGridTests, ExportKeepsSixteenBitsOrSaturatesToEight )
+{
+    CoverageGrid grid( cvSize( imageWidth, imageHeight ) );
+
+    Increment( grid, 10, 10, 1 );
+    Increment( grid, 70, 10, 255 );
+    Increment( grid, 130, 80, 300 );
+
+    IplImage* counts = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_16U, 1 );
+    IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+
+    grid.Export( counts );
+    grid.Export( mask );
+
+    EXPECT_EQ( 1, CV_IMAGE_ELEM( counts, unsigned short, 10, 10 ) );
+    EXPECT_EQ( 255, CV_IMAGE_ELEM( counts, unsigned short, 10, 70 ) );
+    EXPECT_EQ( 300, CV_IMAGE_ELEM( counts, unsigned short, 80, 130 ) );
+    EXPECT_EQ( 3, cvCountNonZero( counts ) );
+
+    EXPECT_EQ( 1, CV_IMAGE_ELEM( mask, unsigned char, 10, 10 ) );
+    EXPECT_EQ( 255, CV_IMAGE_ELEM( mask, unsigned char, 10, 70 ) );
+    EXPECT_EQ( 255, CV_IMAGE_ELEM( mask, unsigned char, 80, 130 ) );
+    EXPECT_EQ( 3, cvCountNonZero( mask ) );
+
+    cvReleaseImage( &mask );
+    cvReleaseImage( &counts );
+}
+
+TEST( CoverageGridTests, HistogramMatchesExportedMask )
+{
+    CoverageGrid grid( cvSize( imageWidth, imageHeight ) );
+    IplImage* floorMask = CreateFloorMask();
+
+    for ( int y = 5; y < 60; ++y )
+    {
+        for ( int x = 30; x < 120; x += 1 + ( y % 3 ) )
+        {
+            Increment( grid, x, y, 1 + ( ( x * 7 + y * 13 ) % 300 ) );
+        }
+    }
+
+    IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    grid.Export( mask );
+
+    unsigned int fast[CoverageStatistics::NUM_LEVELS];
+    unsigned int reference[CoverageStatistics::NUM_LEVELS];
+
+    grid.Histogram( floorMask, cvCountNonZero( floorMask ), fast );
+    CoverageStatistics::Compute( mask, floorMask, reference );
+
+    for ( int level = 0; level < CoverageStatistics::NUM_LEVELS; ++level )
+    {
+        EXPECT_EQ( reference[level], fast[level] );
+    }
+
+    grid.Histogram( 0, imageWidth * imageHeight, fast );
+    CoverageStatistics::Compute( mask, 0, reference );
+
+    for ( int level = 0; level < CoverageStatistics::NUM_LEVELS; ++level )
+    {
+        EXPECT_EQ( reference[level], fast[level] );
+    }
+
+    cvReleaseImage( &mask );
+    cvReleaseImage( &floorMask );
+}
+
+TEST( CoverageGridTests, SavedCountsAreLossless )
+{
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+
+    // Sweep the same strip back and forth well past 255 passes.
+    const CvPoint2D32f a = cvPoint2D32f( 20.f, 30.f );
+    const CvPoint2D32f b = cvPoint2D32f( 50.f, 30.f );
+    const CvPoint2D32f c = cvPoint2D32f( 20.f, 34.f );
+    const CvPoint2D32f d = cvPoint2D32f( 50.f, 34.f );
+
+    for ( int i = 0; i < 400; ++i )
+    {
+        if ( i % 2 == 0 )
+        {
+            coverage.BrushBarUpdate( a, b, c, d );
+        }
+        else
+        {
+            coverage.BrushBarUpdate( c, d, a, b );
+        }
+    }
+
+    EXPECT_EQ( 400u, coverage.GetCoverageGrid().Get( 35, 32 ) );
+    EXPECT_EQ( 1u, coverage.GetCoverageGrid().GetAllocatedTileCount() );
+
+    const char* fileName = "CoverageGridTests_counts.png";
+    coverage.SaveCounts( fileName );
+
+    IplImage* loaded = cvLoadImage( fileName, CV_LOAD_IMAGE_ANYDEPTH );
+    ASSERT_TRUE( loaded != 0 );
+
+    EXPECT_EQ( IPL_DEPTH_16U, loaded->depth );
+    EXPECT_EQ( 400, CV_IMAGE_ELEM( loaded, unsigned short, 32, 35 ) );
+    EXPECT_EQ( 30 * 4, cvCountNonZero( loaded ) );
+
+    cvReleaseImage( &loaded );
+    remove( fileName );
+}
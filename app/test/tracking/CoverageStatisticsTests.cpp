@@ -0,0 +1,236 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "CoverageStatistics.h"
+#include "OpenCvTools.h"
+
+#include <opencv/cv.h>
+
+#include <algorithm>
+
+namespace
+{
+    // Odd width so rows are padded and the unrolled loops have a tail.
+    const int imageWidth  = 157;
+    const int imageHeight = 93;
+
+    /** Coverage counts biased towards the low levels, as in real runs. **/
+    IplImage* CreateCoverage( unsigned int seed = 0x12345678 )
+    {
+        IplImage* cvg = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+
+        CvRNG rng = cvRNG( seed );
+        for ( int r = 0; r < imageHeight; ++r )
+        {
+            unsigned char* p = (unsigned char*)( cvg->imageData + r * cvg->widthStep );
+
+            for ( int c = 0; c < imageWidth; ++c )
+            {
+                const unsigned int v = cvRandInt( &rng );
+                p[c] = (unsigned char)( ( v & 0x100 ) ? ( v & 0x7 ) : ( v & 0xff ) );
+            }
+        }
+
+        return cvg;
+    }
+
+    IplImage* CreateFloorMask()
+    {
+        IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvSet( mask, cvScalar( 255 ) );
+        cvRectangle( mask, cvPoint( 20, 10 ), cvPoint( 61, 50 ), cvScalar( 0 ), CV_FILLED );
+        cvCircle( mask, cvPoint( 120, 60 ), 20, cvScalar( 0 ), CV_FILLED );
+        return mask;
+    }
+
+    /** The original clone-and-compare OpenCvTools::GetPixelCoverageCount. **/
+    int ReferenceCount( const IplImage* cvg, const IplImage* floorMask, int nTimes, int cmp )
+    {
+        IplImage* mask = cvCloneImage( cvg );
+        cvCmpS( cvg, nTimes, mask, cmp );
+
+        if ( floorMask )
+        {
+            cvAnd( mask, floorMask, mask );
+        }
+
+        const int nPixels = cvCountNonZero( mask );
+        cvReleaseImage( &mask );
+        return nPixels;
+    }
+}
+
+TEST( CoverageStatisticsTests, HistogramMatchesPerLevelComparisons )
+{
+    IplImage* cvg = CreateCoverage();
+    IplImage* floorMask = CreateFloorMask();
+
+    unsigned int all[CoverageStatistics::NUM_LEVELS];
+    unsigned int floor[CoverageStatistics::NUM_LEVELS];
+    CoverageStatistics::Compute( cvg, 0, all );
+    CoverageStatistics::Compute( cvg, floorMask, floor );
+
+    for ( int level = 0; level < CoverageStatistics::NUM_LEVELS; ++level )
+    {
+        EXPECT_EQ( ReferenceCount( cvg, 0, level, CV_CMP_EQ ), (int)CoverageStatistics::Exactly( all, level ) );
+        EXPECT_EQ( ReferenceCount( cvg, floorMask, level, CV_CMP_EQ ), (int)CoverageStatistics::Exactly( floor, level ) );
+        EXPECT_EQ( ReferenceCount( cvg, 0, level, CV_CMP_GE ), (int)CoverageStatistics::AtLeast( all, level ) );
+        EXPECT_EQ( ReferenceCount( cvg, floorMask, level, CV_CMP_GE ), (int)CoverageStatistics::AtLeast( floor, level ) );
+    }
+
+    EXPECT_EQ( 0u, CoverageStatistics::Exactly( all, 256 ) );
+    EXPECT_EQ( 0u, CoverageStatistics::AtLeast( all, 256 ) );
+    EXPECT_EQ( (unsigned int)( imageWidth * imageHeight ), CoverageStatistics::AtLeast( all, 0 ) );
+
+    cvReleaseImage( &floorMask );
+    cvReleaseImage( &cvg );
+}
+
+TEST( CoverageStatisticsTests, PixelCoverageCountMatchesForEveryComparison )
+{
+    IplImage* cvg = CreateCoverage();
+
+    const int ops[] = { CV_CMP_EQ, CV_CMP_GT, CV_CMP_GE, CV_CMP_LT, CV_CMP_LE, CV_CMP_NE };
+    const int levels[] = { 0, 1, 2, 7, 8, 128, 254, 255, 256 };
+
+    for ( size_t o = 0; o < sizeof( ops ) / sizeof( ops[0] ); ++o )
+    {
+        for ( size_t l = 0; l < sizeof( levels ) / sizeof( levels[0] ); ++l )
+        {
+            EXPECT_EQ( ReferenceCount( cvg, 0, levels[l], ops[o] ),
+                       OpenCvTools::GetPixelCoverageCount( cvg, levels[l], ops[o] ) );
+        }
+    }
+
+    cvReleaseImage( &cvg );
+}
+
+TEST( CoverageStatisticsTests, AccumulateMatchesSaturatedSum )
+{
+    const CvSize size = cvSize( imageWidth, imageHeight );
+
+    IplImage* total = cvCreateImage( size, IPL_DEPTH_32S, 1 );
+    IplImage* saturated = cvCreateImage( size, IPL_DEPTH_8U, 1 );
+    cvZero( total );
+    cvZero( saturated );
+
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    CoverageStatistics::Compute( saturated, 0, histogram );
+
+    double passes = 0.0;
+
+    for ( int run = 0; run < 6; ++run )
+    {
+        IplImage* cvg = CreateCoverage( run + 1 );
+
+        // Leave whole rows uncovered, as most of a real run is.
+        cvRectangle( cvg, cvPoint( 0, 0 ), cvPoint( imageWidth - 1, 10 * run ), cvScalar( 0 ), CV_FILLED );
+
+        CoverageStatistics::Accumulate( total, cvg, histogram );
+
+        cvAdd( cvg, saturated, saturated );
+        passes += cvSum( cvg ).val[0];
+
+        // The top level of the histogram holds every total of 255 or more,
+        // so it matches the 8-bit sum; the total itself is exact.
+        unsigned int expected[CoverageStatistics::NUM_LEVELS];
+        CoverageStatistics::Compute( saturated, 0, expected );
+
+        for ( int level = 0; level < CoverageStatistics::NUM_LEVELS; ++level )
+        {
+            EXPECT_EQ( expected[level], histogram[level] );
+        }
+
+        EXPECT_EQ( passes, cvSum( total ).val[0] );
+
+        cvReleaseImage( &cvg );
+    }
+
+    EXPECT_GT( CoverageStatistics::Exactly( histogram, 255 ), 0u );
+
+    cvReleaseImage( &saturated );
+    cvReleaseImage( &total );
+}
+
+TEST( CoverageStatisticsTests, PaletteOverlayMatchesPerLevelOverlays )
+{
+    const int passCap = 5;
+
+    IplImage* cvg = CreateCoverage();
+    IplImage* total = cvCreateImage( cvGetSize( cvg ), IPL_DEPTH_32S, 1 );
+    IplImage* img = cvCreateImage( cvGetSize( cvg ), IPL_DEPTH_8U, 3 );
+    IplImage* expected = cvCreateImage( cvGetSize( cvg ), IPL_DEPTH_8U, 3 );
+
+    unsigned int histogram[CoverageStatistics::NUM_LEVELS];
+    std::fill( histogram, histogram + CoverageStatistics::NUM_LEVELS, 0u );
+    histogram[0] = imageWidth * imageHeight;
+
+    cvZero( total );
+    CoverageStatistics::Accumulate( total, cvg, histogram );
+    CoverageStatistics::Accumulate( total, cvg, histogram );
+
+    cvSet( img, cvScalar( 1, 2, 3 ) );
+    cvSet( expected, cvScalar( 1, 2, 3 ) );
+
+    // One overlay per level below the pass cap, then 10 or more passes.
+    for ( int r = 0; r < imageHeight; ++r )
+    {
+        for ( int c = 0; c < imageWidth; ++c )
+        {
+            const int passes = CV_IMAGE_ELEM( total, int, r, c );
+            unsigned char* bgr = &CV_IMAGE_ELEM( expected, unsigned char, r, c * 3 );
+
+            if ( passes >= 1 && passes < passCap )
+            {
+                bgr[0] = 0; bgr[1] = (unsigned char)( passes * 40 ); bgr[2] = 0;
+            }
+
+            if ( passes >= 10 )
+            {
+                bgr[0] = 0; bgr[1] = 255; bgr[2] = 0;
+            }
+        }
+    }
+
+    OpenCvTools::ColourPalette palette( 11 );
+
+    for ( int level = 1; level < passCap; ++level )
+    {
+        palette.SetColour( level, CV_RGB( 0, level * 40, 0 ) );
+    }
+
+    palette.SetColour( 10, CV_RGB( 0, 255, 0 ) );
+
+    OpenCvTools::DrawPaletteOverlay( img, total, palette );
+
+    for ( int r = 0; r < imageHeight; ++r )
+    {
+        for ( int c = 0; c < imageWidth * 3; ++c )
+        {
+            ASSERT_EQ( CV_IMAGE_ELEM( expected, unsigned char, r, c ),
+                       CV_IMAGE_ELEM( img, unsigned char, r, c ) );
+        }
+    }
+
+    cvReleaseImage( &expected );
+    cvReleaseImage( &img );
+    cvReleaseImage( &total );
+    cvReleaseImage( &cvg );
+}
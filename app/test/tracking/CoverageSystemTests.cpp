@@ -0,0 +1,468 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "CoverageSystem.h"
+#include "ScanlineRasteriser.h"
+
+#include <opencv/cv.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <math.h>
+
+namespace
+{
+    const int   imageWidth  = 320;
+    const int   imageHeight = 240;
+    const float halfBrush   = 14.f;
+    const float baseRadius  = 18.f;
+
+    struct Pose
+    {
+        CvPoint2D32f pos;
+        float heading;
+    };
+
+    /**
+        A log like a recorded run: back and forth across the room with
+        some wobble, turning beyond the image edges (so updates are
+        clipped) and with occasional jumps where tracking was lost.
+     **/
+    std::vector<Pose> CreateLog()
+    {
+        std::vector<Pose> log;
+
+        srand( 12345 );
+
+        float x = -20.f;
+        float y = 10.f;
+        float heading = 0.f;
+        float speed = 3.5f;
+
+        for ( int i = 0; i < 1500; ++i )
+        {
+            heading += ( ( rand() % 2001 ) - 1000 ) * 0.00005f;
+
+            if ( x > imageWidth + 20.f && cosf( heading ) > 0.f )
+            {
+                heading = 3.14159265f;
+                y += 22.f;
+            }
+            else if ( x < -20.f && cosf( heading ) < 0.f )
+            {
+                heading = 0.f;
+                y += 22.f;
+            }
+
+            if ( y > imageHeight + 20.f )
+            {
+                y = -15.f;
+            }
+
+            x += speed * cosf( heading );
+            y += speed * sinf( heading );
+
+            if ( rand() % 300 == 0 )
+            {
+                x += ( rand() % 60 ) - 30.f; // tracking glitch
+            }
+
+            const Pose p = { cvPoint2D32f( x + ( rand() % 100 ) * 0.01f, y ), heading };
+            log.push_back( p );
+        }
+
+        return log;
+    }
+
+    CvPoint2D32f BrushEnd( const Pose& p, float side )
+    {
+        return cvPoint2D32f( p.pos.x - side * halfBrush * sinf( p.heading ),
+                             p.pos.y + side * halfBrush * cosf( p.heading ) );
+    }
+
+    /** Floor mask with a couple of obstacles taken out. **/
+    IplImage* CreateFloorMask()
+    {
+        IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvSet( mask, cvScalar( 255 ) );
+        cvRectangle( mask, cvPoint( 60, 40 ), cvPoint( 110, 90 ), cvScalar( 0 ), CV_FILLED );
+        cvCircle( mask, cvPoint( 230, 170 ), 30, cvScalar( 0 ), CV_FILLED );
+        return mask;
+    }
+
+    void ReferenceIncrement( IplImage* cvgMask, const IplImage* inOutMask )
+    {
+        for ( int r = 0; r < cvgMask->height; ++r )
+        {
+            char* pMask = cvgMask->imageData + r * cvgMask->widthStep;
+            const char* pTest = inOutMask->imageData + r * inOutMask->widthStep;
+
+            for ( int c = 0; c < cvgMask->width; ++c )
+            {
+                if ( pTest[c] != 0 )
+                {
+                    pMask[c] += 1;
+                }
+            }
+        }
+    }
+
+    /** The original whole-image CoverageSystem::Update. **/
+    void ReferenceUpdate( IplImage* cvgMask, IplImage* inOutMask,
+                          CvPoint2D32f prev, CvPoint2D32f curr, float radiusPx )
+    {
+        cvZero( inOutMask );
+
+        int radius = (int)(radiusPx + .5f);
+        CvPoint pp = cvPoint( (int)(prev.x + .5f), (int)(prev.y + .5f) );
+        CvPoint pc = cvPoint( (int)(curr.x + .5f), (int)(curr.y + .5f) );
+
+        cvCircle( inOutMask, pp, radius, CV_RGB( 255, 255, 255 ), CV_FILLED );
+        cvCircle( inOutMask, pc, radius, CV_RGB( 0, 0, 0 ), CV_FILLED );
+
+        ReferenceIncrement( cvgMask, inOutMask );
+    }
+
+    /** The original per-level CoverageSystem::WriteIncrementalCoverage. **/
+    void ReferenceIncrementalCoverage( FILE* fp, const IplImage* cvgMask, const IplImage* floorMask, unsigned int count )
+    {
+        IplImage* dst = cvCreateImage( cvSize( cvgMask->width, cvgMask->height ), IPL_DEPTH_8U, 1 );
+        IplImage* countImage = cvCloneImage( dst );
+        const int floorPixels = cvCountNonZero( floorMask );
+
+        for ( unsigned int i = 1; i <= count; ++i )
+        {
+            cvCmpS( cvgMask, i, dst, CV_CMP_GE );
+            cvAnd( dst, floorMask, countImage );
+            float cov = cvCountNonZero( countImage ) * (100.f / floorPixels);
+            fprintf( fp, " %f", cov );
+        }
+
+        fprintf( fp, "\n" );
+
+        cvReleaseImage( &countImage );
+        cvReleaseImage( &dst );
+    }
+
+    /** The original per-level CoverageSystem::CoverageHistogram. **/
+    void ReferenceCoverageHistogram( FILE* fp, const IplImage* cvgMask, const IplImage* floorMask )
+    {
+        IplImage* mask = cvCloneImage( cvgMask );
+        IplImage* count = cvCloneImage( mask );
+        const unsigned int floorPixels = cvCountNonZero( floorMask );
+
+        for ( int i = 1; i < 256; ++i )
+        {
+            cvCmpS( cvgMask, i, mask, CV_CMP_EQ );
+            cvAnd( mask, floorMask, count );
+            int nPixels = cvCountNonZero( count );
+
+            float pc = nPixels * (100.f / floorPixels);
+            fprintf( fp, "%d %f\n", i, pc );
+        }
+
+        cvReleaseImage( &mask );
+        cvReleaseImage( &count );
+    }
+
+    std::string ReadAll( FILE* fp )
+    {
+        std::string text;
+        rewind( fp );
+
+        char buffer[256];
+        size_t n;
+        while ( ( n = fread( buffer, 1, sizeof( buffer ), fp ) ) > 0 )
+        {
+            text.append( buffer, n );
+        }
+
+        return text;
+    }
+
+    bool Identical( const IplImage* a, const IplImage* b )
+    {
+        for ( int r = 0; r < a->height; ++r )
+        {
+            if ( memcmp( a->imageData + r * a->widthStep,
+                         b->imageData + r * b->widthStep, a->width ) != 0 )
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+TEST( CoverageSystemTests, BrushBarUpdateCountsSweptFloorOnce )
+{
+    IplImage* floorMask = CreateFloorMask();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+    coverage.SetFloorMask( floorMask );
+
+    // A slanted brush bar moved down in sub-pixel steps (exact in fixed
+    // point, so the sweeps tile the whole swept region exactly).
+    const CvPoint2D32f startLeft  = cvPoint2D32f( 40.25f, 20.5f );
+    const CvPoint2D32f startRight = cvPoint2D32f( 130.75f, 29.875f );
+    const CvPoint2D32f step       = cvPoint2D32f( 0.125f, 0.375f );
+
+    CvPoint2D32f pl = startLeft;
+    CvPoint2D32f pr = startRight;
+
+    for ( int i = 0; i < 400; ++i )
+    {
+        const CvPoint2D32f cl = cvPoint2D32f( pl.x + step.x, pl.y + step.y );
+        const CvPoint2D32f cr = cvPoint2D32f( pr.x + step.x, pr.y + step.y );
+
+        coverage.BrushBarUpdate( pl, pr, cl, cr );
+
+        pl = cl;
+        pr = cr;
+    }
+
+    const CvPoint2D32f swept[4] = { startLeft, startRight, pr, pl };
+    std::vector<ScanlineRasteriser::Span> spans;
+    ScanlineRasteriser::FillPolygon( swept, 4, cvSize( imageWidth, imageHeight ), spans );
+
+    IplImage* expected = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    cvZero( expected );
+
+    for ( size_t i = 0; i < spans.size(); ++i )
+    {
+        for ( int c = spans[i].x0; c < spans[i].x1; ++c )
+        {
+            CV_IMAGE_ELEM( expected, unsigned char, spans[i].y, c ) = 1;
+        }
+    }
+
+    cvAnd( expected, floorMask, expected );
+
+    EXPECT_GT( cvCountNonZero( expected ), 0 );
+    EXPECT_TRUE( Identical( coverage.GetCoverageMask(), expected ) );
+
+    cvReleaseImage( &expected );
+    cvReleaseImage( &floorMask );
+}
+
+/**
+    Times half an hour of brush bar updates at 30Hz.
+    Run with --gtest_also_run_disabled_tests.
+**/
+TEST( CoverageSystemTests, DISABLED_BrushBarUpdateBenchmark )
+{
+    const std::vector<Pose> log = CreateLog();
+    IplImage* floorMask = CreateFloorMask();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+    coverage.SetFloorMask( floorMask );
+
+    const size_t numUpdates = 30 * 60 * 30;
+
+    const clock_t start = clock();
+
+    for ( size_t n = 0; n < numUpdates; ++n )
+    {
+        const size_t p = 1 + ( n % ( log.size() - 1 ) );
+
+        coverage.BrushBarUpdate( BrushEnd( log[p - 1], -1.f ), BrushEnd( log[p - 1], 1.f ),
+                                 BrushEnd( log[p], -1.f ), BrushEnd( log[p], 1.f ) );
+    }
+
+    const double seconds = double( clock() - start ) / CLOCKS_PER_SEC;
+
+    std::cout << numUpdates << " brush bar updates: " << seconds << "s" << std::endl;
+
+    EXPECT_GT( coverage.GetCoveredPixelCount(), 0u );
+
+    cvReleaseImage( &floorMask );
+}
+
+TEST( CoverageSystemTests, UpdateMatchesWholeImageUpdate )
+{
+    const std::vector<Pose> log = CreateLog();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+
+    IplImage* refCvg = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    IplImage* refInOut = cvCloneImage( refCvg );
+    cvZero( refCvg );
+
+    for ( size_t p = 1; p < log.size(); ++p )
+    {
+        coverage.Update( log[p - 1].pos, log[p].pos, baseRadius );
+        ReferenceUpdate( refCvg, refInOut, log[p - 1].pos, log[p].pos, baseRadius );
+    }
+
+    EXPECT_GT( cvCountNonZero( refCvg ), 0 );
+    EXPECT_TRUE( Identical( coverage.GetCoverageMask(), refCvg ) );
+
+    cvReleaseImage( &refInOut );
+    cvReleaseImage( &refCvg );
+}
+
+TEST( CoverageSystemTests, IncrementalCoverageMatchesPerLevelCounts )
+{
+    const std::vector<Pose> log = CreateLog();
+    IplImage* floorMask = CreateFloorMask();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+    coverage.SetFloorMask( floorMask );
+
+    FILE* fast = tmpfile();
+    FILE* reference = tmpfile();
+    ASSERT_TRUE( fast != 0 );
+    ASSERT_TRUE( reference != 0 );
+
+    for ( size_t p = 1; p < log.size(); ++p )
+    {
+        coverage.BrushBarUpdate( BrushEnd( log[p - 1], -1.f ), BrushEnd( log[p - 1], 1.f ),
+                                 BrushEnd( log[p], -1.f ), BrushEnd( log[p], 1.f ) );
+
+        if ( p % 25 == 0 )
+        {
+            coverage.WriteIncrementalCoverage( fast, 20 );
+            ReferenceIncrementalCoverage( reference, coverage.GetCoverageMask(), floorMask, 20 );
+        }
+    }
+
+    EXPECT_EQ( ReadAll( reference ), ReadAll( fast ) );
+
+    fclose( fast );
+    fclose( reference );
+    cvReleaseImage( &floorMask );
+}
+
+TEST( CoverageSystemTests, CoverageStatisticsMatchPerLevelCounts )
+{
+    const std::vector<Pose> log = CreateLog();
+    IplImage* floorMask = CreateFloorMask();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+    coverage.SetFloorMask( floorMask );
+
+    for ( size_t p = 1; p < log.size(); ++p )
+    {
+        coverage.BrushBarUpdate( BrushEnd( log[p - 1], -1.f ), BrushEnd( log[p - 1], 1.f ),
+                                 BrushEnd( log[p], -1.f ), BrushEnd( log[p], 1.f ) );
+    }
+
+    const IplImage* cvg = coverage.GetCoverageMask();
+    const unsigned int floorPixels = cvCountNonZero( floorMask );
+
+    IplImage* repeat = cvCloneImage( cvg );
+    cvCmpS( cvg, 1, repeat, CV_CMP_GT );
+    EXPECT_GT( cvCountNonZero( repeat ), 0 );
+    EXPECT_EQ( (unsigned int)cvCountNonZero( repeat ), CoverageSystem::CountRepeatCoverage( cvg ) );
+    EXPECT_EQ( cvCountNonZero( repeat ) * (100.f / floorPixels), coverage.EstimateRepeatCoverage() );
+    EXPECT_EQ( (unsigned int)cvCountNonZero( cvg ), coverage.GetCoveredPixelCount() );
+    EXPECT_EQ( floorPixels, CoverageSystem::CountWhitePixels( floorMask ) );
+    cvReleaseImage( &repeat );
+
+    const char* histogramFile = "CoverageSystemTests_histogram.txt";
+    coverage.CoverageHistogram( histogramFile );
+
+    FILE* fast = fopen( histogramFile, "r" );
+    FILE* reference = tmpfile();
+    ASSERT_TRUE( fast != 0 );
+    ASSERT_TRUE( reference != 0 );
+
+    ReferenceCoverageHistogram( reference, cvg, floorMask );
+    EXPECT_EQ( ReadAll( reference ), ReadAll( fast ) );
+
+    fclose( fast );
+    fclose( reference );
+    remove( histogramFile );
+    cvReleaseImage( &floorMask );
+}
+
+TEST( CoverageSystemTests, CurrentCoverageFollowsUpdatesAndReset )
+{
+    const std::vector<Pose> log = CreateLog();
+    IplImage* floorMask = CreateFloorMask();
+
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+    coverage.SetFloorMask( floorMask );
+
+    EXPECT_EQ( 0.f, coverage.EstimateCurrentCoverage() );
+
+    for ( size_t p = 1; p < log.size(); ++p )
+    {
+        coverage.BrushBarUpdate( BrushEnd( log[p - 1], -1.f ), BrushEnd( log[p - 1], 1.f ),
+                                 BrushEnd( log[p], -1.f ), BrushEnd( log[p], 1.f ) );
+
+        if ( p % 50 == 0 )
+        {
+            EXPECT_FLOAT_EQ( coverage.EstimateCoverage(), coverage.EstimateCurrentCoverage() );
+        }
+    }
+
+    EXPECT_GT( coverage.EstimateCurrentCoverage(), 0.f );
+
+    coverage.Reset();
+
+    EXPECT_EQ( 0u, coverage.GetCoveredPixelCount() );
+    EXPECT_EQ( 0.f, coverage.EstimateCurrentCoverage() );
+
+    coverage.BrushBarUpdate( BrushEnd( log[0], -1.f ), BrushEnd( log[0], 1.f ),
+                             BrushEnd( log[1], -1.f ), BrushEnd( log[1], 1.f ) );
+
+    EXPECT_FLOAT_EQ( coverage.EstimateCoverage(), coverage.EstimateCurrentCoverage() );
+
+    cvReleaseImage( &floorMask );
+}
+
+TEST( CoverageSystemTests, DrawOverlayOnlyChangesCoveredPixels )
+{
+    CoverageSystem coverage( cvSize( imageWidth, imageHeight ) );
+
+    coverage.BrushBarUpdate( cvPoint2D32f( 100.f, 50.f ), cvPoint2D32f( 140.f, 50.f ),
+                             cvPoint2D32f( 100.f, 90.f ), cvPoint2D32f( 140.f, 90.f ) );
+
+    IplImage* img = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 3 );
+    cvSet( img, cvScalar( 100, 100, 100 ) );
+
+    coverage.DrawOverlay( img );
+
+    IplImage* changed = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    cvCvtColor( img, changed, CV_BGR2GRAY );
+    cvCmpS( changed, 100, changed, CV_CMP_NE );
+
+    IplImage* covered = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    cvCmpS( coverage.GetCoverageMask(), 0, covered, CV_CMP_GT );
+
+    EXPECT_GT( cvCountNonZero( covered ), 0 );
+    EXPECT_TRUE( Identical( covered, changed ) );
+
+    // One pass is dark green, blended half and half.
+    EXPECT_EQ( 50, CV_IMAGE_ELEM( img, unsigned char, 70, 3 * 120 + 0 ) );
+    EXPECT_EQ( 70, CV_IMAGE_ELEM( img, unsigned char, 70, 3 * 120 + 1 ) );
+    EXPECT_EQ( 50, CV_IMAGE_ELEM( img, unsigned char, 70, 3 * 120 + 2 ) );
+
+    cvReleaseImage( &covered );
+    cvReleaseImage( &changed );
+    cvReleaseImage( &img );
+}
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "CrossCorrelation.h"
+
+#include <opencv/cv.h>
+
+#include <QtCore/QTime>
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <math.h>
+
+namespace
+{
+    const int imageWidth  = 320;
+    const int imageHeight = 240;
+
+    /** Window sizes 2r for target radii across typical arena resolutions. **/
+    const int windowSizes[] = { 11, 20, 31, 40, 60, 61, 90, 120 };
+    const int numWindowSizes = sizeof( windowSizes ) / sizeof( windowSizes[0] );
+
+    /** Smooth texture plus noise, so windows have a well defined correlation. **/
+    IplImage* CreateTexturedImage( unsigned int seed )
+    {
+        IplImage* img = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+
+        srand( seed );
+        for ( int y = 0; y < img->height; ++y )
+        {
+            unsigned char* row = reinterpret_cast<unsigned char*>( img->imageData + y * img->widthStep );
+            for ( int x = 0; x < img->width; ++x )
+            {
+                const double v = 128. + 50. * sin( x * 0.11 ) * cos( y * 0.07 ) + ( rand() % 60 ) - 30;
+                row[x] = (unsigned char)std::max( 0., std::min( 255., v ) );
+            }
+        }
+
+        return img;
+    }
+
+    /** @a src shifted by one pixel with extra noise. **/
+    IplImage* CreateShiftedImage( const IplImage* src, unsigned int seed )
+    {
+        IplImage* img = cvCloneImage( src );
+
+        srand( seed );
+        for ( int y = 0; y < img->height; ++y )
+        {
+            const unsigned char* srcRow = reinterpret_cast<const unsigned char*>( src->imageData + y * src->widthStep );
+            unsigned char* row = reinterpret_cast<unsigned char*>( img->imageData + y * img->widthStep );
+            for ( int x = 1; x < img->width; ++x )
+            {
+                const int v = srcRow[x - 1] + ( rand() % 21 ) - 10;
+                row[x] = (unsigned char)std::max( 0, std::min( 255, v ) );
+            }
+        }
+
+        return img;
+    }
+
+    /** Restores the automatically selected instruction set at end of scope. **/
+    class InstructionsGuard
+    {
+    public:
+        InstructionsGuard() : m_saved( CrossCorrelation::GetInstructions() ) {}
+        ~InstructionsGuard() { CrossCorrelation::SetInstructions( m_saved ); }
+
+    private:
+        CrossCorrelation::Instructions m_saved;
+    };
+
+    const char* InstructionsName( int instructions )
+    {
+        switch ( instructions )
+        {
+            case CrossCorrelation::INSTRUCTIONS_SSE2: return "sse2";
+            case CrossCorrelation::INSTRUCTIONS_AVX2: return "avx2";
+            default: return "scalar";
+        }
+    }
+}
+
+TEST(CrossCorrelationTests, Ncc2dMatchesReference)
+{
+    InstructionsGuard guard;
+    IplImage* img1 = CreateTexturedImage( 1 );
+    IplImage* img2 = CreateShiftedImage( img1, 2 );
+
+    for ( int isa = CrossCorrelation::INSTRUCTIONS_SCALAR; isa <= CrossCorrelation::GetSupportedInstructions(); ++isa )
+    {
+        CrossCorrelation::SetInstructions( (CrossCorrelation::Instructions)isa );
+
+        for ( int i = 0; i < numWindowSizes; ++i )
+        {
+            const int w = windowSizes[i];
+            for ( int dx = -2; dx <= 2; ++dx )
+            {
+                const int x = imageWidth / 2;
+                const int y = imageHeight / 2;
+
+                const float expected = CrossCorrelation::Ncc2dReference( img1, img2, x, y, x + dx, y - dx, w, w );
+                const float actual   = CrossCorrelation::Ncc2d( img1, img2, x, y, x + dx, y - dx, w, w );
+
+                EXPECT_EQ( expected, actual ) << InstructionsName( isa ) << " window " << w;
+            }
+        }
+    }
+
+    cvReleaseImage( &img2 );
+    cvReleaseImage( &img1 );
+}
+
+TEST(CrossCorrelationTests, Ncc2dRadialMatchesReference)
+{
+    InstructionsGuard guard;
+    IplImage* img1 = CreateTexturedImage( 3 );
+    IplImage* img2 = CreateShiftedImage( img1, 4 );
+
+    for ( int isa = CrossCorrelation::INSTRUCTIONS_SCALAR; isa <= CrossCorrelation::GetSupportedInstructions(); ++isa )
+    {
+        CrossCorrelation::SetInstructions( (CrossCorrelation::Instructions)isa );
+
+        for ( int i = 0; i < numWindowSizes; ++i )
+        {
+            const int w = windowSizes[i];
+            for ( int dx = -2; dx <= 2; ++dx )
+            {
+                const int x = imageWidth / 2;
+                const int y = imageHeight / 2;
+
+                const float expected = CrossCorrelation::Ncc2dRadialReference( img1, img2, x, y, x + dx, y - dx, w, w );
+                const float actual   = CrossCorrelation::Ncc2dRadial( img1, img2, x, y, x + dx, y - dx, w, w );
+
+                // The reference truncates deviations from the mean to integers.
+                EXPECT_NEAR( expected, actual, 1e-2 ) << InstructionsName( isa ) << " window " << w;
+            }
+        }
+    }
+
+    cvReleaseImage( &img2 );
+    cvReleaseImage( &img1 );
+}
+
+TEST(CrossCorrelationTests, ReturnsZeroWhenWindowLeavesImage)
+{
+    IplImage* img1 = CreateTexturedImage( 5 );
+    IplImage* img2 = CreateShiftedImage( img1, 6 );
+
+    EXPECT_EQ( 0.f, CrossCorrelation::Ncc2d( img1, img2, 5, 100, 100, 100, 20, 20 ) );
+    EXPECT_EQ( 0.f, CrossCorrelation::Ncc2d( img1, img2, 100, 100, 100, imageHeight - 5, 20, 20 ) );
+    EXPECT_EQ( 0.f, CrossCorrelation::Ncc2dRadial( img1, img2, 5, 100, 100, 100, 20, 20 ) );
+    EXPECT_EQ( 0.f, CrossCorrelation::Ncc2dRadial( img1, img2, 100, 100, imageWidth - 5, 100, 20, 20 ) );
+
+    CrossCorrelation::RadialWeights weights;
+    CrossCorrelation::CreateRadialWeights( 20, 20, img1->nChannels + 1, weights );
+    EXPECT_EQ( 0.f, CrossCorrelation::Ncc2dRadial( img1, img2, 100, 100, 100, 100, weights ) );
+
+    cvReleaseImage( &img2 );
+    cvReleaseImage( &img1 );
+}
+
+/**
+    Micro-benchmark of each instruction set against the reference
+    implementations. Run with --gtest_also_run_disabled_tests.
+**/
+TEST(CrossCorrelationTests, DISABLED_Benchmark)
+{
+    InstructionsGuard guard;
+    IplImage* img1 = CreateTexturedImage( 7 );
+    IplImage* img2 = CreateShiftedImage( img1, 8 );
+
+    const int iterations = 2000;
+    const int x = imageWidth / 2;
+    const int y = imageHeight / 2;
+
+    for ( int i = 0; i < numWindowSizes; ++i )
+    {
+        const int w = windowSizes[i];
+        volatile float sink = 0.f;
+
+        CrossCorrelation::RadialWeights weights;
+        CrossCorrelation::CreateRadialWeights( w, w, img1->nChannels, weights );
+
+        QTime timer;
+        timer.start();
+        for ( int n = 0; n < iterations; ++n )
+        {
+            sink = sink + CrossCorrelation::Ncc2dReference( img1, img2, x, y, x + 1, y, w, w );
+        }
+        const int nccReferenceMs = timer.restart();
+        for ( int n = 0; n < iterations; ++n )
+        {
+            sink = sink + CrossCorrelation::Ncc2dRadialReference( img1, img2, x, y, x + 1, y, w, w );
+        }
+        const int radialReferenceMs = timer.restart();
+
+        std::cout << "window " << w << " reference: ncc " << nccReferenceMs
+                  << "ms radial " << radialReferenceMs << "ms" << std::endl;
+
+        for ( int isa = CrossCorrelation::INSTRUCTIONS_SCALAR; isa <= CrossCorrelation::GetSupportedInstructions(); ++isa )
+        {
+            CrossCorrelation::SetInstructions( (CrossCorrelation::Instructions)isa );
+
+            timer.restart();
+            for ( int n = 0; n < iterations; ++n )
+            {
+                sink = sink + CrossCorrelation::Ncc2d( img1, img2, x, y, x + 1, y, w, w );
+            }
+            const int nccMs = timer.restart();
+            for ( int n = 0; n < iterations; ++n )
+            {
+                sink = sink + CrossCorrelation::Ncc2dRadial( img1, img2, x, y, x + 1, y, weights );
+            }
+            const int radialMs = timer.restart();
+
+            std::cout << "window " << w << " " << InstructionsName( isa )
+                      << ": ncc " << nccMs << "ms radial " << radialMs << "ms" << std::endl;
+        }
+    }
+
+    cvReleaseImage( &img2 );
+    cvReleaseImage( &img1 );
+}
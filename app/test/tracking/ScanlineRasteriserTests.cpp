@@ -0,0 +1,155 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "ScanlineRasteriser.h"
+
+#include <opencv/cv.h>
+
+#include <vector>
+#include <math.h>
+
+namespace
+{
+    const int imageWidth  = 160;
+    const int imageHeight = 120;
+
+    /** Adds one to every pixel the polygon covers. **/
+    void Fill( IplImage* img, const CvPoint2D32f* pts, int numPts )
+    {
+        std::vector<ScanlineRasteriser::Span> spans;
+        ScanlineRasteriser::FillPolygon( pts, numPts, cvGetSize( img ), spans );
+
+        for ( size_t i = 0; i < spans.size(); ++i )
+        {
+            for ( int c = spans[i].x0; c < spans[i].x1; ++c )
+            {
+                CV_IMAGE_ELEM( img, unsigned char, spans[i].y, c ) += 1;
+            }
+        }
+    }
+
+    IplImage* CreateImage()
+    {
+        IplImage* img = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvZero( img );
+        return img;
+    }
+
+    double MaxValue( const IplImage* img )
+    {
+        double minVal;
+        double maxVal;
+        cvMinMaxLoc( img, &minVal, &maxVal );
+        return maxVal;
+    }
+}
+
+TEST( ScanlineRasteriserTests, PixelCentresOnSharedEdgesAreFilledOnce )
+{
+    IplImage* img = CreateImage();
+
+    // Four squares meeting at (10.5, 10.5) with every edge through pixel centres.
+    const float a = 4.5f;
+    const float b = 10.5f;
+    const float c = 16.5f;
+
+    const CvPoint2D32f tl[4] = { cvPoint2D32f( a, a ), cvPoint2D32f( b, a ), cvPoint2D32f( b, b ), cvPoint2D32f( a, b ) };
+    const CvPoint2D32f tr[4] = { cvPoint2D32f( b, a ), cvPoint2D32f( c, a ), cvPoint2D32f( c, b ), cvPoint2D32f( b, b ) };
+    const CvPoint2D32f bl[4] = { cvPoint2D32f( a, b ), cvPoint2D32f( b, b ), cvPoint2D32f( b, c ), cvPoint2D32f( a, c ) };
+    const CvPoint2D32f br[4] = { cvPoint2D32f( b, b ), cvPoint2D32f( c, b ), cvPoint2D32f( c, c ), cvPoint2D32f( b, c ) };
+
+    Fill( img, tl, 4 );
+    Fill( img, tr, 4 );
+    Fill( img, bl, 4 );
+    Fill( img, br, 4 );
+
+    // Top and left edges are inside, bottom and right are not.
+    EXPECT_EQ( 12 * 12, cvCountNonZero( img ) );
+    EXPECT_EQ( 1.0, MaxValue( img ) );
+    EXPECT_EQ( 1, CV_IMAGE_ELEM( img, unsigned char, 4, 4 ) );
+    EXPECT_EQ( 0, CV_IMAGE_ELEM( img, unsigned char, 16, 16 ) );
+
+    cvReleaseImage( &img );
+}
+
+TEST( ScanlineRasteriserTests, FanOfSweepsHasNoGapsOrOverlaps )
+{
+    IplImage* img = CreateImage();
+
+    // A bar of length 50 turning about one end in one degree steps.
+    const CvPoint2D32f pivot = cvPoint2D32f( 40.3f, 30.7f );
+    const float radius = 50.f;
+    const float degToRad = 3.14159265f / 180.f;
+
+    CvPoint2D32f prev = cvPoint2D32f( pivot.x + radius, pivot.y );
+
+    for ( int d = 1; d <= 90; ++d )
+    {
+        const CvPoint2D32f curr = cvPoint2D32f( pivot.x + radius * cosf( d * degToRad ),
+                                                pivot.y + radius * sinf( d * degToRad ) );
+
+        const CvPoint2D32f sweep[4] = { pivot, prev, curr, pivot };
+        Fill( img, sweep, 4 );
+
+        prev = curr;
+    }
+
+    const double quarterDisc = 3.14159265 * radius * radius / 4.0;
+
+    EXPECT_EQ( 1.0, MaxValue( img ) );
+    EXPECT_NEAR( quarterDisc, cvCountNonZero( img ), quarterDisc * 0.01 );
+
+    cvReleaseImage( &img );
+}
+
+TEST( ScanlineRasteriserTests, CrossedQuadFillsBothTriangles )
+{
+    IplImage* img = CreateImage();
+
+    // The bar swapping ends between poses sweeps a bow-tie.
+    const CvPoint2D32f bowTie[4] = { cvPoint2D32f( 20.f, 20.f ), cvPoint2D32f( 60.f, 20.f ),
+                                     cvPoint2D32f( 20.f, 60.f ), cvPoint2D32f( 60.f, 60.f ) };
+    Fill( img, bowTie, 4 );
+
+    EXPECT_EQ( 1, CV_IMAGE_ELEM( img, unsigned char, 25, 40 ) );
+    EXPECT_EQ( 1, CV_IMAGE_ELEM( img, unsigned char, 55, 40 ) );
+    EXPECT_EQ( 0, CV_IMAGE_ELEM( img, unsigned char, 40, 25 ) );
+    EXPECT_EQ( 0, CV_IMAGE_ELEM( img, unsigned char, 40, 55 ) );
+
+    cvReleaseImage( &img );
+}
+
+TEST( ScanlineRasteriserTests, SpansAreClippedToTheImage )
+{
+    const CvPoint2D32f quad[4] = { cvPoint2D32f( -30.5f, -10.2f ), cvPoint2D32f( 200.1f, -5.f ),
+                                   cvPoint2D32f( 190.f, 130.9f ), cvPoint2D32f( -25.f, 125.f ) };
+
+    std::vector<ScanlineRasteriser::Span> spans;
+    ScanlineRasteriser::FillPolygon( quad, 4, cvSize( imageWidth, imageHeight ), spans );
+
+    ASSERT_EQ( (size_t)imageHeight, spans.size() );
+
+    for ( size_t i = 0; i < spans.size(); ++i )
+    {
+        EXPECT_EQ( (int)i, spans[i].y );
+        EXPECT_EQ( 0, spans[i].x0 );
+        EXPECT_EQ( imageWidth, spans[i].x1 );
+    }
+}
@@ -0,0 +1,219 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "TargetHeading.h"
+#include "KltTracker.h"
+#include "Angles.h"
+#include "MathsConstants.h"
+
+#include <opencv/cv.h>
+
+#include <math.h>
+
+namespace
+{
+    const int   imageSize = 200;
+    const float radius    = 30.f;
+    const int   threshold = 128;
+
+    /** Light target disc with two dark squares offset along @a angle. **/
+    IplImage* CreateTargetImage( CvPoint2D32f centre, float angle )
+    {
+        IplImage* img = cvCreateImage( cvSize( imageSize, imageSize ), IPL_DEPTH_8U, 1 );
+        cvSet( img, cvScalar( 200 ) );
+
+        cvCircle( img, cvPoint( (int)centre.x, (int)centre.y ), (int)radius, cvScalar( 240 ), CV_FILLED );
+
+        const float side = radius / 3.f;
+        for ( int s = -1; s <= 1; s += 2 )
+        {
+            const float sx = centre.x + s * side * cosf( angle );
+            const float sy = centre.y + s * side * sinf( angle );
+
+            CvPoint corners[4];
+            for ( int c = 0; c < 4; ++c )
+            {
+                const float a = angle + MathsConstants::F_PI / 4.f + c * MathsConstants::F_PI / 2.f;
+                corners[c] = cvPoint( (int)( sx + side * 0.7f * cosf( a ) + .5f ),
+                                      (int)( sy + side * 0.7f * sinf( a ) + .5f ) );
+            }
+
+            cvFillConvexPoly( img, corners, 4, cvScalar( 20 ) );
+        }
+
+        return img;
+    }
+
+    /** The original (allocating, per-pixel exp) implementation from KltTracker. **/
+    float ReferenceHeading( const IplImage* currImg, CvPoint2D32f pos, const CvMat* weightImg, float fallback )
+    {
+        CvRect roi = cvRect( (int)(pos.x - radius),
+                             (int)(pos.y - radius),
+                             (int)(radius * 2),
+                             (int)(radius * 2) );
+
+        if ( roi.x < 0 || roi.x > currImg->width - radius ||
+             roi.y < 0 || roi.y > currImg->height - radius )
+        {
+            return fallback;
+        }
+
+        IplImage* tmpImg = cvCloneImage( currImg );
+        cvSetImageROI( tmpImg, roi );
+
+        IplImage* img = cvCreateImage( cvSize( tmpImg->roi->width,
+                                               tmpImg->roi->height ), IPL_DEPTH_8U, 1 );
+        cvCopyImage( tmpImg, img );
+        cvReleaseImage( &tmpImg );
+
+        float mx = 0.f;
+        float my = 0.f;
+        float sum = 0.f;
+        for ( int i = 0; i < img->height; ++i )
+        {
+            for ( int j = 0; j < img->width; ++j )
+            {
+                float w = (float)cvmGet( weightImg, i, j );
+                CvScalar v = cvGet2D( img, i, j );
+
+                float val = (float)(v.val[0] * w);
+                val = (255 * w) - val;
+
+                if ( val > threshold )
+                {
+                    w = expf( -powf( ((val - 255.f) / (50.f)), 2 ) );
+                    mx += i * w;
+                    my += j * w;
+                    sum += w;
+                }
+                else
+                {
+                    val = 0;
+                }
+
+                cvSet2D( img, i, j, cvScalar( val ) );
+            }
+        }
+
+        float invSum = 1.f / sum;
+        mx *= invSum;
+        my *= invSum;
+
+        float cov[4];
+        CvMat C = cvMat( 2, 2, CV_32F, cov );
+        cvSetZero( &C );
+        sum = 0.f;
+        for ( int i = 0; i < img->height; ++i )
+        {
+            for ( int j = 0; j < img->width; ++j )
+            {
+                CvScalar v = cvGet2D( img, i, j );
+                int val = (int)(v.val[0]);
+                if ( val > threshold )
+                {
+                    float vx = i - mx;
+                    float vy = j - my;
+                    float w = expf( -powf( ((val - 255.f) / (50.f)), 2 ) );
+                    cov[0] += w * vx * vx;
+                    cov[1] += w * vx * vy;
+                    cov[3] += w * vy * vy;
+                    sum += w;
+                }
+            }
+        }
+        invSum = 1.f / sum;
+        cov[0] *= invSum;
+        cov[1] *= invSum;
+        cov[2] = cov[1];
+        cov[3] *= invSum;
+
+        float w[4];
+        float u[4];
+        CvMat W = cvMat( 2, 2, CV_32F, w );
+        CvMat U = cvMat( 2, 2, CV_32F, u );
+        cvSVD( &C, &W, &U, 0, CV_SVD_MODIFY_A );
+
+        float angle = (float)(atan2( u[0], u[2] ) + (.25f * MathsConstants::F_PI));
+        angle = (MathsConstants::F_PI / 2.0f) - angle;
+
+        cvReleaseImage( &img );
+
+        return angle;
+    }
+}
+
+TEST(TargetHeadingTests, MatchesReferenceImplementation)
+{
+    const double tolerance = 0.01; // radians
+
+    CvMat* weights = KltTracker::CreateWeightImage( radius );
+
+    const CvPoint2D32f positions[] = { cvPoint2D32f( 100.f, 100.f ),
+                                       cvPoint2D32f( 97.3f, 104.6f ),
+                                       cvPoint2D32f( 61.8f, 140.2f ) };
+
+    for ( size_t p = 0; p < sizeof( positions ) / sizeof( positions[0] ); ++p )
+    {
+        for ( int degrees = 0; degrees < 360; degrees += 15 )
+        {
+            const float angle = degrees * MathsConstants::F_PI / 180.f;
+            IplImage* img = CreateTargetImage( positions[p], angle );
+
+            const float expected = ReferenceHeading( img, positions[p], weights, 0.f );
+            const float actual = TargetHeading::Estimate( img, positions[p], radius, weights, threshold, 0.f );
+
+            EXPECT_NEAR( 0.0, Angles::DiffAngle( expected, actual ), tolerance )
+                << "position " << p << ", target angle " << degrees;
+
+            cvReleaseImage( &img );
+        }
+    }
+
+    cvReleaseMat( &weights );
+}
+
+TEST(TargetHeadingTests, ReturnsFallbackOutsideImage)
+{
+    CvMat* weights = KltTracker::CreateWeightImage( radius );
+    IplImage* img = CreateTargetImage( cvPoint2D32f( 100.f, 100.f ), 0.f );
+
+    const float fallback = 1.234f;
+
+    EXPECT_EQ( fallback, TargetHeading::Estimate( img, cvPoint2D32f( 5.f, 100.f ), radius, weights, threshold, fallback ) );
+    EXPECT_EQ( fallback, TargetHeading::Estimate( img, cvPoint2D32f( 100.f, 5.f ), radius, weights, threshold, fallback ) );
+    EXPECT_EQ( fallback, TargetHeading::Estimate( 0, cvPoint2D32f( 100.f, 100.f ), radius, weights, threshold, fallback ) );
+
+    cvReleaseImage( &img );
+    cvReleaseMat( &weights );
+}
+
+TEST(TargetHeadingTests, ReturnsFallbackWhenNothingAboveThreshold)
+{
+    CvMat* weights = KltTracker::CreateWeightImage( radius );
+    IplImage* img = cvCreateImage( cvSize( imageSize, imageSize ), IPL_DEPTH_8U, 1 );
+    cvSet( img, cvScalar( 255 ) );
+
+    const float fallback = -0.5f;
+
+    EXPECT_EQ( fallback, TargetHeading::Estimate( img, cvPoint2D32f( 100.f, 100.f ), radius, weights, threshold, fallback ) );
+
+    cvReleaseImage( &img );
+    cvReleaseMat( &weights );
+}
@@ -0,0 +1,355 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "TargetRelocaliser.h"
+#include "KltTracker.h"
+#include "RobotMetrics.h"
+#include "RobotMetricsSchema.h"
+#include "ExtrinsicCalibrationSchema.h"
+#include "WbConfig.h"
+
+#include <opencv/cv.h>
+#include <opencv/highgui.h>
+
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QTime>
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <math.h>
+
+namespace
+{
+    const int   imageWidth  = 640;
+    const int   imageHeight = 480;
+    const float radius      = 24.f;
+    const int   threshold   = 128;
+    const int   trials      = 20;
+    const int   tolerance   = 4;
+
+    typedef std::vector<IplImage*> Bank;
+
+    /** Square target with two dark squares on a diagonal, at the size KltTracker::LoadTargetImage resizes to. **/
+    IplImage* CreateTargetImage()
+    {
+        const int size = (int)( ( 2.f * radius ) / sqrtf( 2.f ) + .5f );
+        IplImage* target = cvCreateImage( cvSize( size, size ), IPL_DEPTH_8U, 1 );
+        cvSet( target, cvScalar( 240 ) );
+
+        const int side = size / 4;
+        cvRectangle( target, cvPoint( size / 4 - side / 2, size / 4 - side / 2 ),
+                             cvPoint( size / 4 + side / 2, size / 4 + side / 2 ), cvScalar( 20 ), CV_FILLED );
+        cvRectangle( target, cvPoint( 3 * size / 4 - side / 2, 3 * size / 4 - side / 2 ),
+                             cvPoint( 3 * size / 4 + side / 2, 3 * size / 4 + side / 2 ), cvScalar( 20 ), CV_FILLED );
+
+        return target;
+    }
+
+    /** A moving object in the synthetic scene. **/
+    struct SceneObject
+    {
+        CvPoint pos;
+        int     bankIndex; // < 0 for a plain distractor disc
+    };
+
+    /** Textured floor with nothing on it. **/
+    IplImage* CreateGround( CvRNG& rng )
+    {
+        IplImage* ground = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvRandArr( &rng, ground, CV_RAND_UNI, cvScalar( 80 ), cvScalar( 120 ) );
+        cvSmooth( ground, ground, CV_GAUSSIAN, 3 );
+
+        return ground;
+    }
+
+    /** The floor with the target and some target-sized distractors on it. **/
+    IplImage* CreateScene( const IplImage* ground, const Bank& bank, const std::vector<SceneObject>& objects )
+    {
+        IplImage* scene = cvCloneImage( ground );
+
+        IplImage* disc = cvCreateImage( cvGetSize( bank[0] ), IPL_DEPTH_8U, 1 );
+        cvZero( disc );
+        cvCircle( disc, cvPoint( disc->width / 2, disc->height / 2 ), (int)radius, cvScalar( 255 ), CV_FILLED );
+
+        for ( size_t k = 0; k < objects.size(); ++k )
+        {
+            const SceneObject& obj = objects[k];
+            if ( obj.bankIndex >= 0 )
+            {
+                const IplImage* patch = bank[obj.bankIndex];
+                cvSetImageROI( scene, cvRect( obj.pos.x - patch->width / 2, obj.pos.y - patch->height / 2,
+                                              patch->width, patch->height ) );
+                cvCopy( patch, scene, disc );
+                cvResetImageROI( scene );
+            }
+            else
+            {
+                cvCircle( scene, obj.pos, (int)radius, cvScalar( 40 + 50 * ( k % 4 ) ), CV_FILLED );
+            }
+        }
+
+        cvReleaseImage( &disc );
+
+        return scene;
+    }
+
+    /** Motion mask with a ring around each object, as if only its edges had changed. **/
+    IplImage* CreateMotionMask( const std::vector<SceneObject>& objects )
+    {
+        IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+        cvZero( mask );
+
+        for ( size_t k = 0; k < objects.size(); ++k )
+        {
+            cvCircle( mask, objects[k].pos, (int)radius, cvScalar( 255 ), (int)( radius / 2 ) );
+        }
+
+        return mask;
+    }
+
+    /** Random target pose plus distractors, all well inside the image and apart from each other. **/
+    std::vector<SceneObject> CreateObjects( CvRNG& rng, int bankSize, int numDistractors )
+    {
+        const int margin = (int)( 3 * radius );
+
+        std::vector<SceneObject> objects;
+        while ( (int)objects.size() < numDistractors + 1 )
+        {
+            SceneObject obj;
+            obj.pos = cvPoint( margin + cvRandInt( &rng ) % ( imageWidth - 2 * margin ),
+                               margin + cvRandInt( &rng ) % ( imageHeight - 2 * margin ) );
+            obj.bankIndex = objects.empty() ? (int)( cvRandInt( &rng ) % bankSize ) : -1;
+
+            bool clear = true;
+            for ( size_t k = 0; k < objects.size(); ++k )
+            {
+                const int dx = obj.pos.x - objects[k].pos.x;
+                const int dy = obj.pos.y - objects[k].pos.y;
+                clear &= ( dx * dx + dy * dy ) > ( 16 * radius * radius );
+            }
+
+            if ( clear )
+            {
+                objects.push_back( obj );
+            }
+        }
+
+        return objects;
+    }
+
+    bool IsNear( CvPoint a, CvPoint b, int tol )
+    {
+        return abs( a.x - b.x ) <= tol && abs( a.y - b.y ) <= tol;
+    }
+}
+
+/**
+    Builds a KltTracker for a target of the test radius (one pixel per
+    centimetre) and loads the synthetic target into it from file, so the
+    tests search with the tracker's own appearance bank and loss recovery.
+**/
+class TargetRelocaliserTests : public ::testing::Test
+{
+protected:
+    TargetRelocaliserTests() :
+        m_metrics(),
+        m_tracker( 0 ),
+        m_targetFile( QDir::tempPath() + "/TargetRelocaliserTests.png" ),
+        m_targetSize( 0 )
+    {
+    }
+
+    virtual void SetUp()
+    {
+        WbConfig metricsCfg( WbSchema( RobotMetricsSchema::schemaName ), QFileInfo() );
+        metricsCfg.SetKeyValue( RobotMetricsSchema::targetDiagonalCmKey, KeyValue::from( 2.0 * radius ) );
+
+        WbConfig camPosCalCfg( WbSchema( ExtrinsicCalibrationSchema::schemaName ), QFileInfo() );
+        camPosCalCfg.SetKeyValue( ExtrinsicCalibrationSchema::gridSquareSizeInCmKey, KeyValue::from( 1.0 ) );
+        camPosCalCfg.SetKeyValue( ExtrinsicCalibrationSchema::gridSquareSizeInPxKey, KeyValue::from( 1.0 ) );
+
+        m_metrics.LoadMetrics( metricsCfg, camPosCalCfg, 1.f );
+        ASSERT_FLOAT_EQ( radius, m_metrics.GetRadiusPx() );
+
+        IplImage* target = CreateTargetImage();
+        m_targetSize = target->width;
+        cvSaveImage( m_targetFile.toAscii().data(), target );
+        cvReleaseImage( &target );
+
+        m_tracker = new KltTracker( 0, &m_metrics, 0, threshold );
+        ASSERT_TRUE( m_tracker->LoadTargetImage( m_targetFile.toAscii().data() ) );
+    }
+
+    virtual void TearDown()
+    {
+        delete m_tracker;
+        QFile::remove( m_targetFile );
+    }
+
+    const Bank& GetBank() const
+    {
+        return m_tracker->GetAppearanceBank();
+    }
+
+    /**
+        Activates the tracker away from the target on @a ground, then runs
+        loss recovery with @a scene as the next frame (so the motion mask
+        comes from the difference of the two). Returns true if the tracker
+        relocalised to within the tolerance of @a targetPos and adds the
+        time taken by the recovery to @a recoveryMs if given.
+    **/
+    bool Recover( const IplImage* ground, const IplImage* scene, CvPoint targetPos, int* recoveryMs = 0 )
+    {
+        m_tracker->SetCurrentImage( ground );
+        m_tracker->SetPosition( cvPoint2D32f( radius, radius ) );
+        m_tracker->Activate();
+
+        m_tracker->SetCurrentImage( scene );
+
+        QTime timer;
+        timer.start();
+        m_tracker->LossRecovery();
+        if ( recoveryMs )
+        {
+            *recoveryMs += timer.elapsed();
+        }
+
+        const CvPoint2D32f pos = m_tracker->GetPosition();
+        return IsNear( cvPoint( (int)( pos.x + .5f ), (int)( pos.y + .5f ) ), targetPos, tolerance );
+    }
+
+    RobotMetrics m_metrics;
+    KltTracker*  m_tracker;
+    QString      m_targetFile;
+    int          m_targetSize;
+};
+
+TEST_F(TargetRelocaliserTests, NoCandidatesWithoutTarget)
+{
+    TargetRelocaliser relocaliser;
+
+    IplImage* img = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    IplImage* mask = cvCreateImage( cvSize( imageWidth, imageHeight ), IPL_DEPTH_8U, 1 );
+    cvSet( img, cvScalar( 100 ) );
+    cvSet( mask, cvScalar( 255 ) );
+
+    EXPECT_TRUE( relocaliser.FindCandidates( img, mask ).empty() );
+
+    cvReleaseImage( &mask );
+    cvReleaseImage( &img );
+}
+
+TEST_F(TargetRelocaliserTests, NoCandidatesWithoutMotion)
+{
+    TargetRelocaliser relocaliser;
+    relocaliser.SetTarget( GetBank(), m_targetSize, radius );
+
+    CvRNG rng = cvRNG( 1 );
+    std::vector<SceneObject> objects = CreateObjects( rng, (int)GetBank().size(), 2 );
+    IplImage* ground = CreateGround( rng );
+    IplImage* scene = CreateScene( ground, GetBank(), objects );
+    IplImage* mask = cvCreateImage( cvGetSize( scene ), IPL_DEPTH_8U, 1 );
+    cvZero( mask );
+
+    EXPECT_TRUE( relocaliser.FindCandidates( scene, mask ).empty() );
+
+    cvReleaseImage( &mask );
+    cvReleaseImage( &scene );
+    cvReleaseImage( &ground );
+}
+
+TEST_F(TargetRelocaliserTests, TargetIsAmongCandidates)
+{
+    TargetRelocaliser relocaliser;
+    relocaliser.SetTarget( GetBank(), m_targetSize, radius );
+    ASSERT_GT( relocaliser.GetScale(), 1 );
+
+    CvRNG rng = cvRNG( 2 );
+    for ( int t = 0; t < trials; ++t )
+    {
+        std::vector<SceneObject> objects = CreateObjects( rng, (int)GetBank().size(), 3 );
+        IplImage* ground = CreateGround( rng );
+        IplImage* scene = CreateScene( ground, GetBank(), objects );
+        IplImage* mask = CreateMotionMask( objects );
+
+        const std::vector<CvPoint>& candidates = relocaliser.FindCandidates( scene, mask );
+
+        EXPECT_LE( (int)candidates.size(), TargetRelocaliser::m_maxCandidates );
+
+        bool found = false;
+        for ( size_t c = 0; c < candidates.size(); ++c )
+        {
+            found |= IsNear( candidates[c], objects[0].pos, 2 * relocaliser.GetScale() );
+        }
+        EXPECT_TRUE( found ) << "trial " << t << " target at " << objects[0].pos.x << "," << objects[0].pos.y;
+
+        cvReleaseImage( &mask );
+        cvReleaseImage( &scene );
+        cvReleaseImage( &ground );
+    }
+}
+
+TEST_F(TargetRelocaliserTests, LossRecoveryRelocalisesTarget)
+{
+    CvRNG rng = cvRNG( 3 );
+    int relocalised = 0;
+    for ( int t = 0; t < trials; ++t )
+    {
+        std::vector<SceneObject> objects = CreateObjects( rng, (int)GetBank().size(), 3 );
+        IplImage* ground = CreateGround( rng );
+        IplImage* scene = CreateScene( ground, GetBank(), objects );
+
+        relocalised += Recover( ground, scene, objects[0].pos ) ? 1 : 0;
+
+        cvReleaseImage( &scene );
+        cvReleaseImage( &ground );
+    }
+
+    EXPECT_GE( relocalised, ( 3 * trials ) / 4 ) << relocalised << "/" << trials << " relocalised";
+}
+
+/**
+    Reports the mean time and success rate of KltTracker::LossRecovery
+    on synthetic scenes with distractors.
+    Run with --gtest_also_run_disabled_tests.
+**/
+TEST_F(TargetRelocaliserTests, DISABLED_RecoveryBenchmark)
+{
+    int recoveryMs = 0;
+    int relocalised = 0;
+
+    CvRNG rng = cvRNG( 4 );
+    for ( int t = 0; t < trials; ++t )
+    {
+        std::vector<SceneObject> objects = CreateObjects( rng, (int)GetBank().size(), 3 );
+        IplImage* ground = CreateGround( rng );
+        IplImage* scene = CreateScene( ground, GetBank(), objects );
+
+        relocalised += Recover( ground, scene, objects[0].pos, &recoveryMs ) ? 1 : 0;
+
+        cvReleaseImage( &scene );
+        cvReleaseImage( &ground );
+    }
+
+    std::cout << "loss recovery: " << (float)recoveryMs / trials << "ms per recovery, "
+              << relocalised << "/" << trials << " relocalised" << std::endl;
+}
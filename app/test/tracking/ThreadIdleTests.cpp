@@ -0,0 +1,135 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// Process CPU time is only measured where CLOCK_PROCESS_CPUTIME_ID exists.
+#if !defined(__MINGW32__) && !defined(_MSC_VER)
+
+#include <gtest/gtest.h>
+
+#include "TrackThread.h"
+#include "GtsScene.h"
+#include "CaptureThread.h"
+#include "VideoSequence.h"
+
+#include <opencv/cv.h>
+
+#include <QtCore/QThread>
+#include <QtCore/QTime>
+
+#include <time.h>
+
+namespace
+{
+    const int settleMs  = 100;
+    const int measureMs = 500;
+    const double maxIdleCpuMs = 25.0; // a spinning thread would use ~measureMs
+
+    /** Expose QThread's protected sleep to the test. **/
+    class Sleeper : public QThread
+    {
+    public:
+        static void Ms( unsigned long ms ) { QThread::msleep( ms ); }
+    };
+
+    double ProcessCpuMs()
+    {
+        timespec t;
+        clock_gettime( CLOCK_PROCESS_CPUTIME_ID, &t );
+        return t.tv_sec * 1000.0 + t.tv_nsec / 1000000.0;
+    }
+
+    /** CPU time used by the whole process while the test thread sleeps. **/
+    double IdleCpuMs()
+    {
+        Sleeper::Ms( settleMs );
+        const double start = ProcessCpuMs();
+        Sleeper::Ms( measureMs );
+        return ProcessCpuMs() - start;
+    }
+
+    /** A sequence which is never set up, or never has a frame ready. **/
+    class IdleSequence : public VideoSequence
+    {
+    public:
+        explicit IdleSequence( bool setup ) : m_setup( setup ) {}
+
+        virtual bool IsRewindable() const { return false; }
+        virtual bool IsForwardable() const { return false; }
+        virtual bool IsWindable() const { return false; }
+        virtual bool IsLive() const { return true; }
+        virtual bool ReadyNextFrame() { return false; }
+        virtual bool ReadyNextFrame( double ) { return false; }
+        virtual const IplImage* RetrieveNextFrame() const { return 0; }
+        virtual double GetTimeStamp() const { return 0.; }
+        virtual double GetFrameIndex() const { return 0.; }
+        virtual double GetNumFrames() const { return -1.; }
+        virtual int GetFrameWidth() const { return 0; }
+        virtual int GetFrameHeight() const { return 0; }
+        virtual bool IsSetup() const { return m_setup; }
+        virtual void SetFrameRate( const double ) {}
+        virtual double GetFrameRate() { return 30.; }
+        virtual int Flip() const { return 0; }
+        virtual void ReadyFrame() {}
+        virtual bool TakeFrame() { return false; }
+
+    private:
+        bool m_setup;
+    };
+}
+
+TEST( ThreadIdleTests, PausedTrackThreadUsesNoCpu )
+{
+    // With no cameras set up every tracker counts as lost,
+    // so the thread pauses after its first step.
+    GtsScene scene;
+    TrackThread thread( scene );
+
+    EXPECT_LT( IdleCpuMs(), maxIdleCpuMs );
+
+    // Releasing the pause steps once and pauses again.
+    thread.Run();
+    EXPECT_LT( IdleCpuMs(), maxIdleCpuMs );
+
+    QTime stopTime;
+    stopTime.start();
+    thread.Stop();
+    EXPECT_LT( stopTime.elapsed(), 1000 );
+}
+
+TEST( ThreadIdleTests, CaptureThreadWithoutSequenceUsesNoCpu )
+{
+    CaptureThread capture( new IdleSequence( false ) );
+
+    EXPECT_LT( IdleCpuMs(), maxIdleCpuMs );
+
+    QTime stopTime;
+    stopTime.start();
+    capture.StopCapturing();
+    EXPECT_LT( stopTime.elapsed(), 1000 );
+}
+
+TEST( ThreadIdleTests, CaptureThreadWaitingForFramesUsesLittleCpu )
+{
+    CaptureThread capture( new IdleSequence( true ) );
+
+    EXPECT_LT( IdleCpuMs(), maxIdleCpuMs );
+
+    capture.StopCapturing();
+}
+
+#endif
@@ -0,0 +1,127 @@
+/*
+ * Copyright (C) 2007-2013 Dyson Technology Ltd, all rights reserved.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gtest/gtest.h>
+
+#include "TrackHistory.h"
+
+#include <stdio.h>
+
+namespace
+{
+    const double timeTolerance = 1e-4;
+
+    TrackHistory::TrackLog CreateLog()
+    {
+        TrackHistory::TrackLog log;
+
+        log.push_back( TrackEntry( cvPoint2D32f( 10.f, 20.f ), 0.f, 0.9f, 0.1, 1.f ) );
+        log.push_back( TrackEntry( cvPoint2D32f( 11.f, 21.f ), 0.f, 0.8f, 0.2, 1.f ) );
+        log.push_back( TrackEntry( cvPoint2D32f( 15.f, 25.f ), 0.f, 0.7f, 0.5, 1.f ) );
+
+        return log;
+    }
+
+    TrackHistory::FrameDrop Drop( double timeStamp, unsigned int numFrames )
+    {
+        const TrackHistory::FrameDrop drop = { timeStamp, numFrames };
+        return drop;
+    }
+}
+
+TEST( TrackHistoryTests, LogReadsBackFrameDrops )
+{
+    const char* logFile = "TrackHistoryTests_log.txt";
+
+    TrackHistory::DropLog drops;
+    drops.push_back( Drop( 0.2, 2 ) );
+    drops.push_back( Drop( 0.5, 3 ) );
+    drops.push_back( Drop( 0.7, 1 ) );
+
+    ASSERT_TRUE( TrackHistory::WriteHistoryLog( logFile, CreateLog(), drops ) );
+
+    TrackHistory::TrackLog log;
+    TrackHistory::DropLog readDrops;
+    ASSERT_TRUE( TrackHistory::ReadHistoryLog( logFile, log, readDrops ) );
+
+    EXPECT_EQ( CreateLog().size(), log.size() );
+    ASSERT_EQ( drops.size(), readDrops.size() );
+
+    for ( unsigned int i = 0; i < drops.size(); ++i )
+    {
+        EXPECT_NEAR( drops[i].timeStamp, readDrops[i].timeStamp, timeTolerance );
+        EXPECT_EQ( drops[i].numFrames, readDrops[i].numFrames );
+    }
+
+    TrackHistory::TrackLog plainLog;
+    ASSERT_TRUE( TrackHistory::ReadHistoryLog( logFile, plainLog ) );
+    EXPECT_EQ( CreateLog().size(), plainLog.size() );
+
+    remove( logFile );
+}
+
+TEST( TrackHistoryTests, CsvReadsBackFramesDroppedBeforeEachEntry )
+{
+    const char* csvFile = "TrackHistoryTests_log.csv";
+
+    TrackHistory::DropLog drops;
+    drops.push_back( Drop( 0.2, 2 ) );
+    drops.push_back( Drop( 0.5, 1 ) );
+    drops.push_back( Drop( 0.5, 3 ) );
+    drops.push_back( Drop( 0.7, 1 ) );  // after the last entry, so not written
+
+    ASSERT_TRUE( TrackHistory::WriteHistoryCsv( csvFile, CreateLog(), drops ) );
+
+    TrackHistory::TrackLog log;
+    TrackHistory::DropLog readDrops;
+    ASSERT_TRUE( TrackHistory::ReadHistoryCsv( csvFile, log, readDrops ) );
+
+    ASSERT_EQ( CreateLog().size(), log.size() );
+    EXPECT_NEAR( 0.5, log.back().GetTimeStamp(), timeTolerance );
+
+    ASSERT_EQ( 2u, readDrops.size() );
+    EXPECT_NEAR( 0.2, readDrops[0].timeStamp, timeTolerance );
+    EXPECT_EQ( 2u, readDrops[0].numFrames );
+    EXPECT_NEAR( 0.5, readDrops[1].timeStamp, timeTolerance );
+    EXPECT_EQ( 4u, readDrops[1].numFrames );
+
+    remove( csvFile );
+}
+
+TEST( TrackHistoryTests, CsvWithoutDropColumnReadsAsNoDrops )
+{
+    const char* csvFile = "TrackHistoryTests_old.csv";
+
+    FILE* fp = fopen( csvFile, "w" );
+    ASSERT_TRUE( fp != 0 );
+    fprintf( fp, "Time(s),X(cm),Y(cm),H(deg),Err,WGM\n" );
+    fprintf( fp, "0.1000,10.000,-20.000,0.000,0.900000,1.000000\n" );
+    fprintf( fp, "0.2000,11.000,-21.000,0.000,0.800000,1.000000\n" );
+    fclose( fp );
+
+    TrackHistory::TrackLog log;
+    TrackHistory::DropLog readDrops;
+    ASSERT_TRUE( TrackHistory::ReadHistoryCsv( csvFile, log, readDrops ) );
+
+    ASSERT_EQ( 2u, log.size() );
+    EXPECT_NEAR( 0.2, log[1].GetTimeStamp(), timeTolerance );
+    EXPECT_FLOAT_EQ( 11.f, log[1].GetPosition().x );
+    EXPECT_TRUE( readDrops.empty() );
+
+    remove( csvFile );
+}